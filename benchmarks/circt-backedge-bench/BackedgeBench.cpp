@@ -0,0 +1,105 @@
+//===- BackedgeBench.cpp - Backedge builder benchmark -----------*- C++ -*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// Measure the cost of creating, using, resolving and clearing backedges, the
+// way lowerings such as HandshakeToFIRRTL use them. Compares BackedgeBuilder
+// against one placeholder op per backedge, which is what it used to create.
+//
+// Usage: circt-backedge-bench [numBackedges]
+//
+//===----------------------------------------------------------------------===//
+
+#include "circt/Support/BackedgeBuilder.h"
+#include "mlir/IR/Builders.h"
+#include "mlir/IR/BuiltinOps.h"
+#include "mlir/IR/BuiltinTypes.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+using namespace mlir;
+using namespace circt;
+
+/// Run 'body' on an empty module and return how long it took in seconds.
+template <typename BodyFn>
+static double run(MLIRContext &context, BodyFn body) {
+  auto loc = UnknownLoc::get(&context);
+  OwningOpRef<ModuleOp> module = ModuleOp::create(loc);
+  OpBuilder builder = OpBuilder::atBlockEnd(module->getBody());
+
+  auto start = std::chrono::steady_clock::now();
+  body(builder, loc);
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  return elapsed.count();
+}
+
+int main(int argc, char **argv) {
+  size_t numBackedges =
+      argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000000;
+
+  MLIRContext context;
+  SmallVector<Type> types;
+  for (unsigned width : {1, 8, 32, 64})
+    types.push_back(IntegerType::get(&context, width));
+
+  // Every backedge is used by an op, then resolved to a value of its type.
+  auto useAndResolve = [&](OpBuilder &builder, Location loc,
+                           function_ref<Value(Type)> getBackedge,
+                           function_ref<void(size_t, Value)> resolve) {
+    SmallVector<Value> values;
+    for (auto type : types)
+      values.push_back(
+          builder.create<UnrealizedConversionCastOp>(loc, type, ValueRange{})
+              .getResult(0));
+    for (size_t i = 0; i < numBackedges; ++i) {
+      auto type = types[i % types.size()];
+      builder.create<UnrealizedConversionCastOp>(loc, type,
+                                                 getBackedge(type));
+    }
+    for (size_t i = 0; i < numBackedges; ++i)
+      resolve(i, values[i % types.size()]);
+  };
+
+  double perEdgeOps = run(context, [&](OpBuilder &builder, Location loc) {
+    SmallVector<Operation *> ops;
+    ops.reserve(numBackedges);
+    useAndResolve(
+        builder, loc,
+        [&](Type type) -> Value {
+          ops.push_back(builder.create<UnrealizedConversionCastOp>(
+              loc, type, ValueRange{}));
+          return ops.back()->getResult(0);
+        },
+        [&](size_t i, Value value) {
+          ops[i]->getResult(0).replaceAllUsesWith(value);
+        });
+    for (auto *op : ops)
+      op->erase();
+  });
+
+  double pooled = run(context, [&](OpBuilder &builder, Location loc) {
+    BackedgeBuilder bb(builder, loc);
+    SmallVector<Backedge> edges;
+    edges.reserve(numBackedges);
+    useAndResolve(
+        builder, loc,
+        [&](Type type) -> Value {
+          edges.push_back(bb.get(type));
+          return edges.back();
+        },
+        [&](size_t i, Value value) { edges[i].setValue(value); });
+    (void)bb.clearOrEmitError();
+  });
+
+  printf("backedges:       %zu\n", numBackedges);
+  printf("op per backedge: %.3f s\n", perEdgeOps);
+  printf("BackedgeBuilder: %.3f s (%.2fx)\n", pooled, perEdgeOps / pooled);
+  return 0;
+}
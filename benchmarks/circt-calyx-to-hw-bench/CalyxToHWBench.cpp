@@ -0,0 +1,125 @@
+//===- CalyxToHWBench.cpp - Calyx to HW conversion benchmark ----*- C++ -*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// Measure the time spent in the Calyx to HW conversion on programs with many
+// components. The program is generated as one straight-line function per
+// component, lowered with SCFToCalyx, and compiled to structural Calyx with
+// the Calyx passes. The conversion is then timed with and without
+// multithreading.
+//
+// Usage: circt-calyx-to-hw-bench [numComponents] [numOps]
+//
+//===----------------------------------------------------------------------===//
+
+#include "circt/Conversion/CalyxToHW.h"
+#include "circt/Conversion/SCFToCalyx.h"
+#include "circt/Dialect/Calyx/CalyxDialect.h"
+#include "circt/Dialect/Calyx/CalyxOps.h"
+#include "circt/Dialect/Calyx/CalyxPasses.h"
+#include "circt/Dialect/Comb/CombDialect.h"
+#include "circt/Dialect/HW/HWDialect.h"
+#include "circt/Dialect/SV/SVDialect.h"
+#include "circt/Dialect/Seq/SeqDialect.h"
+#include "mlir/Dialect/Arithmetic/IR/Arithmetic.h"
+#include "mlir/Dialect/Func/IR/FuncOps.h"
+#include "mlir/Dialect/SCF/IR/SCF.h"
+#include "mlir/IR/BuiltinOps.h"
+#include "mlir/Parser/Parser.h"
+#include "mlir/Pass/PassManager.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+using namespace mlir;
+using namespace circt;
+
+/// Generate `numComponents` functions of `numOps` integer operations each.
+static std::string generateProgram(size_t numComponents, size_t numOps) {
+  static const char *const opNames[] = {"addi", "subi", "xori",
+                                        "andi", "ori",  "shli"};
+  std::string program;
+  llvm::raw_string_ostream os(program);
+  os << "module {\n";
+  for (size_t i = 0; i < numComponents; ++i) {
+    os << "  func.func @f" << i << "(%a0: i32, %a1: i32) -> i32 {\n";
+    os << "    %v0 = arith.addi %a0, %a1 : i32\n";
+    for (size_t j = 1; j < numOps; ++j)
+      os << "    %v" << j << " = arith." << opNames[(i + j) % 6] << " %v"
+         << j - 1 << ", %a" << j % 2 << " : i32\n";
+    os << "    return %v" << numOps - 1 << " : i32\n";
+    os << "  }\n";
+  }
+  os << "}\n";
+  return os.str();
+}
+
+/// Run the Calyx to HW conversion on a copy of `module` and return how long it
+/// took in seconds, or a negative number if it failed.
+static double run(MLIRContext &context, ModuleOp module) {
+  OwningOpRef<ModuleOp> copy = module.clone();
+  PassManager pm(&context);
+  pm.addPass(createCalyxToHWPass());
+
+  auto start = std::chrono::steady_clock::now();
+  if (failed(pm.run(*copy)))
+    return -1;
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  return elapsed.count();
+}
+
+int main(int argc, char **argv) {
+  size_t numComponents = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 500;
+  size_t numOps = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 50;
+  if (numComponents == 0 || numOps == 0) {
+    fprintf(stderr, "expected at least one component and operation\n");
+    return 1;
+  }
+
+  DialectRegistry registry;
+  registry.insert<arith::ArithmeticDialect, calyx::CalyxDialect,
+                  comb::CombDialect, func::FuncDialect, hw::HWDialect,
+                  scf::SCFDialect, seq::SeqDialect, sv::SVDialect>();
+  MLIRContext context(registry);
+
+  OwningOpRef<ModuleOp> module = parseSourceString<ModuleOp>(
+      generateProgram(numComponents, numOps), &context);
+  if (!module)
+    return 1;
+
+  // Lower the functions to structural Calyx.
+  PassManager pm(&context);
+  auto scfToCalyx = createSCFToCalyxPass();
+  if (failed(scfToCalyx->initializeOptions("top-level-function=f0")))
+    return 1;
+  pm.addPass(std::move(scfToCalyx));
+  auto &componentPM = pm.nest<calyx::ProgramOp>().nest<calyx::ComponentOp>();
+  componentPM.addPass(calyx::createGoInsertionPass());
+  componentPM.addPass(calyx::createCompileControlPass());
+  componentPM.addPass(calyx::createClkInsertionPass());
+  componentPM.addPass(calyx::createResetInsertionPass());
+  componentPM.addPass(calyx::createRemoveGroupsPass());
+  if (failed(pm.run(*module)))
+    return 1;
+
+  context.disableMultithreading(true);
+  double serial = run(context, *module);
+  context.disableMultithreading(false);
+  double parallel = run(context, *module);
+  if (serial < 0 || parallel < 0) {
+    fprintf(stderr, "failed to convert the program to HW\n");
+    return 1;
+  }
+
+  printf("components:   %zu x %zu operations\n", numComponents, numOps);
+  printf("1 thread:     %.3f s\n", serial);
+  printf("multithread:  %.3f s (%.2fx)\n", parallel, serial / parallel);
+  return 0;
+}
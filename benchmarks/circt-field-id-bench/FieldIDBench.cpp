@@ -0,0 +1,119 @@
+//===- FieldIDBench.cpp - FIRRTL field ID benchmark -------------*- C++ -*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// Measure the time spent resolving every field ID of a deeply nested bundle
+// type to the type of the field. This compares the bundle field ID tables
+// used by `getFinalTypeByFieldID` against walking the type one aggregate
+// level at a time, with a binary search over the field IDs of each bundle.
+//
+// Usage: circt-field-id-bench [depth] [width] [repetitions]
+//
+//===----------------------------------------------------------------------===//
+
+#include "circt/Dialect/FIRRTL/FIRRTLDialect.h"
+#include "circt/Dialect/FIRRTL/FIRRTLTypes.h"
+#include "mlir/IR/MLIRContext.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+using namespace mlir;
+using namespace circt;
+using namespace firrtl;
+
+/// Build a bundle `depth` levels deep. Every level has `width` fields: ground
+/// types, a small vector, and the next level.
+static BundleType buildType(MLIRContext &context, size_t depth, size_t width) {
+  FIRRTLType type = UIntType::get(&context, 1);
+  for (size_t level = 0; level < depth; ++level) {
+    SmallVector<BundleType::BundleElement> elements;
+    for (size_t i = 0; i + 1 < width; ++i) {
+      FIRRTLType element = SIntType::get(&context, 8);
+      if (i % 4 == 3)
+        element = FVectorType::get(element, 2);
+      elements.push_back({StringAttr::get(&context, "f" + std::to_string(i)),
+                          i % 2 == 1, element});
+    }
+    elements.push_back({StringAttr::get(&context, "next"), false, type});
+    type = BundleType::get(elements, &context);
+  }
+  return type.cast<BundleType>();
+}
+
+/// Resolve a field ID one aggregate level at a time, without going through the
+/// bundle field ID tables.
+static FIRRTLType walkFieldID(FIRRTLType type, unsigned fieldID) {
+  while (fieldID) {
+    if (auto bundle = type.dyn_cast<BundleType>()) {
+      unsigned lo = 0, hi = bundle.getNumElements();
+      while (hi - lo > 1) {
+        unsigned mid = (lo + hi) / 2;
+        if (bundle.getFieldID(mid) <= fieldID)
+          lo = mid;
+        else
+          hi = mid;
+      }
+      fieldID -= bundle.getFieldID(lo);
+      type = bundle.getElementType(lo);
+      continue;
+    }
+    auto vector = type.cast<FVectorType>();
+    auto index = vector.getIndexForFieldID(fieldID);
+    fieldID -= vector.getFieldID(index);
+    type = vector.getElementType();
+  }
+  return type;
+}
+
+/// Resolve all field IDs of `bundle` `repetitions` times with `resolve` and
+/// return how long it took in seconds.
+template <typename ResolveFn>
+static double run(BundleType bundle, size_t repetitions, size_t &checksum,
+                  ResolveFn resolve) {
+  auto start = std::chrono::steady_clock::now();
+  for (size_t r = 0; r < repetitions; ++r)
+    for (unsigned fieldID = 0, e = bundle.getMaxFieldID(); fieldID <= e;
+         ++fieldID)
+      checksum += resolve(fieldID).getBitWidthOrSentinel();
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  return elapsed.count();
+}
+
+int main(int argc, char **argv) {
+  size_t depth = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 16;
+  size_t width = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 16;
+  size_t repetitions = argc > 3 ? std::strtoull(argv[3], nullptr, 10) : 1000;
+  if (depth == 0 || width == 0 || repetitions == 0) {
+    fprintf(stderr, "expected at least one level, field and repetition\n");
+    return 1;
+  }
+
+  MLIRContext context;
+  context.loadDialect<FIRRTLDialect>();
+  auto bundle = buildType(context, depth, width);
+
+  size_t walkChecksum = 0, tableChecksum = 0;
+  double walk = run(bundle, repetitions, walkChecksum, [&](unsigned fieldID) {
+    return walkFieldID(bundle, fieldID);
+  });
+  double table = run(bundle, repetitions, tableChecksum, [&](unsigned fieldID) {
+    return bundle.getFinalTypeByFieldID(fieldID);
+  });
+  if (walkChecksum != tableChecksum) {
+    fprintf(stderr, "field ID tables disagree with the level-by-level walk\n");
+    return 1;
+  }
+
+  printf("bundle:       %zu levels x %zu fields, %u field IDs\n", depth, width,
+         bundle.getMaxFieldID() + 1);
+  printf("walk:         %.3f s\n", walk);
+  printf("table:        %.3f s (%.2fx)\n", table, walk / table);
+  return 0;
+}
@@ -0,0 +1,131 @@
+//===- LowerCHIRRTLBench.cpp - CHIRRTL lowering benchmark -------*- C++ -*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// Measure the time spent in LowerCHIRRTL on modules with wide multi-port
+// memories. Every memory holds a bundle of vectors and has ports whose kinds
+// are inferred from subfield and subindex chains: reading ports, writing
+// ports, and ports which do both. The pass is timed with and without
+// multithreading.
+//
+// Usage: circt-lower-chirrtl-bench [numModules] [numPorts] [numFields]
+//
+//===----------------------------------------------------------------------===//
+
+#include "circt/Dialect/FIRRTL/CHIRRTLDialect.h"
+#include "circt/Dialect/FIRRTL/FIRRTLDialect.h"
+#include "circt/Dialect/FIRRTL/FIRRTLOps.h"
+#include "circt/Dialect/FIRRTL/Passes.h"
+#include "mlir/IR/BuiltinOps.h"
+#include "mlir/Parser/Parser.h"
+#include "mlir/Pass/PassManager.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+using namespace mlir;
+using namespace circt;
+
+/// Generate `numModules` modules with one memory of `numPorts` ports each. The
+/// memory elements are bundles of `numFields` vectors.
+static std::string generateProgram(size_t numModules, size_t numPorts,
+                                   size_t numFields) {
+  std::string dataType;
+  llvm::raw_string_ostream dataOS(dataType);
+  dataOS << "bundle<";
+  for (size_t k = 0; k < numFields; ++k)
+    dataOS << (k ? ", " : "") << "f" << k << ": vector<uint<8>, 4>";
+  dataOS << ">";
+  auto memType = "!chirrtl.cmemory<" + dataOS.str() + ", 256>";
+  auto portTypes = "(" + memType + ") -> (!firrtl." + dataType +
+                   ", !chirrtl.cmemoryport)";
+
+  std::string program;
+  llvm::raw_string_ostream os(program);
+  os << "firrtl.circuit \"M0\" {\n";
+  for (size_t i = 0; i < numModules; ++i) {
+    os << "  firrtl.module @M" << i
+       << "(in %clock: !firrtl.clock, in %addr: !firrtl.uint<8>, "
+          "in %in: !firrtl.uint<8>, out %out: !firrtl.uint<8>) {\n";
+    os << "    %ram = chirrtl.combmem : " << memType << "\n";
+    for (size_t p = 0; p < numPorts; ++p) {
+      os << "    %d" << p << ", %p" << p << " = chirrtl.memoryport Infer %ram "
+         << "{name = \"p" << p << "\"} : " << portTypes << "\n";
+      os << "    chirrtl.memoryport.access %p" << p << "[%addr], %clock : "
+         << "!chirrtl.cmemoryport, !firrtl.uint<8>, !firrtl.clock\n";
+      // Ports alternate between reading, writing, and doing both.
+      for (size_t k = 0; k < numFields; ++k) {
+        os << "    %d" << p << "_" << k << " = firrtl.subfield %d" << p << "("
+           << k << ") : (!firrtl." << dataType
+           << ") -> !firrtl.vector<uint<8>, 4>\n";
+        os << "    %d" << p << "_" << k << "_0 = firrtl.subindex %d" << p
+           << "_" << k << "[" << k % 4 << "] : !firrtl.vector<uint<8>, 4>\n";
+        if (p % 3 != 1)
+          os << "    firrtl.connect %out, %d" << p << "_" << k
+             << "_0 : !firrtl.uint<8>, !firrtl.uint<8>\n";
+        if (p % 3 != 0)
+          os << "    firrtl.connect %d" << p << "_" << k
+             << "_0, %in : !firrtl.uint<8>, !firrtl.uint<8>\n";
+      }
+    }
+    os << "  }\n";
+  }
+  os << "}\n";
+  return os.str();
+}
+
+/// Run LowerCHIRRTL on a copy of `module` and return how long it took in
+/// seconds, or a negative number if it failed.
+static double run(MLIRContext &context, ModuleOp module) {
+  OwningOpRef<ModuleOp> copy = module.clone();
+  PassManager pm(&context);
+  pm.nest<firrtl::CircuitOp>().nest<firrtl::FModuleOp>().addPass(
+      firrtl::createLowerCHIRRTLPass());
+
+  auto start = std::chrono::steady_clock::now();
+  if (failed(pm.run(*copy)))
+    return -1;
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  return elapsed.count();
+}
+
+int main(int argc, char **argv) {
+  size_t numModules = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 200;
+  size_t numPorts = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 16;
+  size_t numFields = argc > 3 ? std::strtoull(argv[3], nullptr, 10) : 64;
+  if (numModules == 0 || numPorts == 0 || numFields == 0) {
+    fprintf(stderr, "expected at least one module, port and field\n");
+    return 1;
+  }
+
+  DialectRegistry registry;
+  registry.insert<chirrtl::CHIRRTLDialect, firrtl::FIRRTLDialect>();
+  MLIRContext context(registry);
+
+  OwningOpRef<ModuleOp> module = parseSourceString<ModuleOp>(
+      generateProgram(numModules, numPorts, numFields), &context);
+  if (!module)
+    return 1;
+
+  context.disableMultithreading(true);
+  double serial = run(context, *module);
+  context.disableMultithreading(false);
+  double parallel = run(context, *module);
+  if (serial < 0 || parallel < 0) {
+    fprintf(stderr, "failed to lower the CHIRRTL memories\n");
+    return 1;
+  }
+
+  printf("memories:     %zu x %zu ports, %zu fields\n", numModules, numPorts,
+         numFields);
+  printf("1 thread:     %.3f s\n", serial);
+  printf("multithread:  %.3f s (%.2fx)\n", parallel, serial / parallel);
+  return 0;
+}
@@ -0,0 +1,124 @@
+//===- MooreToCoreBench.cpp - Moore to core conversion benchmark *- C++ -*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// Measure the time spent in the Moore to core conversion on a synthetic design
+// which uses the typedefs of a few packages everywhere, the way imported
+// SystemVerilog codebases do. Every function takes and returns package types
+// and shifts them around, so the same named types are converted over and over.
+// The conversion is timed with and without multithreading.
+//
+// Usage: circt-moore-to-core-bench [numFunctions] [numOps] [numPackages]
+//
+//===----------------------------------------------------------------------===//
+
+#include "circt/Conversion/MooreToCore.h"
+#include "circt/Dialect/Comb/CombDialect.h"
+#include "circt/Dialect/HW/HWDialect.h"
+#include "circt/Dialect/LLHD/IR/LLHDDialect.h"
+#include "circt/Dialect/Moore/MooreDialect.h"
+#include "mlir/Dialect/ControlFlow/IR/ControlFlowOps.h"
+#include "mlir/Dialect/Func/IR/FuncOps.h"
+#include "mlir/IR/BuiltinOps.h"
+#include "mlir/Parser/Parser.h"
+#include "mlir/Pass/PassManager.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+using namespace mlir;
+using namespace circt;
+
+/// Return the Moore type of the `index`-th typedef of a package. Typedefs of
+/// the same package alias each other, like `typedef word_t addr_t;`.
+static std::string getPackageType(size_t package, size_t index) {
+  std::string type;
+  llvm::raw_string_ostream os(type);
+  unsigned width = 8 + 8 * (package % 4);
+  std::string inner = "range<bit, " + std::to_string(width - 1) + ":0>";
+  for (size_t i = 0; i <= index % 3; ++i)
+    inner = "named<\"pkg" + std::to_string(package) + "::t" +
+            std::to_string(i) + "\", " + inner + ", loc(\"pkg" +
+            std::to_string(package) + ".sv\":" + std::to_string(i + 1) +
+            ":1)>";
+  os << "!moore.packed<" << inner << ">";
+  return os.str();
+}
+
+/// Generate `numFunctions` functions of `numOps` shifts each, using the types
+/// of `numPackages` packages.
+static std::string generateProgram(size_t numFunctions, size_t numOps,
+                                   size_t numPackages) {
+  std::string program;
+  llvm::raw_string_ostream os(program);
+  os << "module {\n";
+  for (size_t i = 0; i < numFunctions; ++i) {
+    auto type = getPackageType(i % numPackages, i);
+    os << "  func.func @f" << i << "(%a0: " << type
+       << ", %a1: !moore.bit) -> " << type << " {\n";
+    os << "    %v0 = moore.mir.shl %a0, %a1 : " << type << ", !moore.bit\n";
+    for (size_t j = 1; j < numOps; ++j)
+      os << "    %v" << j << " = moore.mir." << (j % 2 ? "shr" : "shl")
+         << " %v" << j - 1 << ", %a1 : " << type << ", !moore.bit\n";
+    os << "    return %v" << numOps - 1 << " : " << type << "\n";
+    os << "  }\n";
+  }
+  os << "}\n";
+  return os.str();
+}
+
+/// Run the Moore to core conversion on a copy of `module` and return how long
+/// it took in seconds, or a negative number if it failed.
+static double run(MLIRContext &context, ModuleOp module) {
+  OwningOpRef<ModuleOp> copy = module.clone();
+  PassManager pm(&context);
+  pm.addPass(createConvertMooreToCorePass());
+
+  auto start = std::chrono::steady_clock::now();
+  if (failed(pm.run(*copy)))
+    return -1;
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  return elapsed.count();
+}
+
+int main(int argc, char **argv) {
+  size_t numFunctions = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 2000;
+  size_t numOps = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 50;
+  size_t numPackages = argc > 3 ? std::strtoull(argv[3], nullptr, 10) : 16;
+  if (numFunctions == 0 || numOps == 0 || numPackages == 0) {
+    fprintf(stderr, "expected at least one function, operation and package\n");
+    return 1;
+  }
+
+  DialectRegistry registry;
+  registry.insert<cf::ControlFlowDialect, comb::CombDialect, func::FuncDialect,
+                  hw::HWDialect, llhd::LLHDDialect, moore::MooreDialect>();
+  MLIRContext context(registry);
+
+  OwningOpRef<ModuleOp> module = parseSourceString<ModuleOp>(
+      generateProgram(numFunctions, numOps, numPackages), &context);
+  if (!module)
+    return 1;
+
+  context.disableMultithreading(true);
+  double serial = run(context, *module);
+  context.disableMultithreading(false);
+  double parallel = run(context, *module);
+  if (serial < 0 || parallel < 0) {
+    fprintf(stderr, "failed to convert the program to the core dialects\n");
+    return 1;
+  }
+
+  printf("functions:    %zu x %zu operations, %zu packages\n", numFunctions,
+         numOps, numPackages);
+  printf("1 thread:     %.3f s\n", serial);
+  printf("multithread:  %.3f s (%.2fx)\n", parallel, serial / parallel);
+  return 0;
+}
@@ -0,0 +1,119 @@
+//===- SymCacheBench.cpp - HW symbol cache lookup benchmark -----*- C++ -*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// Measure symbol lookup throughput with the access pattern of parallel
+// ExportVerilog: every module is emitted on its own thread and resolves the
+// inner symbols of its module and the modules it instantiates. Compares the
+// frozen HWSymbolCache against the DenseMap it used to look up directly.
+//
+// Usage: circt-symcache-bench [numModules] [numSymbols] [rounds]
+//
+//===----------------------------------------------------------------------===//
+
+#include "circt/Dialect/HW/HWDialect.h"
+#include "circt/Dialect/HW/HWOps.h"
+#include "circt/Dialect/HW/HWSymCache.h"
+#include "mlir/IR/ImplicitLocOpBuilder.h"
+#include "mlir/IR/Threading.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+using namespace mlir;
+using namespace circt;
+using namespace hw;
+
+/// Run 'lookup' on every symbol of every module, one module per task, 'rounds'
+/// times. Returns lookups per second.
+template <typename LookupFn>
+static double run(MLIRContext &context,
+                  ArrayRef<SmallVector<Attribute>> moduleSymbols,
+                  size_t rounds, LookupFn lookup) {
+  std::atomic<size_t> checksum(0);
+  size_t numLookups = 0;
+  for (auto &symbols : moduleSymbols)
+    numLookups += symbols.size() * rounds;
+
+  auto start = std::chrono::steady_clock::now();
+  mlir::parallelForEachN(&context, 0, moduleSymbols.size(), [&](size_t i) {
+    size_t sum = 0;
+    for (size_t round = 0; round < rounds; ++round)
+      for (auto symbol : moduleSymbols[i])
+        sum += lookup(symbol).getPort();
+    checksum += sum;
+  });
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+
+  // Keep the lookups from being optimized away.
+  if (checksum == 0)
+    printf("checksum: 0\n");
+  return numLookups / elapsed.count();
+}
+
+int main(int argc, char **argv) {
+  size_t numModules = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 2000;
+  size_t numSymbols = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 200;
+  size_t rounds = argc > 3 ? std::strtoull(argv[3], nullptr, 10) : 20;
+
+  MLIRContext context;
+  context.loadDialect<HWDialect>();
+  LocationAttr loc = UnknownLoc::get(&context);
+  OwningOpRef<ModuleOp> top = ModuleOp::create(loc);
+  auto builder = ImplicitLocOpBuilder::atBlockEnd(loc, top->getBody());
+
+  // Populate the cache the way ExportVerilog does: every module, and every
+  // inner symbol of every module.
+  HWSymbolCache cache;
+  SmallVector<StringAttr> symbolNames;
+  for (size_t j = 0; j < numSymbols; ++j)
+    symbolNames.push_back(StringAttr::get(&context, "sym" + Twine(j)));
+
+  SmallVector<HWModuleOp> modules;
+  for (size_t i = 0; i < numModules; ++i) {
+    auto name = StringAttr::get(&context, "Module" + Twine(i));
+    auto module = builder.create<HWModuleOp>(name, ArrayRef<PortInfo>{});
+    modules.push_back(module);
+    cache.addDefinition(name, module);
+    for (size_t j = 0; j < numSymbols; ++j)
+      cache.addDefinition(name, symbolNames[j], module, j + 1);
+  }
+
+  // The baseline is a copy of the table the cache is built from.
+  DenseMap<Attribute, HWSymbolCache::Item> baseline;
+  for (auto &module : modules)
+    for (size_t j = 0; j < numSymbols; ++j)
+      baseline.try_emplace(InnerRefAttr::get(module.getNameAttr(),
+                                             symbolNames[j]),
+                           module, j + 1);
+  cache.freeze();
+
+  // Every module looks up its own symbols and those of the next module, as if
+  // it instantiated it.
+  SmallVector<SmallVector<Attribute>> moduleSymbols(numModules);
+  for (size_t i = 0; i < numModules; ++i) {
+    for (auto *module : {&modules[i], &modules[(i + 1) % numModules]})
+      for (auto name : symbolNames)
+        moduleSymbols[i].push_back(
+            InnerRefAttr::get(module->getNameAttr(), name));
+  }
+
+  double denseMap = run(context, moduleSymbols, rounds, [&](Attribute attr) {
+    return baseline.find(attr)->second;
+  });
+  double frozen = run(context, moduleSymbols, rounds, [&](Attribute attr) {
+    return cache.getInnerDefinition(attr.cast<InnerRefAttr>());
+  });
+  printf("symbols:      %zu modules x %zu inner symbols\n", numModules,
+         numSymbols);
+  printf("DenseMap:     %.0f lookups/s\n", denseMap);
+  printf("frozen cache: %.0f lookups/s (%.2fx)\n", frozen, frozen / denseMap);
+  return 0;
+}
@@ -0,0 +1,114 @@
+//===- ClientBench.cpp - ESI cosim client throughput benchmark --*- C++ -*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// Measure cosim RPC throughput with and without request batching. Runs the real
+// `RpcServer` in-process with a loopback thread standing in for the simulator:
+// every message sent to the "simulation" is immediately queued back to the
+// client.
+//
+// Usage: EsiCosimClientBench [numMsgs] [batchSize] [port]
+//
+//===----------------------------------------------------------------------===//
+
+#include "circt/Dialect/ESI/cosim/CosimDpi.capnp.h"
+#include "circt/Dialect/ESI/cosim/Client.h"
+#include "circt/Dialect/ESI/cosim/Server.h"
+
+#include <capnp/ez-rpc.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+
+using namespace circt::esi::cosim;
+
+/// Payload size in bytes. 64 bytes is a typical streaming channel width.
+static constexpr size_t payloadBytes = 64;
+/// An UntypedData message with a 64-byte blob is 1 root pointer, 1 pointer
+/// section word, and 8 data words.
+using BenchEndpoint = ClientEndpoint<UntypedData, UntypedData,
+                                     /*endpointID=*/1, /*sendWords=*/10>;
+
+/// Send and receive 'numMsgs' messages, 'batch' at a time. Returns messages
+/// per second.
+static double run(BenchEndpoint &ep, size_t numMsgs, size_t batch,
+                  kj::WaitScope &ws) {
+  uint8_t payload[payloadBytes] = {0};
+  auto start = std::chrono::steady_clock::now();
+
+  size_t sent = 0, received = 0;
+  while (received < numMsgs) {
+    if (sent < numMsgs) {
+      size_t n = std::min(batch, numMsgs - sent);
+      ep.sendBatch(
+          n,
+          [&](size_t i, UntypedData::Builder msg) {
+            payload[0] = static_cast<uint8_t>(sent + i);
+            msg.setData(kj::arrayPtr(payload, payloadBytes));
+          },
+          ws);
+      sent += n;
+    }
+    received += ep.recvBatch(
+        batch, [](size_t, UntypedData::Reader) {}, ws);
+  }
+
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  return numMsgs / elapsed.count();
+}
+
+int main(int argc, char **argv) {
+  size_t numMsgs = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 2000;
+  size_t batch = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 256;
+  uint16_t port = argc > 3 ? std::strtoul(argv[3], nullptr, 10) : 48001;
+
+  // Server stand-in: the real RPC server plus a loopback "simulator".
+  RpcServer server;
+  server.endpoints.registerEndpoint(1, 0, payloadBytes * 8, 0,
+                                    payloadBytes * 8);
+  server.run(port);
+
+  std::atomic<bool> done(false);
+  std::thread loopback([&]() {
+    Endpoint *ep = server.endpoints[1];
+    Endpoint::BlobPtr msg;
+    while (!done) {
+      if (ep->getMessageToSim(msg))
+        ep->pushMessageToClient(msg);
+      else
+        std::this_thread::yield();
+    }
+  });
+
+  // Give the server thread a moment to start listening.
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+  {
+    capnp::EzRpcClient rpc("localhost", port);
+    auto &ws = rpc.getWaitScope();
+    auto cosim = rpc.getMain<CosimDpiServer>();
+    auto ep = BenchEndpoint::open(cosim, ws);
+
+    double unbatched = run(ep, numMsgs, 1, ws);
+    double batched = run(ep, numMsgs, batch, ws);
+    printf("messages:        %zu x %zu bytes\n", numMsgs, payloadBytes);
+    printf("batch size 1:    %.0f msgs/s\n", unbatched);
+    printf("batch size %zu: %.0f msgs/s (%.1fx)\n", batch, batched,
+           batched / unbatched);
+    ep.close(ws);
+  }
+
+  done = true;
+  loopback.join();
+  server.stop();
+  return 0;
+}
@@ -30,6 +30,8 @@ namespace esi {
 void registerESIPasses();
 void registerESITranslations();
 LogicalResult exportCosimSchema(ModuleOp module, llvm::raw_ostream &os);
+LogicalResult exportCosimClient(ModuleOp module, llvm::raw_ostream &os);
+LogicalResult exportCosimPackedCodec(ModuleOp module, llvm::raw_ostream &os);
 
 /// A triple of signals which represent a latency insensitive interface with
 /// valid/ready semantics.
@@ -118,3 +118,103 @@ module ESI_PipelineStage # (
     end
   end
 endmodule
+
+/// ESI_SkidBuffer: a zero-latency buffer which registers the backpressure. While
+/// the skid register is empty, tokens pass straight through. If the output
+/// stalls, the token which was in flight gets caught in the skid register and
+/// a_ready drops on the next cycle. There is no combinational path from x_ready
+/// to a_ready.
+module ESI_SkidBuffer # (
+  int WIDTH = 8
+) (
+  input logic clk,
+  input logic rstn,
+
+  // Input LI channel.
+  input logic a_valid,
+  input logic [WIDTH-1:0] a,
+  output logic a_ready,
+
+  // Output LI channel.
+  output logic x_valid,
+  output logic [WIDTH-1:0] x,
+  input logic x_ready
+);
+
+  // Skid register.
+  logic [WIDTH-1:0] s;
+  logic s_valid;
+
+  assign a_ready = ~s_valid;
+  assign x_valid = s_valid || a_valid;
+  assign x = s_valid ? s : a;
+
+  always_ff @(posedge clk) begin
+    if (~rstn) begin
+      s_valid <= 1'b0;
+    end else if (s_valid) begin
+      // Drain the skid register first. We aren't accepting tokens until then.
+      if (x_ready)
+        s_valid <= 1'b0;
+    end else if (a_valid && ~x_ready) begin
+      // We accepted a token but couldn't pass it on.
+      s <= a;
+      s_valid <= 1'b1;
+    end
+  end
+endmodule
+
+/// ESI_FIFO: a DEPTH entry FIFO with one cycle of latency. Both a_ready and
+/// x_valid are derived from the occupancy register, so there is no
+/// combinational path through this module. Sustains one token per cycle for
+/// DEPTH >= 2.
+module ESI_FIFO # (
+  int WIDTH = 8,
+  int DEPTH = 2
+) (
+  input logic clk,
+  input logic rstn,
+
+  // Input LI channel.
+  input logic a_valid,
+  input logic [WIDTH-1:0] a,
+  output logic a_ready,
+
+  // Output LI channel.
+  output logic x_valid,
+  output logic [WIDTH-1:0] x,
+  input logic x_ready
+);
+
+  localparam int PTR_WIDTH = DEPTH > 1 ? $clog2(DEPTH) : 1;
+
+  logic [WIDTH-1:0] mem [DEPTH];
+  logic [PTR_WIDTH-1:0] rdPtr, wrPtr;
+  logic [$clog2(DEPTH+1)-1:0] count;
+
+  assign a_ready = count != DEPTH;
+  assign x_valid = count != 0;
+  assign x = mem[rdPtr];
+
+  wire push = a_valid && a_ready;
+  wire pop = x_valid && x_ready;
+
+  always_ff @(posedge clk) begin
+    if (~rstn) begin
+      rdPtr <= '0;
+      wrPtr <= '0;
+      count <= '0;
+    end else begin
+      if (push) begin
+        mem[wrPtr] <= a;
+        wrPtr <= wrPtr == PTR_WIDTH'(DEPTH - 1) ? '0 : wrPtr + 1'b1;
+      end
+      if (pop)
+        rdPtr <= rdPtr == PTR_WIDTH'(DEPTH - 1) ? '0 : rdPtr + 1'b1;
+      if (push && ~pop)
+        count <= count + 1'b1;
+      else if (~push && pop)
+        count <= count - 1'b1;
+    end
+  end
+endmodule
@@ -0,0 +1,117 @@
+//===- Client.h - ESI cosim RPC client helpers ------------------*- C++ -*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// Typed, batched access to a cosim endpoint from C++. The client generated by
+// `circt-translate -export-esi-cosim-client` instantiates `ClientEndpoint` once
+// per `esi.cosim` op.
+//
+// Every RPC is a round trip through the simulator's polling loop, so issuing
+// one request at a time and waiting on it is latency bound. The batch methods
+// here issue all of their requests before waiting on any of them, letting
+// Cap'nProto pipeline them over the connection.
+//
+// This header does not include the capnp RPC schema. Include either
+// `CosimDpi.capnp.h` or the header generated from the `-export-esi-capnp`
+// schema (which embeds the RPC interfaces) first.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef CIRCT_DIALECT_ESI_COSIM_CLIENT_H
+#define CIRCT_DIALECT_ESI_COSIM_CLIENT_H
+
+#include <capnp/capability.h>
+#include <kj/async.h>
+#include <kj/vector.h>
+
+#include <cstddef>
+#include <cstdint>
+
+namespace circt {
+namespace esi {
+namespace cosim {
+
+/// A typed handle to an open endpoint. 'SendWords' is the size (in 64-bit
+/// words) of an encoded 'SendT' message and is used to size each request's
+/// message builder up front so that filling it in never has to allocate
+/// another segment.
+template <typename SendT, typename RecvT, int32_t EndpointID, size_t SendWords>
+class ClientEndpoint {
+public:
+  using SendType = SendT;
+  using RecvType = RecvT;
+  using Interface = ::EsiDpiEndpoint<SendT, RecvT>;
+  static constexpr int32_t endpointID = EndpointID;
+
+  explicit ClientEndpoint(typename Interface::Client client)
+      : client(kj::mv(client)) {}
+
+  /// Find this endpoint in the server's list and open it.
+  template <typename ServerClient>
+  static ClientEndpoint open(ServerClient &server, kj::WaitScope &ws) {
+    auto list = server.listRequest().send().wait(ws);
+    for (auto iface : list.getIfaces()) {
+      if (iface.getEndpointID() != EndpointID)
+        continue;
+      auto req = server.template openRequest<SendT, RecvT>();
+      req.setIface(iface);
+      return ClientEndpoint(req.send().wait(ws).getIface());
+    }
+    KJ_FAIL_REQUIRE("Endpoint is not registered", EndpointID);
+  }
+
+  /// Send 'count' messages. 'fill(i, builder)' populates the i-th message. All
+  /// of the requests are issued before any of them are waited on.
+  template <typename FillFn>
+  void sendBatch(size_t count, FillFn &&fill, kj::WaitScope &ws) {
+    // The send params struct adds a pointer and a struct header to the message.
+    const ::capnp::MessageSize sizeHint{SendWords + 2, 0};
+    kj::Vector<kj::Promise<void>> pending(count);
+    for (size_t i = 0; i < count; ++i) {
+      auto req = client.sendRequest(sizeHint);
+      fill(i, req.initMsg());
+      pending.add(req.send().ignoreResult());
+    }
+    kj::joinPromises(pending.releaseAsArray()).wait(ws);
+  }
+
+  /// Poll for up to 'max' messages by issuing 'max' non-blocking receives at
+  /// once. 'handle(i, reader)' is called in arrival order for each message
+  /// received. Returns the number of messages received.
+  template <typename HandleFn>
+  size_t recvBatch(size_t max, HandleFn &&handle, kj::WaitScope &ws) {
+    using RecvPromise =
+        ::capnp::RemotePromise<typename Interface::RecvResults>;
+    kj::Vector<RecvPromise> pending(max);
+    for (size_t i = 0; i < max; ++i) {
+      auto req = client.recvRequest();
+      req.setBlock(false);
+      pending.add(req.send());
+    }
+
+    size_t received = 0;
+    for (auto &promise : pending) {
+      auto resp = promise.wait(ws);
+      if (!resp.getHasData())
+        continue;
+      handle(received++, resp.getResp());
+    }
+    return received;
+  }
+
+  /// Close the endpoint so that it can be opened again.
+  void close(kj::WaitScope &ws) { client.closeRequest().send().wait(ws); }
+
+private:
+  typename Interface::Client client;
+};
+
+} // namespace cosim
+} // namespace esi
+} // namespace circt
+
+#endif
@@ -358,6 +358,11 @@ public:
   /// ID targeting the same field, but rebased on the sub-type.
   std::pair<FIRRTLType, unsigned> getSubTypeByFieldID(unsigned fieldID);
 
+  /// Return the final type targeted by this field ID by walking all nested
+  /// aggregate types. Bundles with a moderate number of fields build a flat
+  /// field ID table the first time this is called, making it constant time.
+  FIRRTLType getFinalTypeByFieldID(unsigned fieldID);
+
   /// Get the maximum field ID in this bundle.  This is helpful for constructing
   /// field IDs when this BundleType is nested in another aggregate type.
   unsigned getMaxFieldID();
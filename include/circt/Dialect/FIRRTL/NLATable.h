@@ -13,6 +13,7 @@
 #define CIRCT_DIALECT_FIRRTL_NLATABLE_H
 
 #include "circt/Dialect/FIRRTL/FIRRTLOps.h"
+#include "circt/Dialect/HW/HWAttributes.h"
 #include "circt/Support/LLVM.h"
 #include "llvm/ADT/STLExtras.h"
 #include "llvm/ADT/SetOperations.h"
@@ -44,6 +45,20 @@ public:
   /// NLATable.
   ArrayRef<HierPathOp> lookup(StringAttr name);
 
+  /// Lookup all NLAs whose namepath contains the inner reference `ref`. This
+  /// returns a reference to the internal record, so make a copy before making
+  /// any update to the NLATable.
+  ArrayRef<HierPathOp> lookupInnerRef(hw::InnerRefAttr ref);
+
+  /// Return the position of the inner reference `ref` in the namepath of
+  /// `nla`, or None if the namepath does not contain it.
+  Optional<unsigned> getInnerRefPosition(HierPathOp nla, hw::InnerRefAttr ref) {
+    auto it = innerRefPositions.find({nla, ref});
+    if (it == innerRefPositions.end())
+      return None;
+    return it->second;
+  }
+
   /// Resolve a symbol to an NLA.
   HierPathOp getNLA(StringAttr name);
 
@@ -73,18 +88,16 @@ public:
     // in any NLA.
     if (!instSym)
       return;
-    auto mod = inst->getParentOfType<FModuleOp>().getNameAttr();
-    // Get the NLAs that are common between the parent module and the target
-    // module. This should contain the NLAs that this InstanceOp participates
-    // in.
-    commonNLAs(inst->getParentOfType<FModuleOp>().getNameAttr(),
-               inst.moduleNameAttr().getAttr(), nlas);
-    // Handle the case when there are more than one Instances for the same
-    // target module. Getting the `commonNLA`, in that case is not enough,
-    // remove the NLAs that donot have the InstanceOp as the innerSym.
-    for (auto nla : llvm::make_early_inc_range(nlas)) {
-      if (!nla.hasInnerSym(mod, instSym))
-        nlas.erase(nla);
+    auto ref = hw::InnerRefAttr::get(
+        inst->getParentOfType<FModuleOp>().getNameAttr(), instSym);
+    auto target = inst.moduleNameAttr().getAttr();
+    // The NLAs this InstanceOp participates in are the NLAs which name the
+    // InstanceOp's innerSym and continue into the target module. NLAs which
+    // end at the InstanceOp are not included.
+    for (auto nla : lookupInnerRef(ref)) {
+      unsigned pos = *getInnerRefPosition(nla, ref);
+      if (pos + 1 < nla.namepath().size() && nla.modPart(pos + 1) == target)
+        nlas.insert(nla);
     }
   }
 
@@ -102,21 +115,29 @@ public:
   // properly synchronized or performed in a serial context.  When the
   // NLATable is used as an analysis, this is only safe when the pass is
   // on a CircuitOp.
+  //
+  // The inner reference index is built from the namepath of an NLA when it is
+  // added. To modify the namepath of an NLA directly, erase the NLA from the
+  // table before the update and add it again afterwards.
 
-  /// Insert a new NLA. This updates two internal records,
+  /// Insert a new NLA. This updates three internal records,
   /// 1. Update the map for the `nlaOp` name to the Operation.
   /// 2. For each module in the NLA namepath, insert the NLA into the list of
   /// HierPathOps that participate in the corresponding module. This does
   /// not update the module name to module op map, if any potentially new module
   /// in the namepath does not already exist in the record.
+  /// 3. For each inner reference in the NLA namepath, record the NLA and the
+  /// position of the inner reference.
   void addNLA(HierPathOp nla);
 
-  /// Remove the NLA from the analysis. This updates two internal records,
+  /// Remove the NLA from the analysis. This updates three internal records,
   /// 1. Remove the NLA name to the operation map entry.
   /// 2. For each module in the namepath of the NLA, remove the entry from the
   ///    list of NLAs that the module participates in.
+  /// 3. For each inner reference in the namepath of the NLA, remove the entry
+  ///    from the inner reference index.
   /// Note that this invalidates any reference to the NLA list returned by
-  /// 'lookup'.
+  /// 'lookup' or 'lookupInnerRef'.
   void erase(HierPathOp nlaOp, SymbolTable *symbolTable = nullptr);
 
   /// Record a new FModuleLike operation. This updates the Module name to Module
@@ -184,11 +205,25 @@ public:
 private:
   NLATable(const NLATable &) = delete;
 
+  /// Add the inner references in the namepath of `nla` to the index.
+  void addInnerRefs(HierPathOp nla);
+
+  /// Remove the inner references in the namepath of `nla` from the index.
+  void eraseInnerRefs(HierPathOp nla);
+
   /// Map modules to the NLA's that target them.
   llvm::DenseMap<StringAttr, SmallVector<HierPathOp, 4>> nodeMap;
 
   /// Map symbol names to module and NLA operations.
   llvm::DenseMap<StringAttr, Operation *> symToOp;
+
+  /// Map inner references to the NLA's that pass through them.
+  llvm::DenseMap<hw::InnerRefAttr, SmallVector<HierPathOp, 1>> innerRefMap;
+
+  /// Map an NLA and an inner reference in its namepath to the position of the
+  /// inner reference.
+  llvm::DenseMap<std::pair<HierPathOp, hw::InnerRefAttr>, unsigned>
+      innerRefPositions;
 };
 
 } // namespace firrtl
@@ -11,6 +11,9 @@
 
 #include "mlir/IR/Attributes.h"
 #include "mlir/IR/BuiltinAttributes.h"
+#include "mlir/Support/ThreadLocalCache.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/Support/Allocator.h"
 
 namespace circt {
 namespace hw {
@@ -41,6 +44,40 @@ evaluateParametricAttr(mlir::Location loc, mlir::ArrayAttr parameters,
 /// Returns true if any part of t is parametric.
 bool isParametricType(mlir::Type t);
 
+namespace detail {
+/// Memoized parameter expression canonicalization results of a context.
+/// Every thread has its own cache, so lookups never take a lock.  Each cache
+/// keeps two generations of at most `maxEntries` expressions: when the
+/// current generation is full it replaces the previous one, and expressions
+/// found in the previous generation move back into the current one.  Only
+/// expressions which have not been used for a whole generation are evicted.
+struct ParamExprCache {
+  static constexpr size_t maxEntries = 1 << 14;
+
+  using Key = std::pair<unsigned, llvm::ArrayRef<mlir::Attribute>>;
+
+  struct Generation {
+    /// The canonical form of recently built (opcode, operands) expressions.
+    /// The operand arrays are owned by `allocator`.
+    llvm::DenseMap<Key, mlir::Attribute> canonical;
+    llvm::BumpPtrAllocator allocator;
+  };
+
+  struct ThreadCache {
+    Generation current, previous;
+
+    /// Return the cached canonical form of an expression, or null.
+    mlir::Attribute lookup(const Key &key);
+
+    /// Record the canonical form of an expression, starting a new generation
+    /// if the current one is full.
+    void insert(const Key &key, mlir::Attribute result);
+  };
+
+  mlir::ThreadLocalCache<ThreadCache> threadCaches;
+};
+} // namespace detail
+
 } // namespace hw
 } // namespace circt
 
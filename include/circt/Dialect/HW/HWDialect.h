@@ -17,6 +17,14 @@
 #include "mlir/IR/BuiltinAttributes.h"
 #include "mlir/IR/Dialect.h"
 
+namespace circt {
+namespace hw {
+namespace detail {
+struct ParamExprCache;
+} // namespace detail
+} // namespace hw
+} // namespace circt
+
 // Pull in the dialect definition.
 #include "circt/Dialect/HW/HWDialect.h.inc"
 
@@ -28,6 +28,7 @@ class HWSymbolCache : public SymbolCacheBase {
 public:
   class Item {
   public:
+    Item() : op(nullptr), port(~0ULL) {}
     Item(mlir::Operation *op) : op(op), port(~0ULL) {}
     Item(mlir::Operation *op, size_t port) : op(op), port(port) {}
     bool hasPort() const { return port != ~0ULL; }
@@ -42,6 +43,7 @@ public:
   // Add inner names, which might be ports
   void addDefinition(mlir::StringAttr modSymbol, mlir::StringAttr name,
                      mlir::Operation *op, size_t port = ~0ULL) {
+    assert(!isFrozen && "cannot mutate a frozen cache");
     auto key = InnerRefAttr::get(modSymbol, name);
     symbolCache.try_emplace(key, op, port);
   }
@@ -55,11 +57,11 @@ public:
   using SymbolCacheBase::getDefinition;
   mlir::Operation *getDefinition(mlir::Attribute attr) const override {
     assert(isFrozen && "cannot read from this cache until it is frozen");
-    auto it = symbolCache.find(attr);
-    if (it == symbolCache.end())
+    auto *item = frozenCache.lookup(attr);
+    if (!item)
       return nullptr;
-    assert(!it->second.hasPort() && "Module names should never be ports");
-    return it->second.getOp();
+    assert(!item->hasPort() && "Module names should never be ports");
+    return item->getOp();
   }
 
   HWSymbolCache::Item getInnerDefinition(mlir::StringAttr modSymbol,
@@ -72,13 +74,17 @@ public:
   }
 
   /// Mark the cache as frozen, which allows it to be shared across threads.
-  void freeze() { isFrozen = true; }
+  /// This builds the lookup table which all queries are answered from.
+  void freeze() {
+    frozenCache.build(symbolCache);
+    isFrozen = true;
+  }
 
 private:
   Item lookupInner(InnerRefAttr attr) const {
     assert(isFrozen && "cannot read from this cache until it is frozen");
-    auto it = symbolCache.find(attr);
-    return it == symbolCache.end() ? Item{nullptr, ~0ULL} : it->second;
+    auto *item = frozenCache.lookup(attr);
+    return item ? *item : Item();
   }
 
   bool isFrozen = false;
@@ -87,6 +93,9 @@ private:
   /// that defines it.
   llvm::DenseMap<mlir::Attribute, Item> symbolCache;
 
+  /// The read-only copy of `symbolCache` which lookups use once frozen.
+  FrozenSymbolTable<Item> frozenCache;
+
 private:
   // Iterator support. Map from Item's to their inner operations.
   using Iterator = decltype(symbolCache)::iterator;
@@ -0,0 +1,189 @@
+//===- InstanceGraphLevels.h - Level-synchronous module traversal -*- C++ -*-=//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// This file defines a dense numbering of the modules in an instance graph and
+// helpers to run inter-module analyses over it bottom-up or top-down, with all
+// modules on the same level of the hierarchy processed in parallel.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef CIRCT_DIALECT_HW_INSTANCEGRAPHLEVELS_H
+#define CIRCT_DIALECT_HW_INSTANCEGRAPHLEVELS_H
+
+#include "circt/Dialect/HW/InstanceGraphBase.h"
+#include "circt/Support/LLVM.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallVector.h"
+
+namespace circt {
+namespace hw {
+
+/// A dense numbering of the modules in an instance graph, grouped into levels.
+/// A module which does not instantiate anything is on level 0, and every other
+/// module is one level above the highest module it instantiates.  Modules on
+/// the same level never instantiate each other, so they can be processed
+/// independently once every level below them (for a bottom-up traversal) or
+/// above them (for a top-down traversal) is done.
+///
+/// Modules are numbered level by level, and in the order of the instance graph
+/// within a level, so indices are deterministic.  The instance graph must not
+/// be modified while the numbering is in use.
+class InstanceGraphLevels {
+public:
+  /// Number the modules of an instance graph.  If the instance graph contains
+  /// a cycle, an error is emitted on one of the modules on it, with a note for
+  /// every instance along the cycle, and failure is returned.
+  static FailureOr<InstanceGraphLevels> get(InstanceGraphBase &graph);
+
+  /// Return the number of modules.
+  size_t size() const { return nodes.size(); }
+
+  /// Return all modules in bottom-up order.  The position of a module in this
+  /// array is its index.
+  ArrayRef<InstanceGraphNode *> getNodes() const { return nodes; }
+
+  /// Return the module with the given index.
+  InstanceGraphNode *getNode(unsigned index) const { return nodes[index]; }
+
+  /// Return true if the node is numbered.  Only modules are numbered, not
+  /// synthetic nodes such as the entry node of an `hw::InstanceGraph`.
+  bool contains(InstanceGraphNode *node) const { return indices.count(node); }
+
+  /// Return the index of a module.
+  unsigned getIndex(InstanceGraphNode *node) const {
+    auto it = indices.find(node);
+    assert(it != indices.end() && "module is not in the instance graph");
+    return it->second;
+  }
+
+  /// Return the number of levels.
+  unsigned getNumLevels() const { return levelBegins.size() - 1; }
+
+  /// Return the modules on a level.
+  ArrayRef<InstanceGraphNode *> getLevel(unsigned level) const {
+    return getNodes().slice(levelBegins[level],
+                            levelBegins[level + 1] - levelBegins[level]);
+  }
+
+  /// Return the level of a module.
+  unsigned getLevelOf(InstanceGraphNode *node) const;
+
+private:
+  InstanceGraphLevels() = default;
+
+  /// The modules, sorted by level.
+  SmallVector<InstanceGraphNode *> nodes;
+
+  /// The index of every module in `nodes`.
+  DenseMap<InstanceGraphNode *, unsigned> indices;
+
+  /// The index of the first module of every level, followed by the number of
+  /// modules.
+  SmallVector<unsigned> levelBegins;
+};
+
+/// Call `fn` on every module, bottom-up.  A module is only visited after every
+/// module it instantiates.  Modules on the same level are visited in parallel
+/// if multithreading is enabled in `context`.
+void parallelForEachBottomUp(MLIRContext *context,
+                             const InstanceGraphLevels &levels,
+                             function_ref<void(InstanceGraphNode *)> fn);
+
+/// Call `fn` on every module, top-down.  A module is only visited after every
+/// module which instantiates it.  Modules on the same level are visited in
+/// parallel if multithreading is enabled in `context`.
+void parallelForEachTopDown(MLIRContext *context,
+                            const InstanceGraphLevels &levels,
+                            function_ref<void(InstanceGraphNode *)> fn);
+
+/// Call `fn` on every module bottom-up, like `parallelForEachBottomUp`.  If
+/// `fn` fails on any module, the traversal stops after the current level and
+/// failure is returned.
+LogicalResult
+failableParallelForEachBottomUp(MLIRContext *context,
+                                const InstanceGraphLevels &levels,
+                                function_ref<LogicalResult(InstanceGraphNode *)>
+                                    fn);
+
+/// Call `fn` on every module top-down, like `parallelForEachTopDown`.  If `fn`
+/// fails on any module, the traversal stops after the current level and
+/// failure is returned.
+LogicalResult
+failableParallelForEachTopDown(MLIRContext *context,
+                               const InstanceGraphLevels &levels,
+                               function_ref<LogicalResult(InstanceGraphNode *)>
+                                   fn);
+
+/// A per-module result of an inter-module analysis, stored densely by module
+/// index.
+template <typename T>
+class ModuleSummaries {
+public:
+  explicit ModuleSummaries(const InstanceGraphLevels &levels)
+      : levels(levels), summaries(levels.size()) {}
+
+  const T &operator[](InstanceGraphNode *node) const {
+    return summaries[levels.getIndex(node)];
+  }
+  T &operator[](InstanceGraphNode *node) {
+    return summaries[levels.getIndex(node)];
+  }
+
+  /// Return the summary of the module containing an instance, or null if the
+  /// instance record comes from a node which is not numbered, such as the
+  /// entry node of an `hw::InstanceGraph`.
+  const T *getParentSummary(InstanceRecord *record) const {
+    auto *parent = record->getParent();
+    if (!levels.contains(parent))
+      return nullptr;
+    return &(*this)[parent];
+  }
+
+  /// Return the summaries in module index order.
+  ArrayRef<T> getSummaries() const { return summaries; }
+
+private:
+  const InstanceGraphLevels &levels;
+  SmallVector<T> summaries;
+};
+
+/// Compute a summary of every module bottom-up.  `summarize(node, summaries)`
+/// returns the summary of `node`, and may read the summaries of every module
+/// `node` instantiates.  Each summary is only written by the task computing
+/// it, so the result does not depend on the order modules are processed in.
+template <typename T, typename SummarizeFn>
+ModuleSummaries<T> summarizeBottomUp(MLIRContext *context,
+                                     const InstanceGraphLevels &levels,
+                                     SummarizeFn &&summarize) {
+  ModuleSummaries<T> summaries(levels);
+  parallelForEachBottomUp(context, levels, [&](InstanceGraphNode *node) {
+    summaries[node] = summarize(node, std::as_const(summaries));
+  });
+  return summaries;
+}
+
+/// Compute a summary of every module top-down.  `summarize(node, summaries)`
+/// returns the summary of `node`, and may read the summaries of every module
+/// which instantiates `node`.  Uses of a module may come from nodes which are
+/// not modules, like the entry node of an `hw::InstanceGraph`, so read them
+/// with `ModuleSummaries::getParentSummary`.
+template <typename T, typename SummarizeFn>
+ModuleSummaries<T> summarizeTopDown(MLIRContext *context,
+                                    const InstanceGraphLevels &levels,
+                                    SummarizeFn &&summarize) {
+  ModuleSummaries<T> summaries(levels);
+  parallelForEachTopDown(context, levels, [&](InstanceGraphNode *node) {
+    summaries[node] = summarize(node, std::as_const(summaries));
+  });
+  return summaries;
+}
+
+} // namespace hw
+} // namespace circt
+
+#endif // CIRCT_DIALECT_HW_INSTANCEGRAPHLEVELS_H
@@ -17,6 +17,14 @@
 #include "mlir/IR/BuiltinOps.h"
 #include "mlir/IR/Dialect.h"
 
+namespace circt {
+namespace moore {
+namespace detail {
+struct TypeLayoutCache;
+} // namespace detail
+} // namespace moore
+} // namespace circt
+
 // Pull in the dialect definition.
 #include "circt/Dialect/Moore/MooreDialect.h.inc"
 
@@ -18,6 +18,7 @@
 #include "mlir/IR/BuiltinAttributes.h"
 #include "mlir/IR/Location.h"
 #include "mlir/IR/Types.h"
+#include "llvm/Support/RWMutex.h"
 #include <variant>
 
 namespace circt {
@@ -223,7 +224,23 @@ Os &operator<<(Os &os, const SimpleBitVectorType &type) {
   return os;
 }
 
+/// The bit-level layout of a type: its size in bits and the simple bit vector
+/// it is equivalent to. See `UnpackedType::getLayout`.
+struct TypeLayout {
+  /// The size in bits, or `None` if the type has no fixed size.
+  Optional<unsigned> bitSize;
+  /// The type as a simple bit vector, or null if it is not one.
+  SimpleBitVectorType sbv;
+};
+
 namespace detail {
+/// The memoized `TypeLayout`s of all types in a context. Owned by the
+/// `MooreDialect` and safe to use from multiple threads.
+struct TypeLayoutCache {
+  llvm::sys::SmartRWMutex<true> mutex;
+  DenseMap<Type, TypeLayout> layouts;
+};
+
 struct RealTypeStorage;
 struct IntTypeStorage;
 struct IndirectTypeStorage;
@@ -306,15 +323,22 @@ public:
   /// Get the sign for this type.
   Sign getSign() const;
 
+  /// Get the bit size and simple bit vector form of this type. Laying out an
+  /// array, struct, or named type walks all of its nested types, so these are
+  /// computed once per context and memoized in the dialect.
+  TypeLayout getLayout() const;
+
   /// Get the size of this type in bits.
   ///
   /// Returns `None` if any of the type's dimensions is unsized, associative, or
   /// a queue, or the core type itself has no known size.
-  Optional<unsigned> getBitSize() const;
+  Optional<unsigned> getBitSize() const { return getLayout().bitSize; }
 
   /// Get this type as a simple bit vector, if it is one. Returns a null type
   /// otherwise.
-  SimpleBitVectorType getSimpleBitVectorOrNull() const;
+  SimpleBitVectorType getSimpleBitVectorOrNull() const {
+    return getLayout().sbv;
+  }
 
   /// Check whether this is a simple bit vector type.
   bool isSimpleBitVector() const { return !!getSimpleBitVectorOrNull(); }
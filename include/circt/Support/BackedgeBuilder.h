@@ -17,9 +17,11 @@
 
 #include "mlir/IR/Location.h"
 #include "mlir/IR/Value.h"
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/SmallVector.h"
 
 namespace mlir {
+class Block;
 class OpBuilder;
 class PatternRewriter;
 class Operation;
@@ -34,6 +36,13 @@ class Backedge;
 /// this class is destructed, usually at the end of a scope. It will check that
 /// invariant then erase all the backedge ops during destruction.
 ///
+/// Backedges are not an op each. The backedges of a type created in a block
+/// are handed out as the results of a shared placeholder op, and a new one
+/// twice as large is created when it runs out. Lowerings creating many
+/// backedges therefore only allocate a handful of ops, and erase them all at
+/// once when the builder is cleared. A placeholder op whose backedges are
+/// still in use when the builder is cleared is shrunk to only those results.
+///
 /// Example use:
 /// ```
 ///   circt::BackedgeBuilder back(rewriter, loc);
@@ -68,10 +77,24 @@ public:
   void abandon();
 
 private:
+  /// A placeholder op whose results are handed out as backedges.
+  struct Pool {
+    mlir::Operation *op = nullptr;
+    unsigned numUsed = 0;
+  };
+
   mlir::OpBuilder &builder;
   mlir::PatternRewriter *rewriter;
   mlir::Location loc;
-  llvm::SmallVector<mlir::Operation *, 16> edges;
+
+  /// The placeholder op currently handing out backedges of a type in a block.
+  llvm::DenseMap<std::pair<mlir::Type, mlir::Block *>, Pool> pools;
+
+  /// Every placeholder op created, in order.
+  llvm::SmallVector<mlir::Operation *, 4> poolOps;
+
+  /// Every backedge handed out, and the location it was requested with.
+  llvm::SmallVector<std::pair<mlir::Value, mlir::Location>, 16> edges;
 };
 
 /// `Backedge` is a wrapper class around a `Value`. When assigned another
@@ -81,7 +104,7 @@ class Backedge {
   friend class BackedgeBuilder;
 
   /// `Backedge` is constructed exclusively by `BackedgeBuilder`.
-  Backedge(mlir::Operation *op);
+  Backedge(mlir::Value value);
 
 public:
   Backedge() {}
@@ -14,8 +14,10 @@
 #define CIRCT_SUPPORT_SYMCACHE_H
 
 #include "mlir/IR/SymbolTable.h"
+#include "llvm/ADT/SmallVector.h"
 #include "llvm/ADT/iterator.h"
 #include "llvm/Support/Casting.h"
+#include "llvm/Support/MathExtras.h"
 
 namespace circt {
 
@@ -77,6 +79,60 @@ public:
   virtual Iterator end() = 0;
 };
 
+/// An immutable hash table from symbol attributes to values, built when a
+/// symbol cache is frozen.  The keys live in an open-addressed array of their
+/// own, apart from the values, so probing only walks densely packed pointers.
+/// The table is kept at most half full, so a lookup usually touches a single
+/// cache line of keys before reading its value.  Since it is never modified
+/// once built, any number of threads can read it without synchronization.
+template <typename ValueT>
+class FrozenSymbolTable {
+public:
+  /// Build the table from a range of unique (key, value) pairs, replacing its
+  /// previous contents.
+  template <typename RangeT>
+  void build(const RangeT &entries) {
+    size_t size = std::distance(entries.begin(), entries.end());
+    size_t capacity = llvm::PowerOf2Ceil(std::max<size_t>(2 * size, 8));
+    shift = 64 - llvm::Log2_64(capacity);
+    keys.assign(capacity, nullptr);
+    values.assign(capacity, ValueT());
+    for (auto &entry : entries) {
+      const void *key = entry.first.getAsOpaquePointer();
+      size_t slot = getSlot(key);
+      while (keys[slot])
+        slot = (slot + 1) & (capacity - 1);
+      keys[slot] = key;
+      values[slot] = entry.second;
+    }
+  }
+
+  /// Return the value for a key, or null if it is not in the table.
+  const ValueT *lookup(mlir::Attribute attr) const {
+    if (keys.empty())
+      return nullptr;
+    const void *key = attr.getAsOpaquePointer();
+    for (size_t slot = getSlot(key);; slot = (slot + 1) & (keys.size() - 1)) {
+      if (keys[slot] == key)
+        return &values[slot];
+      if (!keys[slot])
+        return nullptr;
+    }
+  }
+
+private:
+  /// Attributes are uniqued pointers with their low bits clear, so use a
+  /// Fibonacci hash of the pointer, which takes the well mixed high bits.
+  size_t getSlot(const void *key) const {
+    auto bits = static_cast<uint64_t>(reinterpret_cast<uintptr_t>(key));
+    return (bits * 0x9E3779B97F4A7C15ULL) >> shift;
+  }
+
+  llvm::SmallVector<const void *, 0> keys;
+  llvm::SmallVector<ValueT, 0> values;
+  unsigned shift = 0;
+};
+
 /// Default symbol cache implementation; stores associations between names
 /// (StringAttr's) to mlir::Operation's.
 /// Adding/getting definitions from the symbol cache is not
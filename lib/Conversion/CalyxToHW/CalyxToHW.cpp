@@ -22,6 +22,7 @@
 #include "circt/Dialect/SV/SVOps.h"
 #include "circt/Dialect/Seq/SeqOps.h"
 #include "mlir/IR/ImplicitLocOpBuilder.h"
+#include "mlir/IR/Threading.h"
 #include "mlir/Transforms/DialectConversion.h"
 #include "llvm/ADT/TypeSwitch.h"
 
@@ -35,74 +36,6 @@ using namespace circt::sv;
 
 /// ConversionPatterns.
 
-struct ConvertProgramOp : public OpConversionPattern<ProgramOp> {
-  using OpConversionPattern::OpConversionPattern;
-
-  LogicalResult
-  matchAndRewrite(ProgramOp program, OpAdaptor adaptor,
-                  ConversionPatternRewriter &rewriter) const override {
-    ModuleOp mod = program->getParentOfType<ModuleOp>();
-    rewriter.inlineRegionBefore(program.body(), &mod.getBodyRegion().front());
-    rewriter.eraseBlock(&mod.getBodyRegion().back());
-    return success();
-  }
-};
-
-struct ConvertComponentOp : public OpConversionPattern<ComponentOp> {
-  using OpConversionPattern::OpConversionPattern;
-
-  LogicalResult
-  matchAndRewrite(ComponentOp component, OpAdaptor adaptor,
-                  ConversionPatternRewriter &rewriter) const override {
-    SmallVector<hw::PortInfo> hwInputInfo;
-    for (auto [name, type, direction, _] : component.getPortInfo())
-      hwInputInfo.push_back({name, hwDirection(direction), type});
-
-    auto hwMod = rewriter.create<HWModuleOp>(
-        component.getLoc(), component.getNameAttr(), hwInputInfo);
-
-    rewriter.eraseOp(hwMod.getBodyBlock()->getTerminator());
-    ConversionPatternRewriter::InsertionGuard g(rewriter);
-    rewriter.setInsertionPointToEnd(hwMod.getBodyBlock());
-
-    SmallVector<Value> argValues;
-    SmallVector<Value> outputWires;
-    size_t portIdx = 0;
-    for (auto [name, type, direction, _] : component.getPortInfo()) {
-      switch (direction) {
-      case calyx::Direction::Input:
-        assert(hwMod.getArgument(portIdx).getType() == type);
-        argValues.push_back(hwMod.getArgument(portIdx));
-        break;
-      case calyx::Direction::Output:
-        auto wire = rewriter.create<sv::WireOp>(component.getLoc(), type, name);
-        auto wireRead =
-            rewriter.create<sv::ReadInOutOp>(component.getLoc(), wire);
-        argValues.push_back(wireRead);
-        outputWires.push_back(wireRead);
-        break;
-      }
-      ++portIdx;
-    }
-
-    rewriter.mergeBlocks(component.getBody(), hwMod.getBodyBlock(), argValues);
-    rewriter.create<OutputOp>(component.getLoc(), outputWires);
-    rewriter.eraseOp(component);
-
-    return success();
-  }
-
-private:
-  hw::PortDirection hwDirection(calyx::Direction dir) const {
-    switch (dir) {
-    case calyx::Direction::Input:
-      return hw::PortDirection::INPUT;
-    case calyx::Direction::Output:
-      return hw::PortDirection::OUTPUT;
-    }
-  }
-};
-
 struct ConvertWiresOp : public OpConversionPattern<WiresOp> {
   using OpConversionPattern::OpConversionPattern;
 
@@ -140,10 +73,10 @@ struct ConvertAssignOp : public OpConversionPattern<calyx::AssignOp> {
                   ConversionPatternRewriter &rewriter) const override {
     Value dest = adaptor.dest();
 
-    // To make life easy in ConvertComponentOp, we read from the output wires so
-    // the dialect conversion block argument mapping would work without a type
-    // converter. This means assigns to ComponentOp outputs will try to assign
-    // to a read from a wire, so we need to map to the wire.
+    // To make life easy in convertComponentSignature, we replace the output
+    // ports with reads from the output wires, so the ports can be replaced
+    // without a type converter. This means assigns to ComponentOp outputs will
+    // try to assign to a read from a wire, so we need to map to the wire.
     if (auto readInOut = dyn_cast<ReadInOutOp>(adaptor.dest().getDefiningOp()))
       dest = readInOut.input();
 
@@ -410,44 +343,114 @@ private:
   }
 };
 
+/// Component signatures.
+
+static hw::PortDirection hwDirection(calyx::Direction dir) {
+  switch (dir) {
+  case calyx::Direction::Input:
+    return hw::PortDirection::INPUT;
+  case calyx::Direction::Output:
+    return hw::PortDirection::OUTPUT;
+  }
+  llvm_unreachable("unknown calyx direction");
+}
+
+/// Create the hw.module of a component, and move the body of the component
+/// into it.  Output ports are driven through wires, which the assignments to
+/// them are later rewritten to.  The cells, wires and control of the body are
+/// left to the conversion patterns.
+static HWModuleOp convertComponentSignature(ComponentOp component,
+                                            OpBuilder &builder) {
+  SmallVector<hw::PortInfo> hwInputInfo;
+  for (auto [name, type, direction, _] : component.getPortInfo())
+    hwInputInfo.push_back({name, hwDirection(direction), type});
+
+  builder.setInsertionPoint(component);
+  auto hwMod = builder.create<HWModuleOp>(
+      component.getLoc(), component.getNameAttr(), hwInputInfo);
+
+  Operation *terminator = hwMod.getBodyBlock()->getTerminator();
+  builder.setInsertionPoint(terminator);
+
+  SmallVector<Value> argValues;
+  SmallVector<Value> outputWires;
+  size_t portIdx = 0;
+  for (auto [name, type, direction, _] : component.getPortInfo()) {
+    switch (direction) {
+    case calyx::Direction::Input:
+      assert(hwMod.getArgument(portIdx).getType() == type);
+      argValues.push_back(hwMod.getArgument(portIdx));
+      break;
+    case calyx::Direction::Output:
+      auto wire = builder.create<sv::WireOp>(component.getLoc(), type, name);
+      auto wireRead = builder.create<sv::ReadInOutOp>(component.getLoc(), wire);
+      argValues.push_back(wireRead);
+      outputWires.push_back(wireRead);
+      break;
+    }
+    ++portIdx;
+  }
+
+  Block *body = component.getBody();
+  for (auto [arg, value] : llvm::zip(body->getArguments(), argValues))
+    arg.replaceAllUsesWith(value);
+  hwMod.getBodyBlock()->getOperations().splice(terminator->getIterator(),
+                                               body->getOperations());
+  builder.create<OutputOp>(component.getLoc(), outputWires);
+  terminator->erase();
+  component.erase();
+
+  return hwMod;
+}
+
 /// Pass entrypoint.
 
 namespace {
 class CalyxToHWPass : public CalyxToHWBase<CalyxToHWPass> {
 public:
   void runOnOperation() override;
-
-private:
-  LogicalResult runOnProgram(ProgramOp program);
 };
 } // end anonymous namespace
 
 void CalyxToHWPass::runOnOperation() {
   ModuleOp mod = getOperation();
-  for (auto program : llvm::make_early_inc_range(mod.getOps<ProgramOp>()))
-    if (failed(runOnProgram(program)))
-      return signalPassFailure();
-}
-
-LogicalResult CalyxToHWPass::runOnProgram(ProgramOp program) {
   MLIRContext &context = getContext();
 
-  ConversionTarget target(context);
-  target.addIllegalDialect<CalyxDialect>();
-  target.addLegalDialect<HWDialect>();
-  target.addLegalDialect<CombDialect>();
-  target.addLegalDialect<SeqDialect>();
-  target.addLegalDialect<SVDialect>();
-
-  RewritePatternSet patterns(&context);
-  patterns.add<ConvertProgramOp>(&context);
-  patterns.add<ConvertComponentOp>(&context);
-  patterns.add<ConvertWiresOp>(&context);
-  patterns.add<ConvertControlOp>(&context);
-  patterns.add<ConvertCellOp>(&context);
-  patterns.add<ConvertAssignOp>(&context);
-
-  return applyPartialConversion(program, target, std::move(patterns));
+  // Create the hw.module of every component and inline the programs into the
+  // enclosing module.  This changes the body of the module, so it is done
+  // serially, before any component body is converted.
+  SmallVector<HWModuleOp> hwModules;
+  OpBuilder builder(&context);
+  for (auto program : llvm::make_early_inc_range(mod.getOps<ProgramOp>())) {
+    for (auto component :
+         llvm::make_early_inc_range(program.getOps<ComponentOp>()))
+      hwModules.push_back(convertComponentSignature(component, builder));
+    mod.getBody()->getOperations().splice(program->getIterator(),
+                                          program.getBody()->getOperations());
+    program.erase();
+  }
+
+  // A component body only refers to its own cells and ports, so the bodies
+  // can be converted in parallel.  The patterns are frozen once and shared.
+  RewritePatternSet owningPatterns(&context);
+  owningPatterns.add<ConvertWiresOp>(&context);
+  owningPatterns.add<ConvertControlOp>(&context);
+  owningPatterns.add<ConvertCellOp>(&context);
+  owningPatterns.add<ConvertAssignOp>(&context);
+  FrozenRewritePatternSet patterns(std::move(owningPatterns));
+
+  auto result = mlir::failableParallelForEach(
+      &context, hwModules, [&](HWModuleOp hwMod) {
+        ConversionTarget target(context);
+        target.addIllegalDialect<CalyxDialect>();
+        target.addLegalDialect<HWDialect>();
+        target.addLegalDialect<CombDialect>();
+        target.addLegalDialect<SeqDialect>();
+        target.addLegalDialect<SVDialect>();
+        return applyPartialConversion(hwMod, target, patterns);
+      });
+  if (failed(result))
+    signalPassFailure();
 }
 
 std::unique_ptr<mlir::Pass> circt::createCalyxToHWPass() {
@@ -19,7 +19,9 @@
 #include "mlir/Dialect/ControlFlow/IR/ControlFlowOps.h"
 #include "mlir/Dialect/Func/IR/FuncOps.h"
 #include "mlir/IR/BuiltinDialect.h"
+#include "mlir/IR/Threading.h"
 #include "mlir/Transforms/DialectConversion.h"
+#include "llvm/ADT/DenseSet.h"
 #include "llvm/ADT/TypeSwitch.h"
 
 using namespace mlir;
@@ -330,6 +332,36 @@ static void populateOpConversion(RewritePatternSet &patterns,
       patterns, typeConverter);
 }
 
+/// Convert every type used in `module`, and every type it converts to, once.
+/// The type converter caches its results without any locking, so the cache is
+/// filled up front and the converter can then be shared between threads which
+/// only read from it.
+static void cacheTypeConversions(ModuleOp module,
+                                 TypeConverter &typeConverter) {
+  DenseSet<Type> seen;
+  auto convert = [&](Type type) {
+    if (!seen.insert(type).second)
+      return;
+    if (auto converted = typeConverter.convertType(type))
+      if (seen.insert(converted).second)
+        (void)typeConverter.convertType(converted);
+  };
+  module.walk([&](Operation *op) {
+    for (auto type : op->getResultTypes())
+      convert(type);
+    for (auto &region : op->getRegions())
+      for (auto &block : region)
+        for (auto arg : block.getArguments())
+          convert(arg.getType());
+    if (auto func = dyn_cast<func::FuncOp>(op)) {
+      for (auto type : func.getFunctionType().getInputs())
+        convert(type);
+      for (auto type : func.getFunctionType().getResults())
+        convert(type);
+    }
+  });
+}
+
 //===----------------------------------------------------------------------===//
 // Moore to Core Conversion Pass
 //===----------------------------------------------------------------------===//
@@ -351,12 +383,34 @@ void MooreToCorePass::runOnOperation() {
   ModuleOp module = getOperation();
 
   ConversionTarget target(context);
-  TypeConverter typeConverter;
-  RewritePatternSet patterns(&context);
   populateLegality(target);
+
+  // The converter and the patterns are built once and shared by every op.
+  TypeConverter typeConverter;
   populateTypeConversion(typeConverter);
-  populateOpConversion(patterns, typeConverter);
+  cacheTypeConversions(module, typeConverter);
+  RewritePatternSet owningPatterns(&context);
+  populateOpConversion(owningPatterns, typeConverter);
+  FrozenRewritePatternSet patterns(std::move(owningPatterns));
+
+  // Ops with isolated bodies (entities, functions) convert independently of
+  // each other, so do them in parallel. Any other op would be rewritten in
+  // the shared module body, so those are converted afterwards on this thread.
+  SmallVector<Operation *> isolatedOps, otherOps;
+  for (Operation &op : *module.getBody()) {
+    if (op.hasTrait<OpTrait::IsIsolatedFromAbove>())
+      isolatedOps.push_back(&op);
+    else
+      otherOps.push_back(&op);
+  }
 
-  if (failed(applyFullConversion(module, target, std::move(patterns))))
+  if (failed(failableParallelForEach(&context, isolatedOps, [&](Operation *op) {
+        return applyFullConversion(op, target, patterns);
+      }))) {
+    signalPassFailure();
+    return;
+  }
+  if (!otherOps.empty() &&
+      failed(applyFullConversion(otherOps, target, patterns)))
     signalPassFailure();
 }
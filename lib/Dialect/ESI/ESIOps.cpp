@@ -55,11 +55,24 @@ void ChannelBuffer::print(OpAsmPrinter &p) {
   p << " : " << output().getType().cast<ChannelPort>().getInner();
 }
 
+LogicalResult ChannelBuffer::verify() {
+  StringRef impl = getImplementation();
+  if (impl != "pipeline" && impl != "skid" && impl != "fifo")
+    return emitOpError("unknown buffer implementation '")
+           << impl << "', expected 'pipeline', 'skid', or 'fifo'";
+  if (stagesAttr() && impl != "pipeline")
+    return emitOpError("'stages' only applies to 'pipeline' buffers");
+  if (depthAttr() && impl != "fifo")
+    return emitOpError("'depth' only applies to 'fifo' buffers");
+  return success();
+}
+
 //===----------------------------------------------------------------------===//
-// PipelineStage functions.
+// Physical buffer functions.
 //===----------------------------------------------------------------------===//
 
-ParseResult PipelineStage::parse(OpAsmParser &parser, OperationState &result) {
+/// Parse the common physical buffer format: `clk, rstn, input attrs : inner`.
+static ParseResult parseBuffer(OpAsmParser &parser, OperationState &result) {
   llvm::SMLoc inputOperandsLoc = parser.getCurrentLocation();
 
   SmallVector<OpAsmParser::UnresolvedOperand, 4> operands;
@@ -79,12 +92,30 @@ ParseResult PipelineStage::parse(OpAsmParser &parser, OperationState &result) {
   return success();
 }
 
-void PipelineStage::print(OpAsmPrinter &p) {
-  p << " " << clk() << ", " << rstn() << ", " << input() << " ";
-  p.printOptionalAttrDict((*this)->getAttrs());
-  p << " : " << output().getType().cast<ChannelPort>().getInner();
+static void printBuffer(OpAsmPrinter &p, Operation *op) {
+  p << " " << op->getOperands() << " ";
+  p.printOptionalAttrDict(op->getAttrs());
+  p << " : " << op->getResult(0).getType().cast<ChannelPort>().getInner();
 }
 
+ParseResult PipelineStage::parse(OpAsmParser &parser, OperationState &result) {
+  return parseBuffer(parser, result);
+}
+
+void PipelineStage::print(OpAsmPrinter &p) { printBuffer(p, *this); }
+
+ParseResult SkidBuffer::parse(OpAsmParser &parser, OperationState &result) {
+  return parseBuffer(parser, result);
+}
+
+void SkidBuffer::print(OpAsmPrinter &p) { printBuffer(p, *this); }
+
+ParseResult FIFOBuffer::parse(OpAsmParser &parser, OperationState &result) {
+  return parseBuffer(parser, result);
+}
+
+void FIFOBuffer::print(OpAsmPrinter &p) { printBuffer(p, *this); }
+
 //===----------------------------------------------------------------------===//
 // Wrap / unwrap.
 //===----------------------------------------------------------------------===//
@@ -21,14 +21,18 @@
 #include "mlir/Dialect/Func/IR/FuncOps.h"
 #include "mlir/IR/BuiltinTypes.h"
 #include "mlir/IR/ImplicitLocOpBuilder.h"
+#include "mlir/IR/Threading.h"
 #include "mlir/Pass/Pass.h"
 #include "mlir/Transforms/DialectConversion.h"
 
+#include "llvm/ADT/DenseSet.h"
 #include "llvm/ADT/StringExtras.h"
 #include "llvm/ADT/TypeSwitch.h"
 
 #include <memory>
 
+#include "packed/ESIPacked.h"
+
 #ifdef CAPNP
 #include "capnp/ESICapnp.h"
 #endif
@@ -58,20 +62,27 @@ public:
 
   ArrayAttr getStageParameterList(Attribute value);
 
+  ArrayAttr getFIFOParameterList(Attribute widthValue, Attribute depthValue);
+
   HWModuleExternOp declareStage(Operation *symTable, Type);
+  HWModuleExternOp declareSkidBuffer(Operation *symTable, Type);
+  HWModuleExternOp declareFIFO(Operation *symTable, Type);
   // Will be unused when CAPNP is undefined
   HWModuleExternOp declareCosimEndpoint(Operation *symTable, Type sendType,
                                         Type recvType) LLVM_ATTRIBUTE_UNUSED;
 
   InterfaceOp getOrConstructInterface(ChannelPort);
   InterfaceOp constructInterface(ChannelPort);
+  /// Return the interface already built for a port type, or null if there
+  /// isn't one. Safe to call concurrently with other lookups.
+  InterfaceOp lookupInterface(ChannelPort) const;
 
   // A bunch of constants for use in various places below.
   const StringAttr a, aValid, aReady, x, xValid, xReady;
   const StringAttr dataOutValid, dataOutReady, dataOut, dataInValid,
       dataInReady, dataIn;
   const StringAttr clk, rstn;
-  const StringAttr width;
+  const StringAttr width, depth;
 
   // Various identifier strings. Keep them all here in case we rename them.
   static constexpr char dataStr[] = "data", validStr[] = "valid",
@@ -83,7 +94,14 @@ private:
   /// taken in the symbol table.
   StringAttr constructInterfaceName(ChannelPort);
 
+  /// Declare one of the buffer primitives from ESIPrimitives.sv. They all share
+  /// the same valid/ready port list.
+  HWModuleExternOp declareBufferPrimitive(Operation *symTable, Type dataType,
+                                          StringRef name, ArrayAttr params);
+
   llvm::DenseMap<Type, HWModuleExternOp> declaredStage;
+  llvm::DenseMap<Type, HWModuleExternOp> declaredSkidBuffer;
+  llvm::DenseMap<Type, HWModuleExternOp> declaredFIFO;
   llvm::DenseMap<std::pair<Type, Type>, HWModuleExternOp> declaredCosimEndpoint;
   llvm::DenseMap<Type, InterfaceOp> portTypeLookup;
 };
@@ -111,7 +129,8 @@ ESIHWBuilder::ESIHWBuilder(Operation *top)
       dataIn(StringAttr::get(getContext(), "DataIn")),
       clk(StringAttr::get(getContext(), "clk")),
       rstn(StringAttr::get(getContext(), "rstn")),
-      width(StringAttr::get(getContext(), "WIDTH")) {
+      width(StringAttr::get(getContext(), "WIDTH")),
+      depth(StringAttr::get(getContext(), "DEPTH")) {
 
   auto regions = top->getRegions();
   if (regions.size() == 0) {
@@ -180,16 +199,21 @@ ArrayAttr ESIHWBuilder::getStageParameterList(Attribute value) {
   return ArrayAttr::get(width.getContext(), widthParam);
 }
 
-/// Write an 'ExternModuleOp' to use a hand-coded SystemVerilog module. Said
-/// module implements pipeline stage, adding 1 cycle latency. This particular
-/// implementation is double-buffered and fully pipelines the reverse-flow ready
-/// signal.
-HWModuleExternOp ESIHWBuilder::declareStage(Operation *symTable,
-                                            Type dataType) {
-  HWModuleExternOp &stage = declaredStage[dataType];
-  if (stage)
-    return stage;
+/// Return a parameter list for the FIFO module with the specified values.
+ArrayAttr ESIHWBuilder::getFIFOParameterList(Attribute widthValue,
+                                             Attribute depthValue) {
+  auto type = IntegerType::get(getContext(), 32, IntegerType::Unsigned);
+  Attribute params[] = {
+      ParamDeclAttr::get(getContext(), width, TypeAttr::get(type), widthValue),
+      ParamDeclAttr::get(getContext(), depth, TypeAttr::get(type),
+                         depthValue)};
+  return ArrayAttr::get(getContext(), params);
+}
 
+HWModuleExternOp ESIHWBuilder::declareBufferPrimitive(Operation *symTable,
+                                                      Type dataType,
+                                                      StringRef name,
+                                                      ArrayAttr params) {
   // Since this module has parameterized widths on the a input and x output,
   // give the extern declation a None type since nothing else makes sense.
   // Will be refining this when we decide how to better handle parameterized
@@ -203,12 +227,44 @@ HWModuleExternOp ESIHWBuilder::declareStage(Operation *symTable,
                       {xValid, PortDirection::OUTPUT, getI1Type(), 2},
                       {xReady, PortDirection::INPUT, getI1Type(), 4}};
 
-  stage = create<HWModuleExternOp>(
-      constructUniqueSymbol(symTable, "ESI_PipelineStage"), ports,
-      "ESI_PipelineStage", getStageParameterList({}));
+  return create<HWModuleExternOp>(constructUniqueSymbol(symTable, name), ports,
+                                  name, params);
+}
+
+/// Write an 'ExternModuleOp' to use a hand-coded SystemVerilog module. Said
+/// module implements pipeline stage, adding 1 cycle latency. This particular
+/// implementation is double-buffered and fully pipelines the reverse-flow ready
+/// signal.
+HWModuleExternOp ESIHWBuilder::declareStage(Operation *symTable,
+                                            Type dataType) {
+  HWModuleExternOp &stage = declaredStage[dataType];
+  if (!stage)
+    stage = declareBufferPrimitive(symTable, dataType, "ESI_PipelineStage",
+                                   getStageParameterList({}));
   return stage;
 }
 
+/// Declare the SystemVerilog skid buffer, which adds no latency but registers
+/// the reverse-flow ready signal.
+HWModuleExternOp ESIHWBuilder::declareSkidBuffer(Operation *symTable,
+                                                 Type dataType) {
+  HWModuleExternOp &skid = declaredSkidBuffer[dataType];
+  if (!skid)
+    skid = declareBufferPrimitive(symTable, dataType, "ESI_SkidBuffer",
+                                  getStageParameterList({}));
+  return skid;
+}
+
+/// Declare the SystemVerilog FIFO, which is parameterized on its depth.
+HWModuleExternOp ESIHWBuilder::declareFIFO(Operation *symTable,
+                                           Type dataType) {
+  HWModuleExternOp &fifo = declaredFIFO[dataType];
+  if (!fifo)
+    fifo = declareBufferPrimitive(symTable, dataType, "ESI_FIFO",
+                                  getFIFOParameterList({}, {}));
+  return fifo;
+}
+
 /// Write an 'ExternModuleOp' to use a hand-coded SystemVerilog module. Said
 /// module contains a bi-directional Cosimulation DPI interface with valid/ready
 /// semantics.
@@ -257,6 +313,10 @@ InterfaceOp ESIHWBuilder::getOrConstructInterface(ChannelPort t) {
   return iface;
 }
 
+InterfaceOp ESIHWBuilder::lookupInterface(ChannelPort t) const {
+  return portTypeLookup.lookup(t);
+}
+
 InterfaceOp ESIHWBuilder::constructInterface(ChannelPort chan) {
   return create<InterfaceOp>(constructInterfaceName(chan).getValue(), [&]() {
     create<InterfaceSignalOp>(validStr, getI1Type());
@@ -277,9 +337,8 @@ InterfaceOp ESIHWBuilder::constructInterface(ChannelPort chan) {
 //===----------------------------------------------------------------------===//
 
 namespace {
-/// Lower `ChannelBuffer`s, breaking out the various options. For now, just
-/// replace with the specified number of pipeline stages (since that's the only
-/// option).
+/// Lower `ChannelBuffer`s, breaking out the various options: a chain of
+/// pipeline stages, a skid buffer, or a FIFO.
 struct ChannelBufferLowering : public OpConversionPattern<ChannelBuffer> {
 public:
   using OpConversionPattern::OpConversionPattern;
@@ -296,6 +355,30 @@ LogicalResult ChannelBufferLowering::matchAndRewrite(
   auto loc = buffer.getLoc();
 
   auto type = buffer.getType();
+  StringAttr bufferName = buffer.nameAttr();
+  StringRef impl = buffer.getImplementation();
+
+  if (impl == "skid") {
+    auto skid = rewriter.create<SkidBuffer>(loc, type, buffer.clk(),
+                                            buffer.rstn(), buffer.input());
+    if (bufferName)
+      skid->setAttr("name", bufferName);
+    rewriter.replaceOp(buffer, skid.output());
+    return success();
+  }
+
+  if (impl == "fifo") {
+    auto depth = buffer.depthAttr();
+    if (!depth)
+      return rewriter.notifyMatchFailure(
+          buffer, "FIFO depth unspecified; run --esi-infer-buffer-depths");
+    auto fifo = rewriter.create<FIFOBuffer>(
+        loc, type, buffer.clk(), buffer.rstn(), buffer.input(), depth);
+    if (bufferName)
+      fifo->setAttr("name", bufferName);
+    rewriter.replaceOp(buffer, fifo.output());
+    return success();
+  }
 
   // Expand 'abstract' buffer into 'physical' stages.
   auto stages = buffer.stagesAttr();
@@ -305,7 +388,6 @@ LogicalResult ChannelBufferLowering::matchAndRewrite(
     numStages = stages.getValue().getLimitedValue();
   }
   Value input = buffer.input();
-  StringAttr bufferName = buffer.nameAttr();
   for (uint64_t i = 0; i < numStages; ++i) {
     // Create the stages, connecting them up as we build.
     auto stage = rewriter.create<PipelineStage>(loc, type, buffer.clk(),
@@ -346,6 +428,198 @@ void ESIToPhysicalPass::runOnOperation() {
     signalPassFailure();
 }
 
+//===----------------------------------------------------------------------===//
+// Buffer depth inference pass.
+//===----------------------------------------------------------------------===//
+
+/// The number of cycles an op adds to every path through it. Anything which
+/// isn't a buffer can declare its latency with an `esi.latency` attribute
+/// (e.g. on an instance of a pipelined module).
+static uint64_t getLatency(Operation *op) {
+  if (auto buffer = dyn_cast<ChannelBuffer>(op)) {
+    StringRef impl = buffer.getImplementation();
+    if (impl == "skid")
+      return 0;
+    if (impl == "fifo")
+      return 1;
+    if (auto stages = buffer.stagesAttr())
+      return stages.getValue().getLimitedValue();
+    return 1;
+  }
+  if (isa<PipelineStage, FIFOBuffer>(op))
+    return 1;
+  if (auto latency = op->getAttrOfType<IntegerAttr>("esi.latency"))
+    return latency.getValue().getLimitedValue();
+  return 0;
+}
+
+/// Collect the ops in `body` which consume a result of `op`. Uses nested in
+/// regions are attributed to their ancestor in `body`. The ready signal from a
+/// `wrap.vr` flows backwards, so it doesn't count as a forward edge.
+static void getForwardUsers(Operation *op, Block *body,
+                            SmallVectorImpl<Operation *> &users) {
+  auto wrap = dyn_cast<WrapValidReady>(op);
+  for (OpResult result : op->getResults()) {
+    if (wrap && result == wrap.ready())
+      continue;
+    for (Operation *user : result.getUsers())
+      if (Operation *ancestor = body->findAncestorOpInBlock(*user))
+        users.push_back(ancestor);
+  }
+}
+
+/// Compute the largest latency on any path from the output of `buffer` back to
+/// its input, not counting `buffer` itself. Returns None if `buffer` isn't on a
+/// loop.
+///
+/// Other loops can share ops with the ones through `buffer`, and finding the
+/// longest simple path exactly is exponential. So the ops reachable from
+/// `buffer` are grouped into strongly connected components, and a path is
+/// charged the latency of every op in each component it passes through. This
+/// is exact when no other loop has any latency, and never underestimates, so
+/// the FIFO never ends up too shallow.
+static Optional<uint64_t> getLoopLatency(ChannelBuffer buffer) {
+  Block *body = buffer->getBlock();
+
+  // Tarjan's algorithm. Components are completed in reverse topological order,
+  // so every component another one leads to is already done when it is.
+  struct Frame {
+    Operation *op;
+    SmallVector<Operation *, 4> users;
+    unsigned next = 0;
+  };
+  struct Component {
+    SmallVector<Operation *, 1> ops;
+    // Longest latency from the component back to `buffer`, including its own
+    // ops. None if it can't get there.
+    Optional<uint64_t> longest;
+  };
+  DenseMap<Operation *, unsigned> dfsIndex, lowLink, componentOf;
+  SmallVector<Operation *, 16> tarjanStack;
+  DenseSet<Operation *> onTarjanStack;
+  SmallVector<Component> components;
+  SmallVector<Frame, 16> stack;
+
+  auto push = [&](Operation *op) {
+    unsigned index = dfsIndex.size();
+    dfsIndex[op] = index;
+    lowLink[op] = index;
+    tarjanStack.push_back(op);
+    onTarjanStack.insert(op);
+    stack.emplace_back();
+    stack.back().op = op;
+    getForwardUsers(op, body, stack.back().users);
+  };
+
+  auto finishComponent = [&](Operation *root) {
+    unsigned id = components.size();
+    Component &component = components.emplace_back();
+    Operation *op;
+    do {
+      op = tarjanStack.pop_back_val();
+      onTarjanStack.erase(op);
+      componentOf[op] = id;
+      component.ops.push_back(op);
+    } while (op != root);
+
+    uint64_t latency = 0;
+    Optional<uint64_t> exit;
+    SmallVector<Operation *, 4> users;
+    for (Operation *member : component.ops) {
+      latency += getLatency(member);
+      users.clear();
+      getForwardUsers(member, body, users);
+      for (Operation *user : users) {
+        if (user == buffer) {
+          exit = exit.getValueOr(0);
+          continue;
+        }
+        unsigned userComponent = componentOf.lookup(user);
+        if (userComponent == id)
+          continue;
+        if (auto viaUser = components[userComponent].longest)
+          exit = std::max(exit.getValueOr(0), *viaUser);
+      }
+    }
+    if (exit)
+      component.longest = *exit + latency;
+  };
+
+  SmallVector<Operation *, 4> starts;
+  getForwardUsers(buffer, body, starts);
+  Optional<uint64_t> longest;
+  for (Operation *start : starts) {
+    if (start == buffer) {
+      longest = longest.getValueOr(0);
+      continue;
+    }
+    if (!dfsIndex.count(start)) {
+      push(start);
+      while (!stack.empty()) {
+        Frame &frame = stack.back();
+        if (frame.next == frame.users.size()) {
+          Operation *op = frame.op;
+          stack.pop_back();
+          if (lowLink[op] == dfsIndex[op])
+            finishComponent(op);
+          if (!stack.empty()) {
+            Operation *parent = stack.back().op;
+            lowLink[parent] = std::min(lowLink[parent], lowLink[op]);
+          }
+          continue;
+        }
+
+        Operation *user = frame.users[frame.next++];
+        if (user == buffer)
+          continue;
+        if (!dfsIndex.count(user)) {
+          push(user);
+          continue;
+        }
+        if (onTarjanStack.contains(user))
+          lowLink[frame.op] = std::min(lowLink[frame.op], dfsIndex[user]);
+      }
+    }
+    if (auto viaStart = components[componentOf[start]].longest)
+      longest = std::max(longest.getValueOr(0), *viaStart);
+  }
+  return longest;
+}
+
+namespace {
+/// Size FIFO buffers which don't have a depth yet.
+struct ESIInferBufferDepthsPass
+    : public InferESIBufferDepthsBase<ESIInferBufferDepthsPass> {
+  void runOnOperation() override;
+};
+} // anonymous namespace
+
+void ESIInferBufferDepthsPass::runOnOperation() {
+  SmallVector<ChannelBuffer> fifos;
+  getOperation().walk([&](ChannelBuffer buffer) {
+    if (buffer.getImplementation() == "fifo" && !buffer.depthAttr())
+      fifos.push_back(buffer);
+  });
+
+  // Compute all the depths before setting any of them so that the latency of
+  // the other FIFOs on a loop doesn't depend on the order we visit them in.
+  SmallVector<uint64_t> depths;
+  for (ChannelBuffer fifo : fifos) {
+    // To never stall, a FIFO needs a slot for every token in flight around its
+    // loop -- the loop's round trip latency, including the FIFO's own cycle.
+    // Two entries are the minimum for full throughput even off of a loop.
+    uint64_t depth = 2;
+    if (Optional<uint64_t> loopLatency = getLoopLatency(fifo))
+      depth = std::max(depth, *loopLatency + getLatency(fifo));
+    depths.push_back(depth);
+  }
+
+  OpBuilder b(&getContext());
+  for (size_t i = 0, e = fifos.size(); i < e; ++i)
+    fifos[i].depthAttr(b.getI64IntegerAttr(depths[i]));
+  numFIFOsSized += fifos.size();
+}
+
 //===----------------------------------------------------------------------===//
 // Lower ESI ports pass.
 //===----------------------------------------------------------------------===//
@@ -373,32 +647,51 @@ void ESIPortsPass::runOnOperation() {
   ESIHWBuilder b(top);
   build = &b;
 
+  // Rewriting an instance only touches the module which contains it, so
+  // update the instances of each parent module in parallel. The signatures
+  // are looked up by symbol in 'modsMutated'.
+  SmallVector<Operation *> parents;
+  for (Operation &op : *top.getBody())
+    if (op.getNumRegions() != 0)
+      parents.push_back(&op);
+  DenseMap<StringAttr, Operation *> modsMutated;
+  auto updateInstances = [&]() {
+    if (modsMutated.empty())
+      return;
+    parallelForEach(&getContext(), parents, [&](Operation *parent) {
+      // Collect the instances first since updating erases them.
+      SmallVector<std::pair<InstanceOp, Operation *>> toUpdate;
+      parent->walk([&](InstanceOp inst) {
+        if (auto *mod = modsMutated.lookup(inst.moduleNameAttr().getAttr()))
+          toUpdate.emplace_back(inst, mod);
+      });
+      for (auto [inst, mod] : toUpdate) {
+        if (auto externMod = dyn_cast<HWModuleExternOp>(mod))
+          updateInstance(externMod, inst);
+        else
+          updateInstance(cast<HWModuleOp>(mod), inst);
+      }
+    });
+    modsMutated.clear();
+  };
+
   // Find all externmodules and try to modify them. Remember the modified ones.
-  DenseMap<StringRef, HWModuleExternOp> externModsMutated;
+  // This builds the SV interfaces so it must be serial.
   for (auto mod : top.getOps<HWModuleExternOp>())
     if (updateFunc(mod))
-      externModsMutated[mod.getName()] = mod;
+      modsMutated[SymbolTable::getSymbolName(mod)] = mod;
 
   // Find all instances and update them.
-  top.walk([&externModsMutated, this](InstanceOp inst) {
-    auto mapIter = externModsMutated.find(inst.moduleName());
-    if (mapIter != externModsMutated.end())
-      updateInstance(mapIter->second, inst);
-  });
+  updateInstances();
 
   // Find all modules and try to modify them to have wires with valid/ready
   // semantics. Remember the modified ones.
-  DenseMap<StringRef, HWModuleOp> modsMutated;
   for (auto mod : top.getOps<HWModuleOp>())
     if (updateFunc(mod))
-      modsMutated[mod.getName()] = mod;
+      modsMutated[SymbolTable::getSymbolName(mod)] = mod;
 
   // Find all instances and update them.
-  top.walk([&modsMutated, this](InstanceOp inst) {
-    auto mapIter = modsMutated.find(inst.moduleName());
-    if (mapIter != modsMutated.end())
-      updateInstance(mapIter->second, inst);
-  });
+  updateInstances();
 
   build = nullptr;
 }
@@ -751,10 +1044,11 @@ void ESIPortsPass::updateInstance(HWModuleExternOp mod, InstanceOp inst) {
     }
 
     // Get the interface from the cache, and make sure it's the same one as
-    // being used in the module.
-    auto iface = build->getOrConstructInterface(instChanTy);
-    if (iface.getModportType(ESIHWBuilder::sourceStr) !=
-        funcTy.getInput(opNum)) {
+    // being used in the module. Instances are updated in parallel, so we can't
+    // build new interfaces here. A missing one implies a mismatch.
+    auto iface = build->lookupInterface(instChanTy);
+    if (!iface || iface.getModportType(ESIHWBuilder::sourceStr) !=
+                      funcTy.getInput(opNum)) {
       inst.emitOpError("ESI ChannelPort (operand #")
           << opNum << ") doesn't match module!";
       ++opNum;
@@ -797,8 +1091,9 @@ void ESIPortsPass::updateInstance(HWModuleExternOp mod, InstanceOp inst) {
 
     // Get the interface from the cache, and make sure it's the same one as
     // being used in the module.
-    auto iface = build->getOrConstructInterface(instChanTy);
-    if (iface.getModportType(ESIHWBuilder::sinkStr) != funcTy.getInput(opNum)) {
+    auto iface = build->lookupInterface(instChanTy);
+    if (!iface ||
+        iface.getModportType(ESIHWBuilder::sinkStr) != funcTy.getInput(opNum)) {
       inst.emitOpError("ESI ChannelPort (result #")
           << resNum << ", operand #" << opNum << ") doesn't match module!";
       ++opNum;
@@ -850,10 +1145,56 @@ void ESIPortsPass::updateInstance(HWModuleExternOp mod, InstanceOp inst) {
 // Lower to HW/SV conversions and pass.
 //===----------------------------------------------------------------------===//
 
+/// Replace a physical buffer op (whose operands are clk, rstn, and the input
+/// channel) with an instance of one of the ESIPrimitives.sv buffer modules.
+/// Unwrap and re-wrap appropriately. Another conversion will take care merging
+/// the resulting adjacent wrap/unwrap ops.
+static void replaceWithBufferPrimitive(Operation *op, HWModuleExternOp primMod,
+                                       ArrayAttr params, StringRef defaultName,
+                                       ConversionPatternRewriter &rewriter) {
+  auto loc = op->getLoc();
+  Value clk = op->getOperand(0);
+  Value rstn = op->getOperand(1);
+  Value input = op->getOperand(2);
+  auto chPort = input.getType().cast<ChannelPort>();
+
+  // Unwrap the channel. The ready signal is a Value we haven't created yet, so
+  // create a temp value and replace it later. Give this constant an odd-looking
+  // type to make debugging easier.
+  circt::BackedgeBuilder back(rewriter, loc);
+  circt::Backedge wrapReady = back.get(rewriter.getI1Type());
+  auto unwrap = rewriter.create<UnwrapValidReady>(loc, input, wrapReady);
+
+  StringRef instName = defaultName;
+  if (auto name = op->getAttrOfType<StringAttr>("name"))
+    instName = name.getValue();
+
+  // Instantiate the external module.
+  circt::Backedge primReady = back.get(rewriter.getI1Type());
+  Value operands[] = {clk, rstn, unwrap.rawOutput(), unwrap.valid(),
+                      primReady};
+  auto primInst =
+      rewriter.create<InstanceOp>(loc, primMod, instName, operands, params);
+  auto primInstResults = primInst.getResults();
+
+  // Set a_ready (from the unwrap) back edge correctly to its output from the
+  // primitive.
+  wrapReady.setValue(primInstResults[0]);
+
+  Value x = primInstResults[1];
+  Value xValid = primInstResults[2];
+
+  // Wrap up the output of the HW primitive.
+  auto wrap = rewriter.create<WrapValidReady>(loc, chPort, rewriter.getI1Type(),
+                                              x, xValid);
+  // Set the primitive's x_ready backedge correctly.
+  primReady.setValue(wrap.ready());
+
+  rewriter.replaceOp(op, wrap.chanOutput());
+}
+
 namespace {
-/// Lower PipelineStage ops to an HW implementation. Unwrap and re-wrap
-/// appropriately. Another conversion will take care merging the resulting
-/// adjacent wrap/unwrap ops.
+/// Lower PipelineStage ops to an HW implementation.
 struct PipelineStageLowering : public OpConversionPattern<PipelineStage> {
 public:
   PipelineStageLowering(ESIHWBuilder &builder, MLIRContext *ctxt)
@@ -872,7 +1213,6 @@ private:
 LogicalResult PipelineStageLowering::matchAndRewrite(
     PipelineStage stage, OpAdaptor adaptor,
     ConversionPatternRewriter &rewriter) const {
-  auto loc = stage.getLoc();
   auto chPort = stage.input().getType().dyn_cast<ChannelPort>();
   if (!chPort)
     return failure();
@@ -884,41 +1224,63 @@ LogicalResult PipelineStageLowering::matchAndRewrite(
   ArrayAttr stageParams =
       builder.getStageParameterList(rewriter.getUI32IntegerAttr(width));
 
-  // Unwrap the channel. The ready signal is a Value we haven't created yet, so
-  // create a temp value and replace it later. Give this constant an odd-looking
-  // type to make debugging easier.
-  circt::BackedgeBuilder back(rewriter, loc);
-  circt::Backedge wrapReady = back.get(rewriter.getI1Type());
-  auto unwrap =
-      rewriter.create<UnwrapValidReady>(loc, stage.input(), wrapReady);
+  // Instantiate the "ESI_PipelineStage" external module.
+  replaceWithBufferPrimitive(stage, stageModule, stageParams, "pipelineStage",
+                             rewriter);
+  return success();
+}
 
-  StringRef pipeStageName = "pipelineStage";
-  if (auto name = stage->getAttrOfType<StringAttr>("name"))
-    pipeStageName = name.getValue();
+namespace {
+/// Lower SkidBuffer ops to an HW implementation.
+struct SkidBufferLowering : public OpConversionPattern<SkidBuffer> {
+public:
+  SkidBufferLowering(ESIHWBuilder &builder, MLIRContext *ctxt)
+      : OpConversionPattern(ctxt), builder(builder) {}
+  using OpConversionPattern::OpConversionPattern;
 
-  // Instantiate the "ESI_PipelineStage" external module.
-  circt::Backedge stageReady = back.get(rewriter.getI1Type());
-  Value operands[] = {stage.clk(), stage.rstn(), unwrap.rawOutput(),
-                      unwrap.valid(), stageReady};
-  auto stageInst = rewriter.create<InstanceOp>(loc, stageModule, pipeStageName,
-                                               operands, stageParams);
-  auto stageInstResults = stageInst.getResults();
+  LogicalResult
+  matchAndRewrite(SkidBuffer skid, OpAdaptor adaptor,
+                  ConversionPatternRewriter &rewriter) const final {
+    auto chPort = skid.input().getType().cast<ChannelPort>();
+    Operation *symTable = skid->getParentWithTrait<OpTrait::SymbolTable>();
+    auto skidModule = builder.declareSkidBuffer(symTable, chPort.getInner());
+    size_t width = circt::hw::getBitWidth(chPort.getInner());
+    ArrayAttr params =
+        builder.getStageParameterList(rewriter.getUI32IntegerAttr(width));
+    replaceWithBufferPrimitive(skid, skidModule, params, "skidBuffer",
+                               rewriter);
+    return success();
+  }
 
-  // Set a_ready (from the unwrap) back edge correctly to its output from stage.
-  wrapReady.setValue(stageInstResults[0]);
+private:
+  ESIHWBuilder &builder;
+};
 
-  Value x = stageInstResults[1];
-  Value xValid = stageInstResults[2];
+/// Lower FIFOBuffer ops to an HW implementation.
+struct FIFOBufferLowering : public OpConversionPattern<FIFOBuffer> {
+public:
+  FIFOBufferLowering(ESIHWBuilder &builder, MLIRContext *ctxt)
+      : OpConversionPattern(ctxt), builder(builder) {}
+  using OpConversionPattern::OpConversionPattern;
 
-  // Wrap up the output of the HW stage module.
-  auto wrap = rewriter.create<WrapValidReady>(loc, chPort, rewriter.getI1Type(),
-                                              x, xValid);
-  // Set the stages x_ready backedge correctly.
-  stageReady.setValue(wrap.ready());
+  LogicalResult
+  matchAndRewrite(FIFOBuffer fifo, OpAdaptor adaptor,
+                  ConversionPatternRewriter &rewriter) const final {
+    auto chPort = fifo.input().getType().cast<ChannelPort>();
+    Operation *symTable = fifo->getParentWithTrait<OpTrait::SymbolTable>();
+    auto fifoModule = builder.declareFIFO(symTable, chPort.getInner());
+    size_t width = circt::hw::getBitWidth(chPort.getInner());
+    ArrayAttr params = builder.getFIFOParameterList(
+        rewriter.getUI32IntegerAttr(width),
+        rewriter.getUI32IntegerAttr(fifo.depth()));
+    replaceWithBufferPrimitive(fifo, fifoModule, params, "fifo", rewriter);
+    return success();
+  }
 
-  rewriter.replaceOp(stage, wrap.chanOutput());
-  return success();
-}
+private:
+  ESIHWBuilder &builder;
+};
+} // anonymous namespace
 
 namespace {
 struct NullSourceOpLowering : public OpConversionPattern<NullSourceOp> {
@@ -1094,12 +1456,13 @@ LogicalResult UnwrapInterfaceLower::matchAndRewrite(
 }
 
 namespace {
-/// Lower `CosimEndpoint` ops to a SystemVerilog extern module and a Capnp
-/// gasket op.
+/// Lower `CosimEndpoint` ops to a SystemVerilog extern module and an encode /
+/// decode gasket op for the selected wire format.
 struct CosimLowering : public OpConversionPattern<CosimEndpoint> {
 public:
-  CosimLowering(ESIHWBuilder &b)
-      : OpConversionPattern(b.getContext(), 1), builder(b) {}
+  CosimLowering(ESIHWBuilder &b, bool usePacked)
+      : OpConversionPattern(b.getContext(), 1), builder(b),
+        usePacked(usePacked) {}
 
   using OpConversionPattern::OpConversionPattern;
 
@@ -1109,17 +1472,14 @@ public:
 
 private:
   ESIHWBuilder &builder;
+  /// Use the packed wire format instead of capnp.
+  bool usePacked;
 };
 } // anonymous namespace
 
 LogicalResult
 CosimLowering::matchAndRewrite(CosimEndpoint ep, OpAdaptor adaptor,
                                ConversionPatternRewriter &rewriter) const {
-#ifndef CAPNP
-  (void)builder;
-  return rewriter.notifyMatchFailure(
-      ep, "Cosim lowering requires the ESI capnp plugin, which was disabled.");
-#else
   auto loc = ep.getLoc();
   auto *ctxt = rewriter.getContext();
   auto operands = adaptor.getOperands();
@@ -1127,46 +1487,75 @@ CosimLowering::matchAndRewrite(CosimEndpoint ep, OpAdaptor adaptor,
   Value rstn = operands[1];
   Value send = operands[2];
 
+  // Get the type IDs and message sizes from the selected wire format.
+  uint64_t sendTypeID, recvTypeID;
+  size_t sendSize, recvSize;
+  Type recvType = ep.recv().getType().cast<ChannelPort>().getInner();
+  if (usePacked) {
+    packed::TypeSchema sendTypeSchema(send.getType());
+    if (!sendTypeSchema.isSupported())
+      return rewriter.notifyMatchFailure(ep, "Send type not supported yet");
+    packed::TypeSchema recvTypeSchema(recvType);
+    if (!recvTypeSchema.isSupported())
+      return rewriter.notifyMatchFailure(ep, "Recv type not supported yet");
+    sendTypeID = sendTypeSchema.typeID();
+    sendSize = sendTypeSchema.size();
+    recvTypeID = recvTypeSchema.typeID();
+    recvSize = recvTypeSchema.size();
+  } else {
+#ifndef CAPNP
+    return rewriter.notifyMatchFailure(
+        ep,
+        "Cosim lowering requires the ESI capnp plugin, which was disabled.");
+#else
+    capnp::TypeSchema sendTypeSchema(send.getType());
+    if (!sendTypeSchema.isSupported())
+      return rewriter.notifyMatchFailure(ep, "Send type not supported yet");
+    capnp::TypeSchema recvTypeSchema(recvType);
+    if (!recvTypeSchema.isSupported())
+      return rewriter.notifyMatchFailure(ep, "Recv type not supported yet");
+    sendTypeID = sendTypeSchema.capnpTypeID();
+    sendSize = sendTypeSchema.size();
+    recvTypeID = recvTypeSchema.capnpTypeID();
+    recvSize = recvTypeSchema.size();
+#endif // CAPNP
+  }
+
   circt::BackedgeBuilder bb(rewriter, loc);
   Type ui64Type =
       IntegerType::get(ctxt, 64, IntegerType::SignednessSemantics::Unsigned);
-  capnp::TypeSchema sendTypeSchema(send.getType());
-  if (!sendTypeSchema.isSupported())
-    return rewriter.notifyMatchFailure(ep, "Send type not supported yet");
-  capnp::TypeSchema recvTypeSchema(ep.recv().getType());
-  if (!recvTypeSchema.isSupported())
-    return rewriter.notifyMatchFailure(ep, "Recv type not supported yet");
 
   // Set all the parameters.
   SmallVector<Attribute, 8> params;
   params.push_back(ParamDeclAttr::get(
       "ENDPOINT_ID", rewriter.getI32IntegerAttr(ep.endpointID())));
-  params.push_back(ParamDeclAttr::get(
-      "SEND_TYPE_ID",
-      IntegerAttr::get(ui64Type, sendTypeSchema.capnpTypeID())));
-  params.push_back(
-      ParamDeclAttr::get("SEND_TYPE_SIZE_BITS",
-                         rewriter.getI32IntegerAttr(sendTypeSchema.size())));
-  params.push_back(ParamDeclAttr::get(
-      "RECV_TYPE_ID",
-      IntegerAttr::get(ui64Type, recvTypeSchema.capnpTypeID())));
-  params.push_back(
-      ParamDeclAttr::get("RECV_TYPE_SIZE_BITS",
-                         rewriter.getI32IntegerAttr(recvTypeSchema.size())));
+  params.push_back(ParamDeclAttr::get("SEND_TYPE_ID",
+                                      IntegerAttr::get(ui64Type, sendTypeID)));
+  params.push_back(ParamDeclAttr::get("SEND_TYPE_SIZE_BITS",
+                                      rewriter.getI32IntegerAttr(sendSize)));
+  params.push_back(ParamDeclAttr::get("RECV_TYPE_ID",
+                                      IntegerAttr::get(ui64Type, recvTypeID)));
+  params.push_back(ParamDeclAttr::get("RECV_TYPE_SIZE_BITS",
+                                      rewriter.getI32IntegerAttr(recvSize)));
 
   // Set up the egest route to drive the EP's send ports.
-  ArrayType egestBitArrayType =
-      ArrayType::get(rewriter.getI1Type(), sendTypeSchema.size());
+  ArrayType egestBitArrayType = ArrayType::get(rewriter.getI1Type(), sendSize);
   auto sendReady = bb.get(rewriter.getI1Type());
   UnwrapValidReady unwrapSend =
       rewriter.create<UnwrapValidReady>(loc, send, sendReady);
-  auto encodeData = rewriter.create<CapnpEncode>(
-      loc, egestBitArrayType, clk, unwrapSend.valid(), unwrapSend.rawOutput());
+  Value encodeData;
+  if (usePacked)
+    encodeData = rewriter.create<PackedEncode>(loc, egestBitArrayType, clk,
+                                               unwrapSend.valid(),
+                                               unwrapSend.rawOutput());
+  else
+    encodeData = rewriter.create<CapnpEncode>(loc, egestBitArrayType, clk,
+                                              unwrapSend.valid(),
+                                              unwrapSend.rawOutput());
 
   // Get information necessary for injest path.
   auto recvReady = bb.get(rewriter.getI1Type());
-  ArrayType ingestBitArrayType =
-      ArrayType::get(rewriter.getI1Type(), recvTypeSchema.size());
+  ArrayType ingestBitArrayType = ArrayType::get(rewriter.getI1Type(), recvSize);
 
   // Build or get the cached Cosim Endpoint module parameterization.
   Operation *symTable = ep->getParentWithTrait<OpTrait::SymbolTable>();
@@ -1177,7 +1566,7 @@ CosimLowering::matchAndRewrite(CosimEndpoint ep, OpAdaptor adaptor,
   StringAttr nameAttr = ep->getAttr("name").dyn_cast_or_null<StringAttr>();
   StringRef name = nameAttr ? nameAttr.getValue() : "cosimEndpoint";
   Value epInstInputs[] = {
-      clk, rstn, recvReady, unwrapSend.valid(), encodeData.capnpBits(),
+      clk, rstn, recvReady, unwrapSend.valid(), encodeData,
   };
 
   auto cosimEpModule =
@@ -1188,18 +1577,23 @@ CosimLowering::matchAndRewrite(CosimEndpoint ep, OpAdaptor adaptor,
   // Set up the injest path.
   Value recvDataFromCosim = cosimEpModule.getResult(1);
   Value recvValidFromCosim = cosimEpModule.getResult(0);
-  auto decodeData =
-      rewriter.create<CapnpDecode>(loc, recvTypeSchema.getType(), clk,
-                                   recvValidFromCosim, recvDataFromCosim);
-  WrapValidReady wrapRecv = rewriter.create<WrapValidReady>(
-      loc, decodeData.decodedData(), recvValidFromCosim);
+  Value decodeData;
+  if (usePacked)
+    decodeData = rewriter.create<PackedDecode>(loc, recvType, clk,
+                                               recvValidFromCosim,
+                                               recvDataFromCosim);
+  else
+    decodeData = rewriter.create<CapnpDecode>(loc, recvType, clk,
+                                              recvValidFromCosim,
+                                              recvDataFromCosim);
+  WrapValidReady wrapRecv =
+      rewriter.create<WrapValidReady>(loc, decodeData, recvValidFromCosim);
   recvReady.setValue(wrapRecv.ready());
 
   // Replace the CosimEndpoint op.
   rewriter.replaceOp(ep, wrapRecv.chanOutput());
 
   return success();
-#endif // CAPNP
 }
 
 namespace {
@@ -1258,10 +1652,64 @@ public:
 };
 } // namespace
 
+namespace {
+/// Lower the packed encode gasket to HW.
+struct PackedEncoderLowering : public OpConversionPattern<PackedEncode> {
+public:
+  using OpConversionPattern::OpConversionPattern;
+
+  LogicalResult
+  matchAndRewrite(PackedEncode enc, OpAdaptor adaptor,
+                  ConversionPatternRewriter &rewriter) const final {
+    packed::TypeSchema encodeType(enc.dataToEncode().getType());
+    if (!encodeType.isSupported())
+      return rewriter.notifyMatchFailure(enc, "Type not supported yet");
+    if (encodeType.size() !=
+        enc.packedBits().getType().cast<ArrayType>().getSize())
+      return rewriter.notifyMatchFailure(enc, "Result size mismatch");
+    auto operands = adaptor.getOperands();
+    Value encoderOutput = encodeType.buildEncoder(rewriter, operands[0],
+                                                  operands[1], operands[2]);
+    rewriter.replaceOp(enc, encoderOutput);
+    return success();
+  }
+};
+} // anonymous namespace
+
+namespace {
+/// Lower the packed decode gasket to HW/SV.
+struct PackedDecoderLowering : public OpConversionPattern<PackedDecode> {
+public:
+  using OpConversionPattern::OpConversionPattern;
+
+  LogicalResult
+  matchAndRewrite(PackedDecode dec, OpAdaptor adaptor,
+                  ConversionPatternRewriter &rewriter) const final {
+    packed::TypeSchema decodeType(dec.decodedData().getType());
+    if (!decodeType.isSupported())
+      return rewriter.notifyMatchFailure(dec, "Type not supported yet");
+    if (decodeType.size() !=
+        dec.packedBits().getType().cast<ArrayType>().getSize())
+      return rewriter.notifyMatchFailure(dec, "Operand size mismatch");
+    auto operands = adaptor.getOperands();
+    Value decoderOutput = decodeType.buildDecoder(rewriter, operands[0],
+                                                  operands[1], operands[2]);
+    rewriter.replaceOp(dec, decoderOutput);
+    return success();
+  }
+};
+} // anonymous namespace
+
 void ESItoHWPass::runOnOperation() {
   auto top = getOperation();
   auto ctxt = &getContext();
 
+  if (cosimEncoding != "capnp" && cosimEncoding != "packed") {
+    top.emitError("unknown cosim encoding '")
+        << cosimEncoding.getValue() << "', expected 'capnp' or 'packed'";
+    return signalPassFailure();
+  }
+
   // Set up a conversion and give it a set of laws.
   ConversionTarget pass1Target(*ctxt);
   pass1Target.addLegalDialect<CombDialect>();
@@ -1269,17 +1717,20 @@ void ESItoHWPass::runOnOperation() {
   pass1Target.addLegalDialect<SVDialect>();
   pass1Target.addLegalOp<WrapValidReady, UnwrapValidReady>();
   pass1Target.addLegalOp<CapnpDecode, CapnpEncode>();
+  pass1Target.addLegalOp<PackedDecode, PackedEncode>();
 
   pass1Target.addIllegalOp<WrapSVInterface, UnwrapSVInterface>();
-  pass1Target.addIllegalOp<PipelineStage>();
+  pass1Target.addIllegalOp<PipelineStage, SkidBuffer, FIFOBuffer>();
 
   // Add all the conversion patterns.
   ESIHWBuilder esiBuilder(top);
   RewritePatternSet pass1Patterns(ctxt);
   pass1Patterns.insert<PipelineStageLowering>(esiBuilder, ctxt);
+  pass1Patterns.insert<SkidBufferLowering>(esiBuilder, ctxt);
+  pass1Patterns.insert<FIFOBufferLowering>(esiBuilder, ctxt);
   pass1Patterns.insert<WrapInterfaceLower>(ctxt);
   pass1Patterns.insert<UnwrapInterfaceLower>(ctxt);
-  pass1Patterns.insert<CosimLowering>(esiBuilder);
+  pass1Patterns.insert<CosimLowering>(esiBuilder, cosimEncoding == "packed");
   pass1Patterns.insert<NullSourceOpLowering>(ctxt);
 
   // Run the conversion.
@@ -1297,6 +1748,8 @@ void ESItoHWPass::runOnOperation() {
   pass2Patterns.insert<RemoveWrapUnwrap>(ctxt);
   pass2Patterns.insert<EncoderLowering>(ctxt);
   pass2Patterns.insert<DecoderLowering>(ctxt);
+  pass2Patterns.insert<PackedEncoderLowering>(ctxt);
+  pass2Patterns.insert<PackedDecoderLowering>(ctxt);
   if (failed(
           applyPartialConversion(top, pass2Target, std::move(pass2Patterns))))
     signalPassFailure();
@@ -1307,6 +1760,10 @@ namespace esi {
 std::unique_ptr<OperationPass<ModuleOp>> createESIPhysicalLoweringPass() {
   return std::make_unique<ESIToPhysicalPass>();
 }
+std::unique_ptr<OperationPass<hw::HWModuleOp>>
+createESIInferBufferDepthsPass() {
+  return std::make_unique<ESIInferBufferDepthsPass>();
+}
 std::unique_ptr<OperationPass<ModuleOp>> createESIPortLoweringPass() {
   return std::make_unique<ESIPortsPass>();
 }
@@ -2,6 +2,8 @@
 //
 // ESI translations:
 // - Cap'nProto schema generation
+// - Cap'nProto C++ client generation
+// - Packed wire format C++ codec generation
 //
 //===----------------------------------------------------------------------===//
 
@@ -14,10 +16,13 @@
 #include "mlir/IR/BuiltinDialect.h"
 #include "mlir/IR/BuiltinOps.h"
 #include "mlir/Tools/mlir-translate/Translation.h"
+#include "llvm/ADT/StringSet.h"
 #include "llvm/Support/Format.h"
 
 #include <algorithm>
 
+#include "packed/ESIPacked.h"
+
 #ifdef CAPNP
 #include "capnp/ESICapnp.h"
 #include "circt/Dialect/ESI/CosimSchema.h"
@@ -167,6 +172,74 @@ LogicalResult circt::esi::exportCosimSchema(ModuleOp module,
   return schema.emit();
 }
 
+//===----------------------------------------------------------------------===//
+// ESI cosim C++ client generation.
+//
+// Emits a `ClientEndpoint` instantiation (see cosim/Client.h) for every
+// `esi.cosim` op, typed with the structs from the `-export-esi-capnp` schema.
+// The message sizes are known statically, so the request builders can be sized
+// up front.
+//===----------------------------------------------------------------------===//
+
+/// Make a C++ identifier out of an endpoint name.
+static std::string clientEndpointName(CosimEndpoint ep) {
+  std::string name;
+  if (auto epName = ep->getAttrOfType<StringAttr>("name"))
+    name = epName.getValue().str();
+  else
+    name = "Endpoint" + std::to_string(ep.endpointID());
+  for (char &ch : name)
+    if (!isalnum(ch) && ch != '_')
+      ch = '_';
+  if (isdigit(name[0]))
+    name.insert(0, "_");
+  return name;
+}
+
+LogicalResult circt::esi::exportCosimClient(ModuleOp module,
+                                            llvm::raw_ostream &os) {
+  SmallVector<CosimEndpoint> endpoints;
+  module.walk([&](CosimEndpoint ep) { endpoints.push_back(ep); });
+  llvm::sort(endpoints, [](CosimEndpoint a, CosimEndpoint b) {
+    return a.endpointID() < b.endpointID();
+  });
+
+  os << "// ESI generated cosim client.\n"
+     << "//\n"
+     << "// Define ESI_COSIM_SCHEMA_HEADER to the header capnp generated from\n"
+     << "// the `-export-esi-capnp` schema before including this file.\n\n"
+     << "#pragma once\n\n"
+     << "#include ESI_COSIM_SCHEMA_HEADER\n"
+     << "#include \"circt/Dialect/ESI/cosim/Client.h\"\n\n"
+     << "namespace esi_cosim_client {\n";
+
+  llvm::StringSet<> usedNames;
+  for (CosimEndpoint ep : endpoints) {
+    capnp::TypeSchema sendTypeSchema(ep.send().getType());
+    if (!sendTypeSchema.isSupported())
+      return ep.emitOpError("Type ")
+             << ep.send().getType() << " not supported.";
+    capnp::TypeSchema recvTypeSchema(ep.recv().getType());
+    if (!recvTypeSchema.isSupported())
+      return ep.emitOpError("Type '")
+             << ep.recv().getType() << "' not supported.";
+
+    std::string name = clientEndpointName(ep);
+    if (!usedNames.insert(name).second)
+      return ep.emitOpError("duplicate cosim endpoint name '") << name << "'";
+
+    os << "\n/// Endpoint #" << ep.endpointID() << " at " << ep.getLoc()
+       << ".\n"
+       << "using " << name << " = circt::esi::cosim::ClientEndpoint<\n"
+       << "    ::" << sendTypeSchema.name() << ", ::" << recvTypeSchema.name()
+       << ", /*endpointID=*/" << ep.endpointID()
+       << ", /*sendWords=*/" << sendTypeSchema.size() / 64 << ">;\n";
+  }
+
+  os << "\n} // namespace esi_cosim_client\n";
+  return success();
+}
+
 #else // Not CAPNP
 
 LogicalResult circt::esi::exportCosimSchema(ModuleOp module,
@@ -174,13 +247,67 @@ LogicalResult circt::esi::exportCosimSchema(ModuleOp module,
   return failure();
 }
 
+LogicalResult circt::esi::exportCosimClient(ModuleOp module,
+                                            llvm::raw_ostream &os) {
+  return failure();
+}
+
 #endif
 
+//===----------------------------------------------------------------------===//
+// ESI cosim packed wire format C++ codec generation.
+//
+// Software counterpart to `lower-esi-to-hw{cosim-encoding=packed}`. Walks the
+// IR, finds all the `esi.cosim` ops, and emits a self-contained C++ header
+// with an encode / decode struct for every send and receive type.
+//===----------------------------------------------------------------------===//
+
+LogicalResult circt::esi::exportCosimPackedCodec(ModuleOp module,
+                                                 llvm::raw_ostream &os) {
+  SmallVector<packed::TypeSchema> types;
+  auto walkResult = module.walk([&](CosimEndpoint ep) {
+    for (Type type : {ep.send().getType(), ep.recv().getType()}) {
+      packed::TypeSchema schema(type);
+      if (!schema.isSupported()) {
+        ep.emitOpError("Type '") << type << "' not supported.";
+        return mlir::WalkResult::interrupt();
+      }
+      types.push_back(schema);
+    }
+    return mlir::WalkResult::advance();
+  });
+  if (walkResult.wasInterrupted())
+    return failure();
+
+  // We need a sorted list to ensure determinism.
+  llvm::sort(types, [](const packed::TypeSchema &a,
+                       const packed::TypeSchema &b) {
+    return a.typeID() > b.typeID();
+  });
+
+  os << "// ESI generated packed codec, wire format version "
+     << packed::esiPackedSchemaVersion << ".\n\n"
+     << "#pragma once\n\n";
+  packed::TypeSchema::writePrologue(os);
+
+  DenseSet<Type> emitted;
+  for (auto &schema : types)
+    if (failed(schema.write(os, emitted)))
+      return failure();
+  return success();
+}
+
 //===----------------------------------------------------------------------===//
 // Register all ESI translations.
 //===----------------------------------------------------------------------===//
 
 void circt::esi::registerESITranslations() {
+  mlir::TranslateFromMLIRRegistration cosimToPackedCpp(
+      "export-esi-packed-cpp", exportCosimPackedCodec,
+      [](mlir::DialectRegistry &registry) {
+        registry.insert<ESIDialect, circt::hw::HWDialect, circt::sv::SVDialect,
+                        mlir::func::FuncDialect, mlir::BuiltinDialect>();
+      });
 #ifdef CAPNP
   mlir::TranslateFromMLIRRegistration cosimToCapnp(
       "export-esi-capnp", exportCosimSchema,
@@ -188,5 +315,11 @@ void circt::esi::registerESITranslations() {
         registry.insert<ESIDialect, circt::hw::HWDialect, circt::sv::SVDialect,
                         mlir::func::FuncDialect, mlir::BuiltinDialect>();
       });
+  mlir::TranslateFromMLIRRegistration cosimToClient(
+      "export-esi-cosim-client", exportCosimClient,
+      [](mlir::DialectRegistry &registry) {
+        registry.insert<ESIDialect, circt::hw::HWDialect, circt::sv::SVDialect,
+                        mlir::func::FuncDialect, mlir::BuiltinDialect>();
+      });
 #endif
 }
@@ -0,0 +1,108 @@
+//===- ESIPacked.h - ESI packed wire format utilities -----------*- C++ -*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// The ESI packed wire format is a lightweight alternative to Cap'nProto for
+// cosimulation. A message is a 64-bit header followed by the payload in its
+// natural `hw.bitcast` bit layout, zero-padded to a multiple of 64 bits:
+//
+//   bits [31:0]   payload size in bits
+//   bits [63:32]  low 32 bits of the type ID
+//   bits [64+:N]  payload
+//
+// Unlike capnp, there are no pointer words and no per-field padding, so the
+// gaskets are just wires and the message size is the type's bit width plus at
+// most 127 bits of overhead.
+//
+//===----------------------------------------------------------------------===//
+
+// NOLINTNEXTLINE(llvm-header-guard)
+#ifndef CIRCT_DIALECT_ESI_PACKED_ESIPACKED_H
+#define CIRCT_DIALECT_ESI_PACKED_ESIPACKED_H
+
+#include "circt/Support/LLVM.h"
+#include "mlir/IR/Types.h"
+#include "mlir/IR/Value.h"
+#include "llvm/ADT/DenseSet.h"
+
+#include <string>
+
+namespace mlir {
+class OpBuilder;
+} // namespace mlir
+namespace llvm {
+class raw_ostream;
+} // namespace llvm
+
+namespace circt {
+namespace esi {
+namespace packed {
+
+/// Every time we implement a breaking change in the wire format, increment
+/// this number. It is a seed for all the type IDs.
+constexpr uint64_t esiPackedSchemaVersion = 1;
+
+/// Size in bits of the header which precedes every packed message.
+constexpr size_t headerBits = 64;
+
+/// Generate and reason about the packed wire format for a particular MLIR
+/// type.
+class TypeSchema {
+public:
+  TypeSchema(mlir::Type);
+  bool operator==(const TypeSchema &that) const { return type == that.type; }
+
+  /// Get the type back.
+  mlir::Type getType() const { return type; }
+
+  /// Get the packed type ID for a type.
+  uint64_t typeID() const;
+
+  /// Returns true if the type is currently supported.
+  bool isSupported() const;
+
+  /// Size in bits of the payload (the type's natural bit width).
+  size_t payloadSize() const;
+
+  /// Size in bits of the entire message, including the header and padding.
+  size_t size() const;
+
+  /// The value of the header word which precedes the payload.
+  uint64_t header() const;
+
+  /// Get the name of the generated software type.
+  llvm::StringRef name() const;
+
+  /// Write out the name and ID in a comment-friendly format.
+  void writeMetadata(llvm::raw_ostream &os) const;
+
+  /// Write out a C++ codec for this type. Struct types nested inside it are
+  /// written first unless they are already in `emitted`.
+  mlir::LogicalResult write(llvm::raw_ostream &os,
+                            llvm::DenseSet<mlir::Type> &emitted) const;
+
+  /// Write out the bit manipulation helpers used by every generated codec.
+  static void writePrologue(llvm::raw_ostream &os);
+
+  /// Build an HW/SV dialect packed encoder for this type.
+  mlir::Value buildEncoder(mlir::OpBuilder &, mlir::Value clk,
+                           mlir::Value valid, mlir::Value rawData) const;
+  /// Build an HW/SV dialect packed decoder for this type.
+  mlir::Value buildDecoder(mlir::OpBuilder &, mlir::Value clk,
+                           mlir::Value valid, mlir::Value packedData) const;
+
+private:
+  mlir::Type type;
+  mutable llvm::Optional<uint64_t> cachedID;
+  mutable std::string cachedName;
+};
+
+} // namespace packed
+} // namespace esi
+} // namespace circt
+
+#endif // CIRCT_DIALECT_ESI_PACKED_ESIPACKED_H
@@ -0,0 +1,459 @@
+//===- Schema.cpp - ESI packed wire format utilities ------------*- C++ -*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// Build the hardware gaskets and the software codec for the ESI packed wire
+// format. The payload layout is exactly what `hw.bitcast` produces: struct
+// fields are laid out MSB-first and array element 0 sits at the LSBs.
+//
+//===----------------------------------------------------------------------===//
+
+#include "ESIPacked.h"
+#include "circt/Dialect/Comb/CombOps.h"
+#include "circt/Dialect/ESI/ESITypes.h"
+#include "circt/Dialect/HW/HWOps.h"
+#include "circt/Dialect/HW/HWTypes.h"
+#include "circt/Dialect/SV/SVOps.h"
+
+#include "mlir/IR/Builders.h"
+#include "mlir/IR/BuiltinTypes.h"
+#include "llvm/ADT/Hashing.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/ADT/TypeSwitch.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/MathExtras.h"
+
+using namespace circt;
+using namespace circt::esi::packed;
+
+//===----------------------------------------------------------------------===//
+// Type properties.
+//===----------------------------------------------------------------------===//
+
+TypeSchema::TypeSchema(Type t) : type(t) {
+  if (auto chan = type.dyn_cast<circt::esi::ChannelPort>())
+    type = chan.getInner();
+}
+
+/// Returns true if the type is currently supported. Since the payload is just
+/// the type's bits, nested aggregates are fine. Integers are limited to 64 bits
+/// so that the software codec can use native integer types.
+static bool isSupported(Type type) {
+  return llvm::TypeSwitch<Type, bool>(type)
+      .Case([](IntegerType t) {
+        return t.getWidth() > 0 && t.getWidth() <= 64;
+      })
+      .Case([](hw::ArrayType t) {
+        return t.getSize() > 0 && isSupported(t.getElementType());
+      })
+      .Case([](hw::StructType t) {
+        if (t.getElements().empty())
+          return false;
+        return llvm::all_of(t.getElements(), [](auto field) {
+          return isSupported(field.type);
+        });
+      })
+      .Default([](Type) { return false; });
+}
+
+bool TypeSchema::isSupported() const { return ::isSupported(type); }
+
+// We compute a deterministic hash based on the type. Since llvm::hash_value
+// changes from execution to execution, we don't use it.
+uint64_t TypeSchema::typeID() const {
+  if (cachedID)
+    return *cachedID;
+
+  // Get the MLIR asm type, padded to a multiple of 64 bytes.
+  std::string typeName;
+  llvm::raw_string_ostream osName(typeName);
+  osName << "packed:" << type;
+  size_t overhang = osName.tell() % 64;
+  if (overhang != 0)
+    osName.indent(64 - overhang);
+  osName.flush();
+  const char *typeNameC = typeName.c_str();
+
+  uint64_t hash = esiPackedSchemaVersion;
+  for (size_t i = 0, e = typeName.length() / 64; i < e; ++i)
+    hash =
+        llvm::hashing::detail::hash_33to64_bytes(&typeNameC[i * 64], 64, hash);
+  cachedID = hash;
+  return *cachedID;
+}
+
+size_t TypeSchema::payloadSize() const { return hw::getBitWidth(type); }
+
+size_t TypeSchema::size() const {
+  return headerBits + llvm::alignTo(payloadSize(), 64);
+}
+
+uint64_t TypeSchema::header() const {
+  return (typeID() & 0xFFFFFFFF) << 32 | payloadSize();
+}
+
+/// Write a valid C++ identifier for 'type'.
+static void emitName(Type type, uint64_t id, llvm::raw_ostream &os) {
+  llvm::TypeSwitch<Type>(type)
+      .Case([&os](IntegerType intTy) {
+        std::string intName;
+        llvm::raw_string_ostream(intName) << intTy;
+        intName[0] = toupper(intName[0]);
+        os << intName;
+      })
+      .Case([&os](hw::ArrayType arrTy) {
+        // Name the element after its own ID, so that arrays of different
+        // structs do not share a name.
+        TypeSchema element(arrTy.getElementType());
+        os << "ArrayOf" << arrTy.getSize() << 'x';
+        emitName(element.getType(), element.typeID(), os);
+      })
+      .Case([&os, id](hw::StructType t) { os << "Struct" << id; })
+      .Default([](Type) {
+        assert(false && "Type not supported. Please check support first with "
+                        "isSupported()");
+      });
+}
+
+StringRef TypeSchema::name() const {
+  if (cachedName.empty()) {
+    llvm::raw_string_ostream os(cachedName);
+    emitName(type, typeID(), os);
+    os.flush();
+  }
+  return cachedName;
+}
+
+void TypeSchema::writeMetadata(llvm::raw_ostream &os) const {
+  os << name() << " " << llvm::format_hex(typeID(), /*width=*/16 + 2);
+}
+
+//===----------------------------------------------------------------------===//
+// Software codec generation.
+//
+// Every message type becomes a C++ struct. Non-struct types are wrapped in a
+// struct with a single field named `i`, the same as the capnp schema does.
+// Offsets are all compile-time constants, so the generated code is a flat
+// sequence of bit inserts and extracts.
+//===----------------------------------------------------------------------===//
+
+void TypeSchema::writePrologue(llvm::raw_ostream &os) {
+  os << R"(#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace esi_packed {
+
+/// Write the low `width` bits of `value` at bit `offset` of `msg`.
+inline void insertBits(uint8_t *msg, size_t offset, size_t width,
+                       uint64_t value) {
+  while (width > 0) {
+    size_t bit = offset % 8;
+    size_t chunk = std::min<size_t>(8 - bit, width);
+    uint8_t mask = ((1u << chunk) - 1) << bit;
+    msg[offset / 8] = (msg[offset / 8] & ~mask) | ((value << bit) & mask);
+    value >>= chunk;
+    offset += chunk;
+    width -= chunk;
+  }
+}
+
+/// Read `width` bits starting at bit `offset` of `msg`.
+inline uint64_t extractBits(const uint8_t *msg, size_t offset, size_t width) {
+  uint64_t value = 0;
+  for (size_t done = 0; done < width;) {
+    size_t bit = offset % 8;
+    size_t chunk = std::min<size_t>(8 - bit, width - done);
+    uint64_t bits = (msg[offset / 8] >> bit) & ((1u << chunk) - 1);
+    value |= bits << done;
+    done += chunk;
+    offset += chunk;
+  }
+  return value;
+}
+
+/// Sign extend the low `width` bits of `value`.
+inline int64_t signExtend(uint64_t value, size_t width) {
+  if (width >= 64)
+    return static_cast<int64_t>(value);
+  uint64_t sign = uint64_t(1) << (width - 1);
+  return static_cast<int64_t>((value ^ sign) - sign);
+}
+
+} // namespace esi_packed
+
+)";
+}
+
+/// Write the C++ type used to hold a value of 'type'.
+static void emitCppType(Type type, llvm::raw_ostream &os) {
+  llvm::TypeSwitch<Type>(type)
+      .Case([&os](IntegerType intTy) {
+        auto w = intTy.getWidth();
+        if (w == 1) {
+          os << "bool";
+          return;
+        }
+        os << (intTy.isSigned() ? "int" : "uint");
+        if (w <= 8)
+          os << "8";
+        else if (w <= 16)
+          os << "16";
+        else if (w <= 32)
+          os << "32";
+        else
+          os << "64";
+        os << "_t";
+      })
+      .Case([&os](hw::ArrayType arrTy) {
+        os << "std::array<";
+        emitCppType(arrTy.getElementType(), os);
+        os << ", " << arrTy.getSize() << ">";
+      })
+      .Case([&os](hw::StructType structTy) {
+        os << TypeSchema(structTy).name();
+      })
+      .Default([](Type) {
+        assert(false && "Type not supported. Please check support first with "
+                        "isSupported()");
+      });
+}
+
+/// Emit the statements which write 'value' (a C++ expression of 'type') into
+/// `msg` at bit offset `offset` (also a C++ expression).
+static void emitEncode(Type type, const std::string &value,
+                       const std::string &offset, unsigned depth,
+                       llvm::raw_ostream &os) {
+  os.indent(4 + 2 * depth);
+  llvm::TypeSwitch<Type>(type)
+      .Case([&](IntegerType intTy) {
+        os << "esi_packed::insertBits(msg, " << offset << ", "
+           << intTy.getWidth() << ", static_cast<uint64_t>(" << value
+           << "));\n";
+      })
+      .Case([&](hw::ArrayType arrTy) {
+        std::string idx = "i" + std::to_string(depth);
+        os << "for (size_t " << idx << " = 0; " << idx << " < "
+           << arrTy.getSize() << "; ++" << idx << ")\n";
+        emitEncode(arrTy.getElementType(), value + "[" + idx + "]",
+                   offset + " + " + idx + " * " +
+                       std::to_string(hw::getBitWidth(arrTy.getElementType())),
+                   depth + 1, os);
+      })
+      .Case([&](hw::StructType) {
+        os << value << ".encodeAt(msg, " << offset << ");\n";
+      });
+}
+
+/// Emit the statements which read 'value' (a C++ lvalue of 'type') from `msg`
+/// at bit offset `offset`.
+static void emitDecode(Type type, const std::string &value,
+                       const std::string &offset, unsigned depth,
+                       llvm::raw_ostream &os) {
+  os.indent(4 + 2 * depth);
+  llvm::TypeSwitch<Type>(type)
+      .Case([&](IntegerType intTy) {
+        auto w = intTy.getWidth();
+        os << value << " = ";
+        if (w == 1) {
+          os << "esi_packed::extractBits(msg, " << offset << ", 1) != 0;\n";
+          return;
+        }
+        os << "static_cast<";
+        emitCppType(intTy, os);
+        os << ">(";
+        if (intTy.isSigned())
+          os << "esi_packed::signExtend(";
+        os << "esi_packed::extractBits(msg, " << offset << ", " << w << ")";
+        if (intTy.isSigned())
+          os << ", " << w << ")";
+        os << ");\n";
+      })
+      .Case([&](hw::ArrayType arrTy) {
+        std::string idx = "i" + std::to_string(depth);
+        os << "for (size_t " << idx << " = 0; " << idx << " < "
+           << arrTy.getSize() << "; ++" << idx << ")\n";
+        emitDecode(arrTy.getElementType(), value + "[" + idx + "]",
+                   offset + " + " + idx + " * " +
+                       std::to_string(hw::getBitWidth(arrTy.getElementType())),
+                   depth + 1, os);
+      })
+      .Case([&](hw::StructType structTy) {
+        os << value << " = " << TypeSchema(structTy).name()
+           << "::decodeAt(msg, " << offset << ");\n";
+      });
+}
+
+/// Return the C++ name of a struct field. Field names which would clash with
+/// the members, parameters and locals of the generated code get a trailing
+/// underscore.
+static std::string fieldName(StringAttr name) {
+  static const StringLiteral reserved[] = {
+      "typeID",   "header", "payloadBits", "messageBytes", "encodeAt",
+      "decodeAt", "encode", "decode",      "msg",          "offset",
+      "v",        "esi_packed"};
+  StringRef str = name.getValue();
+  bool isLoopIndex = str.size() > 1 && str[0] == 'i' &&
+                     llvm::all_of(str.drop_front(), llvm::isDigit);
+  if (isLoopIndex || llvm::is_contained(reserved, str))
+    return (str + "_").str();
+  return str.str();
+}
+
+/// Collect the struct types nested in 'type', in post-order.
+static void collectNestedStructs(Type type, SmallVectorImpl<Type> &structs) {
+  if (auto arrTy = type.dyn_cast<hw::ArrayType>()) {
+    collectNestedStructs(arrTy.getElementType(), structs);
+  } else if (auto structTy = type.dyn_cast<hw::StructType>()) {
+    for (auto field : structTy.getElements())
+      collectNestedStructs(field.type, structs);
+    structs.push_back(structTy);
+  }
+}
+
+LogicalResult TypeSchema::write(llvm::raw_ostream &os,
+                                DenseSet<Type> &emitted) const {
+  // Nested structs are referenced by name, so they have to come first.
+  SmallVector<Type, 4> nested;
+  collectNestedStructs(type, nested);
+  for (Type nestedTy : nested) {
+    if (nestedTy == type)
+      continue;
+    if (failed(TypeSchema(nestedTy).write(os, emitted)))
+      return failure();
+  }
+  if (!emitted.insert(type).second)
+    return success();
+
+  // Non-struct types are wrapped in a struct with a single field.
+  using FieldInfo = hw::StructType::FieldInfo;
+  SmallVector<FieldInfo> fields;
+  if (auto structTy = type.dyn_cast<hw::StructType>())
+    fields.append(structTy.getElements().begin(),
+                  structTy.getElements().end());
+  else
+    fields.push_back(FieldInfo{StringAttr::get(type.getContext(), "i"), type});
+
+  // Field 0 is the most significant, so compute the offsets from the back.
+  SmallVector<size_t> offsets(fields.size());
+  size_t offset = 0;
+  for (size_t i = fields.size(); i > 0; --i) {
+    offsets[i - 1] = offset;
+    offset += hw::getBitWidth(fields[i - 1].type);
+  }
+
+  os << "// Actual type is " << type << ".\n";
+  os << "struct " << name() << " {\n";
+  os << "  static constexpr uint64_t typeID = "
+     << llvm::format_hex(typeID(), /*width=*/16 + 2) << "ULL;\n";
+  os << "  static constexpr uint64_t header = "
+     << llvm::format_hex(header(), /*width=*/16 + 2) << "ULL;\n";
+  os << "  static constexpr size_t payloadBits = " << payloadSize() << ";\n";
+  os << "  static constexpr size_t messageBytes = " << size() / 8 << ";\n\n";
+
+  for (auto field : fields) {
+    os << "  ";
+    emitCppType(field.type, os);
+    os << " " << fieldName(field.name) << ";\n";
+  }
+
+  // Payload encode / decode at an arbitrary bit offset.
+  os << "\n  void encodeAt(uint8_t *msg, size_t offset) const {\n";
+  for (size_t i = 0, e = fields.size(); i < e; ++i)
+    emitEncode(fields[i].type, fieldName(fields[i].name),
+               "offset + " + std::to_string(offsets[i]), 0, os);
+  os << "  }\n\n";
+
+  os << "  static " << name()
+     << " decodeAt(const uint8_t *msg, size_t offset) {\n";
+  os << "    " << name() << " v;\n";
+  for (size_t i = 0, e = fields.size(); i < e; ++i)
+    emitDecode(fields[i].type, "v." + fieldName(fields[i].name),
+               "offset + " + std::to_string(offsets[i]), 0, os);
+  os << "    return v;\n";
+  os << "  }\n\n";
+
+  // Whole messages, with the header.
+  os << "  /// Encode into a `messageBytes`-sized buffer.\n";
+  os << "  void encode(uint8_t *msg) const {\n";
+  os << "    std::memset(msg, 0, messageBytes);\n";
+  os << "    esi_packed::insertBits(msg, 0, 64, header);\n";
+  os << "    encodeAt(msg, " << headerBits << ");\n";
+  os << "  }\n\n";
+
+  os << "  /// Decode a `messageBytes`-sized buffer. Returns false if the\n";
+  os << "  /// header does not match this type.\n";
+  os << "  static bool decode(const uint8_t *msg, " << name() << " &v) {\n";
+  os << "    if (esi_packed::extractBits(msg, 0, 64) != header)\n";
+  os << "      return false;\n";
+  os << "    v = decodeAt(msg, " << headerBits << ");\n";
+  os << "    return true;\n";
+  os << "  }\n";
+  os << "};\n\n";
+  return success();
+}
+
+//===----------------------------------------------------------------------===//
+// Packed encode / decode "gasket" HW builders.
+//
+// Since the payload is the type's natural layout, these are just bitcasts,
+// concats, and extracts.
+//===----------------------------------------------------------------------===//
+
+Value TypeSchema::buildEncoder(OpBuilder &b, Value clk, Value valid,
+                               Value operand) const {
+  Location loc = operand.getLoc();
+  size_t payloadBits = payloadSize();
+  size_t paddingBits = size() - headerBits - payloadBits;
+
+  // Concat puts the first operand in the MSBs, so build from the top down.
+  SmallVector<Value, 3> parts;
+  if (paddingBits)
+    parts.push_back(
+        b.create<hw::ConstantOp>(loc, b.getIntegerType(paddingBits), 0));
+  Value payload = operand;
+  if (payload.getType() != b.getIntegerType(payloadBits))
+    payload =
+        b.create<hw::BitcastOp>(loc, b.getIntegerType(payloadBits), payload);
+  parts.push_back(payload);
+  parts.push_back(b.create<hw::ConstantOp>(loc, APInt(headerBits, header())));
+  Value msg = b.create<comb::ConcatOp>(loc, parts);
+
+  return b.create<hw::BitcastOp>(
+      loc, hw::ArrayType::get(b.getI1Type(), size()), msg);
+}
+
+Value TypeSchema::buildDecoder(OpBuilder &b, Value clk, Value valid,
+                               Value operand) const {
+  Location loc = operand.getLoc();
+  size_t payloadBits = payloadSize();
+  assert(operand.getType().cast<hw::ArrayType>().getSize() == size() &&
+         "Operand type and length must match the type's packed size.");
+
+  Value msg = b.create<hw::BitcastOp>(loc, b.getIntegerType(size()), operand);
+  Value payload = b.create<comb::ExtractOp>(loc, msg, headerBits, payloadBits);
+
+  // Check the header whenever a message is presented.
+  Value hdr = b.create<comb::ExtractOp>(loc, msg, 0, headerBits);
+  Value expected = b.create<hw::ConstantOp>(loc, APInt(headerBits, header()));
+  Value headerOK = b.create<comb::ICmpOp>(loc, b.getI1Type(),
+                                          comb::ICmpPredicate::eq, hdr,
+                                          expected);
+  auto alwaysAt = b.create<sv::AlwaysOp>(loc, sv::EventControl::AtPosEdge, clk);
+  auto ifValid =
+      OpBuilder(alwaysAt.getBodyRegion()).create<sv::IfOp>(loc, valid);
+  OpBuilder(ifValid.getBodyRegion())
+      .create<sv::AssertOp>(loc, headerOK,
+                            sv::DeferAssertAttr::get(
+                                loc.getContext(), sv::DeferAssert::Immediate));
+
+  if (payload.getType() == type)
+    return payload;
+  return b.create<hw::BitcastOp>(loc, type, payload);
+}
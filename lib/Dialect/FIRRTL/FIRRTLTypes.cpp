@@ -16,6 +16,7 @@
 #include "llvm/ADT/StringExtras.h"
 #include "llvm/ADT/StringSwitch.h"
 #include "llvm/ADT/TypeSwitch.h"
+#include <mutex>
 
 using namespace circt;
 using namespace firrtl;
@@ -464,6 +465,8 @@ FIRRTLType::getSubTypeByFieldID(unsigned fieldID) {
 }
 
 FIRRTLType FIRRTLType::getFinalTypeByFieldID(unsigned fieldID) {
+  if (auto bundle = dyn_cast<BundleType>())
+    return bundle.getFinalTypeByFieldID(fieldID);
   std::pair<FIRRTLType, unsigned> pair(*this, fieldID);
   while (pair.second)
     pair = pair.first.getSubTypeByFieldID(pair.second);
@@ -753,6 +756,38 @@ struct BundleTypeStorage : mlir::TypeStorage {
     return llvm::hash_combine_range(key.begin(), key.end());
   }
 
+  /// Bundles with more field IDs than this do not get a field ID table, since
+  /// the table would be too large. Large vectors nested in a bundle are the
+  /// usual culprit.
+  static constexpr unsigned maxFieldIDTableSize = 4096;
+
+  /// An entry of the field ID table.
+  struct FieldIDInfo {
+    /// The index of the element containing the field.
+    unsigned index;
+    /// The type of the field.
+    FIRRTLType type;
+  };
+
+  /// Return the field ID table of this bundle, building it on first use, or
+  /// an empty table if the bundle is too large. Types are shared between
+  /// threads, so the table is built exactly once.
+  ArrayRef<FieldIDInfo> getFieldIDTable(BundleType bundle) {
+    if (maxFieldID > maxFieldIDTableSize)
+      return {};
+    std::call_once(fieldIDTableOnce, [&] {
+      fieldIDTable.reserve(maxFieldID + 1);
+      fieldIDTable.push_back({0, bundle});
+      for (auto element : llvm::enumerate(elements)) {
+        auto type = element.value().type;
+        for (unsigned i = 0, e = type.getMaxFieldID(); i <= e; ++i)
+          fieldIDTable.push_back(
+              {unsigned(element.index()), type.getFinalTypeByFieldID(i)});
+      }
+    });
+    return fieldIDTable;
+  }
+
   static BundleTypeStorage *construct(TypeStorageAllocator &allocator,
                                       KeyTy key) {
     return new (allocator.allocate<BundleTypeStorage>()) BundleTypeStorage(key);
@@ -762,6 +797,11 @@ struct BundleTypeStorage : mlir::TypeStorage {
   SmallVector<unsigned, 4> fieldIDs;
   unsigned maxFieldID;
 
+  /// A flat table mapping each field ID to the element containing it and the
+  /// field's type. Lazily built by `getFieldIDTable`.
+  std::vector<FieldIDInfo> fieldIDTable;
+  std::once_flag fieldIDTableOnce;
+
   /// This holds the bits for the type's recursive properties, and can hold a
   /// pointer to a passive version of the type.
   llvm::PointerIntPair<Type, RecursiveTypeProperties::numBits, unsigned>
@@ -880,6 +920,11 @@ unsigned BundleType::getFieldID(unsigned index) {
 
 unsigned BundleType::getIndexForFieldID(unsigned fieldID) {
   assert(getElements().size() && "Bundle must have >0 fields");
+  auto table = getImpl()->getFieldIDTable(*this);
+  if (!table.empty()) {
+    assert(fieldID < table.size() && "fieldID out of range");
+    return table[fieldID].index;
+  }
   auto fieldIDs = getImpl()->fieldIDs;
   auto *it = std::prev(llvm::upper_bound(fieldIDs, fieldID));
   return std::distance(fieldIDs.begin(), it);
@@ -889,13 +934,24 @@ std::pair<FIRRTLType, unsigned>
 BundleType::getSubTypeByFieldID(unsigned fieldID) {
   if (fieldID == 0)
     return {*this, 0};
-  auto fieldIDs = getImpl()->fieldIDs;
   auto subfieldIndex = getIndexForFieldID(fieldID);
   auto subfieldType = getElementType(subfieldIndex);
   auto subfieldID = fieldID - getFieldID(subfieldIndex);
   return {subfieldType, subfieldID};
 }
 
+FIRRTLType BundleType::getFinalTypeByFieldID(unsigned fieldID) {
+  auto table = getImpl()->getFieldIDTable(*this);
+  if (!table.empty()) {
+    assert(fieldID < table.size() && "fieldID out of range");
+    return table[fieldID].type;
+  }
+  std::pair<FIRRTLType, unsigned> pair(*this, fieldID);
+  while (pair.second)
+    pair = pair.first.getSubTypeByFieldID(pair.second);
+  return pair.first;
+}
+
 unsigned BundleType::getMaxFieldID() { return getImpl()->maxFieldID; }
 
 std::pair<unsigned, bool> BundleType::rootChildFieldID(unsigned fieldID,
@@ -917,7 +973,8 @@ namespace detail {
 struct VectorTypeStorage : mlir::TypeStorage {
   using KeyTy = std::pair<FIRRTLType, size_t>;
 
-  VectorTypeStorage(KeyTy value) : value(value) {
+  VectorTypeStorage(KeyTy value)
+      : value(value), elementMaxFieldID(value.first.getMaxFieldID()) {
     auto properties = value.first.getRecursiveTypeProperties();
     passiveContainsAnalogTypeInfo.setInt(properties.toFlags());
   }
@@ -931,6 +988,10 @@ struct VectorTypeStorage : mlir::TypeStorage {
 
   KeyTy value;
 
+  /// The maximum field ID of the element type, cached since every field ID
+  /// computation on the vector needs it.
+  size_t elementMaxFieldID;
+
   /// This holds the bits for the type's recursive properties, and can hold a
   /// pointer to a passive version of the type.
   llvm::PointerIntPair<Type, RecursiveTypeProperties::numBits, size_t>
@@ -978,13 +1039,13 @@ FIRRTLType FVectorType::getPassiveType() {
 }
 
 size_t FVectorType::getFieldID(size_t index) {
-  return 1 + index * (getElementType().getMaxFieldID() + 1);
+  return 1 + index * (getImpl()->elementMaxFieldID + 1);
 }
 
 size_t FVectorType::getIndexForFieldID(size_t fieldID) {
   assert(fieldID && "fieldID must be at least 1");
   // Divide the field ID by the number of fieldID's per element.
-  return (fieldID - 1) / (getElementType().getMaxFieldID() + 1);
+  return (fieldID - 1) / (getImpl()->elementMaxFieldID + 1);
 }
 
 std::pair<FIRRTLType, size_t> FVectorType::getSubTypeByFieldID(size_t fieldID) {
@@ -995,7 +1056,7 @@ std::pair<FIRRTLType, size_t> FVectorType::getSubTypeByFieldID(size_t fieldID) {
 }
 
 size_t FVectorType::getMaxFieldID() {
-  return getNumElements() * (getElementType().getMaxFieldID() + 1);
+  return getNumElements() * (getImpl()->elementMaxFieldID + 1);
 }
 
 std::pair<size_t, bool> FVectorType::rootChildFieldID(size_t fieldID,
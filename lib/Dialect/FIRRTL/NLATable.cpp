@@ -44,6 +44,13 @@ ArrayRef<HierPathOp> NLATable::lookup(Operation *op) {
   return lookup(name);
 }
 
+ArrayRef<HierPathOp> NLATable::lookupInnerRef(hw::InnerRefAttr ref) {
+  auto iter = innerRefMap.find(ref);
+  if (iter == innerRefMap.end())
+    return {};
+  return iter->second;
+}
+
 HierPathOp NLATable::getNLA(StringAttr name) {
   auto *n = symToOp.lookup(name);
   return dyn_cast_or_null<HierPathOp>(n);
@@ -62,6 +69,7 @@ void NLATable::addNLA(HierPathOp nla) {
     else if (auto inr = ent.dyn_cast<hw::InnerRefAttr>())
       nodeMap[inr.getModule()].push_back(nla);
   }
+  addInnerRefs(nla);
 }
 
 void NLATable::erase(HierPathOp nla, SymbolTable *symbolTable) {
@@ -71,21 +79,26 @@ void NLATable::erase(HierPathOp nla, SymbolTable *symbolTable) {
       llvm::erase_value(nodeMap[mod.getAttr()], nla);
     else if (auto inr = ent.dyn_cast<hw::InnerRefAttr>())
       llvm::erase_value(nodeMap[inr.getModule()], nla);
+  eraseInnerRefs(nla);
   if (symbolTable)
     symbolTable->erase(nla);
 }
 
 void NLATable::updateModuleInNLA(HierPathOp nlaOp, StringAttr oldModule,
                                  StringAttr newModule) {
-  nlaOp.updateModule(oldModule, newModule);
   auto &nlas = nodeMap[oldModule];
   auto *iter = std::find(nlas.begin(), nlas.end(), nlaOp);
-  if (iter != nlas.end()) {
-    nlas.erase(iter);
-    if (nlas.empty())
-      nodeMap.erase(oldModule);
-    nodeMap[newModule].push_back(nlaOp);
+  if (iter == nlas.end()) {
+    nlaOp.updateModule(oldModule, newModule);
+    return;
   }
+  eraseInnerRefs(nlaOp);
+  nlaOp.updateModule(oldModule, newModule);
+  addInnerRefs(nlaOp);
+  nlas.erase(iter);
+  if (nlas.empty())
+    nodeMap.erase(oldModule);
+  nodeMap[newModule].push_back(nlaOp);
 }
 
 void NLATable::updateModuleInNLA(StringAttr name, StringAttr oldModule,
@@ -103,8 +116,11 @@ void NLATable::renameModule(StringAttr oldModName, StringAttr newModName) {
   auto iter = nodeMap.find(oldModName);
   if (iter == nodeMap.end())
     return;
-  for (auto nla : iter->second)
+  for (auto nla : iter->second) {
+    eraseInnerRefs(nla);
     nla.updateModule(oldModName, newModName);
+    addInnerRefs(nla);
+  }
   nodeMap[newModName] = iter->second;
   nodeMap.erase(oldModName);
   symToOp[newModName] = op->second;
@@ -118,9 +134,36 @@ void NLATable::renameModuleAndInnerRef(
   if (newModName == oldModName)
     return;
   for (auto nla : lookup(oldModName)) {
+    eraseInnerRefs(nla);
     nla.updateModuleAndInnerRef(oldModName, newModName, innerSymRenameMap);
+    addInnerRefs(nla);
     nodeMap[newModName].push_back(nla);
   }
   nodeMap.erase(oldModName);
   return;
 }
+
+void NLATable::addInnerRefs(HierPathOp nla) {
+  for (auto it : llvm::enumerate(nla.namepath())) {
+    auto inr = it.value().dyn_cast<hw::InnerRefAttr>();
+    if (!inr)
+      continue;
+    innerRefMap[inr].push_back(nla);
+    innerRefPositions[{nla, inr}] = it.index();
+  }
+}
+
+void NLATable::eraseInnerRefs(HierPathOp nla) {
+  for (auto ent : nla.namepath()) {
+    auto inr = ent.dyn_cast<hw::InnerRefAttr>();
+    if (!inr)
+      continue;
+    auto iter = innerRefMap.find(inr);
+    if (iter != innerRefMap.end()) {
+      llvm::erase_value(iter->second, nla);
+      if (iter->second.empty())
+        innerRefMap.erase(iter);
+    }
+    innerRefPositions.erase({nla, inr});
+  }
+}
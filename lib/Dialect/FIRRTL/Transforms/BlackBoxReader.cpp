@@ -23,8 +23,11 @@
 #include "circt/Dialect/SV/SVOps.h"
 #include "circt/Support/Path.h"
 #include "mlir/IR/Attributes.h"
+#include "mlir/IR/Threading.h"
 #include "mlir/Support/FileUtilities.h"
 #include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringSet.h"
 #include "llvm/Support/Debug.h"
 #include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Support/Path.h"
@@ -44,6 +47,7 @@ using sv::VerbatimOp;
 namespace {
 struct BlackBoxReaderPass : public BlackBoxReaderBase<BlackBoxReaderPass> {
   void runOnOperation() override;
+  void readFiles();
   bool runOnAnnotation(Operation *op, Annotation anno, OpBuilder &builder,
                        bool isCover);
   VerbatimOp loadFile(Operation *op, StringRef inputPath, OpBuilder &builder);
@@ -59,6 +63,10 @@ private:
   /// annotations from generating the same file.
   SmallPtrSet<Attribute, 8> emittedFiles;
 
+  /// The contents of every file referenced by a black box path annotation,
+  /// keyed by input path.  The buffer is null if the file could not be read.
+  llvm::StringMap<std::unique_ptr<llvm::MemoryBuffer>> fileContents;
+
   /// A list of all files which will be included in the file list.  This is
   /// subset of all emitted files.
   SmallVector<StringRef> fileListFiles;
@@ -155,6 +163,9 @@ void BlackBoxReaderPass::runOnOperation() {
                           << "Black box resource file name: "
                           << resourceFileName << "\n");
 
+  // Read all the files referenced by black box path annotations up front.
+  readFiles();
+
   // Newly generated IR will be placed at the end of the circuit.
   auto builder = OpBuilder::atBlockEnd(circuitOp->getBlock());
 
@@ -227,6 +238,71 @@ void BlackBoxReaderPass::runOnOperation() {
   // Clean up.
   emittedFiles.clear();
   fileListFiles.clear();
+  fileContents.clear();
+}
+
+/// Read the source files of all black box path annotations in the circuit.
+/// Each distinct path is only read once, and the files are read in parallel
+/// since they may live on a slow filesystem.  Files whose output name is
+/// already taken by an earlier annotation are skipped, since they would not be
+/// emitted anyway.  Errors are reported later, when the annotation is
+/// processed.
+void BlackBoxReaderPass::readFiles() {
+  SmallVector<llvm::StringMapEntry<std::unique_ptr<llvm::MemoryBuffer>> *>
+      entries;
+  // The output names claimed so far, in the order the annotations are
+  // processed in.  Operations with an explicit output file do not claim one,
+  // see `setOutputFile`.
+  llvm::StringSet<> outputNames;
+  for (auto &op : *getOperation().getBody()) {
+    if (!isa<FModuleOp, FExtModuleOp>(op))
+      continue;
+    auto outputFile = op.getAttrOfType<OutputFileAttr>("output_file");
+    bool claimsName = !outputFile || outputFile.isDirectory();
+    for (auto anno : AnnotationSet(&op)) {
+      if (anno.isClass(blackBoxInlineAnnoClass)) {
+        auto name = anno.getMember<StringAttr>("name");
+        if (name && anno.getMember<StringAttr>("text") && claimsName)
+          outputNames.insert(name.getValue());
+        continue;
+      }
+      if (!anno.isClass(blackBoxPathAnnoClass))
+        continue;
+      auto path = anno.getMember<StringAttr>("path");
+      if (!path)
+        continue;
+      SmallString<128> inputPath(inputPrefix);
+      appendPossiblyAbsolutePath(inputPath, path.getValue());
+      auto fileName = llvm::sys::path::filename(path.getValue());
+      if (outputNames.contains(fileName)) {
+        if (fileContents.count(inputPath))
+          ++numCacheHits;
+        continue;
+      }
+      if (claimsName)
+        outputNames.insert(fileName);
+      auto [it, inserted] = fileContents.try_emplace(inputPath);
+      if (inserted)
+        entries.push_back(&*it);
+      else
+        ++numCacheHits;
+    }
+  }
+
+  // The entries of a StringMap are stable, so each thread can write the
+  // contents of its own entry directly.
+  mlir::parallelForEachN(&getContext(), 0, entries.size(), [&](size_t i) {
+    auto *entry = entries[i];
+    std::string errorMessage;
+    entry->second = mlir::openInputFile(entry->first(), &errorMessage);
+  });
+
+  for (auto *entry : entries) {
+    if (!entry->second)
+      continue;
+    ++numFilesRead;
+    numBytesRead += entry->second->getBufferSize();
+  }
 }
 
 /// Run on an operation-annotation pair. The annotation need not be a black box
@@ -268,6 +344,11 @@ bool BlackBoxReaderPass::runOnAnnotation(Operation *op, Annotation anno,
       signalPassFailure();
       return true;
     }
+    // Skip this path annotation if the target is already generated.
+    auto name = builder.getStringAttr(llvm::sys::path::filename(path));
+    if (emittedFiles.count(name))
+      return true;
+
     SmallString<128> inputPath(inputPrefix);
     appendPossiblyAbsolutePath(inputPath, path.getValue());
     auto verbatim = loadFile(op, inputPath, builder);
@@ -276,7 +357,6 @@ bool BlackBoxReaderPass::runOnAnnotation(Operation *op, Annotation anno,
       signalPassFailure();
       return false;
     }
-    auto name = builder.getStringAttr(llvm::sys::path::filename(path));
     setOutputFile(verbatim, op, name, isDut(op), isCover);
     return true;
   }
@@ -298,11 +378,23 @@ VerbatimOp BlackBoxReaderPass::loadFile(Operation *op, StringRef inputPath,
   if (emittedFiles.count(fileNameAttr))
     return {};
 
-  // Open and read the input file.
-  std::string errorMessage;
-  auto input = mlir::openInputFile(inputPath, &errorMessage);
-  if (!input)
+  // The input file was read by readFiles, unless an earlier annotation claimed
+  // the same output name but its file could not be read.
+  auto it = fileContents.find(inputPath);
+  if (it == fileContents.end()) {
+    std::string errorMessage;
+    it = fileContents
+             .try_emplace(inputPath,
+                          mlir::openInputFile(inputPath, &errorMessage))
+             .first;
+    if (it->second) {
+      ++numFilesRead;
+      numBytesRead += it->second->getBufferSize();
+    }
+  }
+  if (!it->second)
     return {};
+  auto &input = it->second;
 
   // Create an IR node to hold the contents.  Use "unknown location" so that no
   // file info will unnecessarily print.
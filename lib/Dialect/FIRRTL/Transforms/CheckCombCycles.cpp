@@ -15,10 +15,12 @@
 #include "circt/Dialect/FIRRTL/FIRRTLUtils.h"
 #include "circt/Dialect/FIRRTL/FIRRTLVisitors.h"
 #include "circt/Dialect/FIRRTL/Passes.h"
+#include "circt/Dialect/HW/InstanceGraphLevels.h"
+#include "mlir/IR/Diagnostics.h"
 #include "llvm/ADT/DepthFirstIterator.h"
-#include "llvm/ADT/PostOrderIterator.h"
 #include "llvm/ADT/SCCIterator.h"
 #include "llvm/ADT/SmallSet.h"
+#include <atomic>
 #include <variant>
 
 using namespace circt;
@@ -29,7 +31,7 @@ using namespace firrtl;
 //===----------------------------------------------------------------------===//
 
 using CombPathsType = SmallVector<SmallVector<size_t, 2>>;
-using CombPathsMap = DenseMap<Operation *, CombPathsType>;
+using CombPathsMap = hw::ModuleSummaries<CombPathsType>;
 
 using ConnectIterator =
     mlir::detail::op_iterator<FConnectLike, Region::OpIterator>;
@@ -39,11 +41,11 @@ namespace {
 /// The graph context containing pointers of the combinational paths map and the
 /// instance graph.
 struct NodeContext {
-  CombPathsMap *map;
+  const CombPathsMap *map;
   InstanceGraph *graph;
   ConnectRange connects;
 
-  explicit NodeContext(CombPathsMap *map, InstanceGraph *graph,
+  explicit NodeContext(const CombPathsMap *map, InstanceGraph *graph,
                        ConnectRange connects)
       : map(map), graph(graph), connects(connects) {}
 };
@@ -143,7 +145,7 @@ public:
   bool operator!=(const NodeIterator &rhs) const { return !(*this == rhs); }
 
   Value getValue() { return node.value; }
-  CombPathsMap *getCombPathsMap() {
+  const CombPathsMap *getCombPathsMap() {
     assert(node.context && "invalid node context");
     return node.context->map;
   }
@@ -189,8 +191,9 @@ public:
       return;
 
     // Query the combinational paths between IOs of the current instance.
-    auto module = getInstanceGraph()->getReferencedModule(instance);
-    auto &combPaths = getCombPathsMap()->FindAndConstruct(module).second;
+    auto *target =
+        getInstanceGraph()->lookup(instance.moduleNameAttr().getAttr());
+    auto &combPaths = (*getCombPathsMap())[target];
     auto &ports = combPaths[getValue().cast<OpResult>().getResultNumber()];
 
     portEnd = ports.end();
@@ -212,8 +215,8 @@ public:
 
 private:
   InstanceOp instance;
-  SmallVectorImpl<size_t>::iterator portEnd;
-  SmallVectorImpl<size_t>::iterator portIt;
+  SmallVectorImpl<size_t>::const_iterator portEnd;
+  SmallVectorImpl<size_t>::const_iterator portIt;
 };
 } // namespace
 
@@ -649,88 +652,101 @@ void dumpSimpleCycle(SCCIterator &scc, FModuleOp module,
 /// This pass constructs a local graph for each module to detect combinational
 /// cycles. To capture the cross-module combinational cycles, this pass inlines
 /// the combinational paths between IOs of its subinstances into a subgraph and
-/// encodes them in a `combPathsMap`.
+/// summarizes them for every module.
 class CheckCombCyclesPass : public CheckCombCyclesBase<CheckCombCyclesPass> {
   void runOnOperation() override {
     auto &instanceGraph = getAnalysis<InstanceGraph>();
-    bool detectedCycle = false;
-
-    // Traverse modules in a post order to make sure the combinational paths
-    // between IOs of a module have been detected and recorded in `combPathsMap`
-    // before we handle its parent modules.
-    for (auto node : llvm::post_order<InstanceGraph *>(&instanceGraph)) {
-      if (auto module = dyn_cast<FModuleOp>(*node->getModule())) {
-        NodeContext context(&map, &instanceGraph,
-                            module.getOps<FConnectLike>());
-        auto dummyNode = Node(nullptr, &context);
-
-        // Traversing SCCs in the combinational graph to detect cycles. As
-        // FIRRTL module is an SSA region, all cycles must contain at least one
-        // connect op. Thus we introduce a dummy source node to iterate on the
-        // `dest`s of all connect ops in the module.
-        for (auto combSCC = SCCIterator::begin(dummyNode); !combSCC.isAtEnd();
-             ++combSCC) {
-          if (combSCC.hasCycle()) {
-            detectedCycle = true;
-            auto errorDiag = mlir::emitError(
-                module.getLoc(),
-                "detected combinational cycle in a FIRRTL module");
-            if (printSimpleCycle)
-              dumpSimpleCycle(combSCC, module, errorDiag);
-            else {
-              for (auto node : *combSCC) {
-                auto &noteDiag = errorDiag.attachNote(node.value.getLoc());
-                noteDiag << "this operation is part of the combinational cycle";
-              }
-            }
+    auto levels = hw::InstanceGraphLevels::get(instanceGraph);
+    if (failed(levels))
+      return signalPassFailure();
+    std::atomic<bool> detectedCycle = false;
+
+    // Diagnostics are emitted in module index order, regardless of the order
+    // modules are checked in.
+    mlir::ParallelDiagnosticHandler diagHandler(&getContext());
+
+    // Traverse modules bottom-up to make sure the combinational paths between
+    // IOs of a module have been detected before we handle its parent modules.
+    // Modules on the same level of the hierarchy are checked in parallel.
+    hw::summarizeBottomUp<CombPathsType>(
+        &getContext(), *levels,
+        [&](InstanceGraphNode *node, const CombPathsMap &map) {
+          auto module = dyn_cast<FModuleOp>(*node->getModule());
+          if (!module) {
+            // TODO: Handle FExtModuleOp with `ExtModulePathAnnotation`s.
+            auto moduleLike = cast<FModuleLike>(*node->getModule());
+            return CombPathsType(moduleLike.getNumPorts());
           }
-        }
+          bool moduleHasCycle = false;
+          diagHandler.setOrderIDForThread(levels->getIndex(node));
+          auto combPaths =
+              checkModule(module, map, instanceGraph, moduleHasCycle);
+          diagHandler.eraseOrderIDForThread();
+          if (moduleHasCycle)
+            detectedCycle = true;
+          return combPaths;
+        });
 
-        SmallVector<bool, 8> directionVec;
-        for (auto &port : module.getPorts())
-          directionVec.push_back(port.isOutput());
-
-        auto &combPaths = map[module];
-        NodeDenseSet nodeSet;
-        SmallVector<size_t, 2> outputVec;
-        unsigned index = 0;
-
-        // Record all combinational paths.
-        for (auto &port : module.getPorts()) {
-          nodeSet.clear();
-          outputVec.clear();
-          auto arg = module.getArgument(index++);
-          if (port.isOutput()) {
-            combPaths.push_back(outputVec);
-            continue;
-          }
-          Node inputNode(arg, &context);
-          for (auto node : llvm::depth_first_ext<Node>(inputNode, nodeSet)) {
-            if (auto output = node.value.dyn_cast<BlockArgument>())
-              if (directionVec[output.getArgNumber()])
-                outputVec.push_back(output.getArgNumber());
+    if (detectedCycle)
+      signalPassFailure();
+    markAllAnalysesPreserved();
+  }
+
+  /// Report the combinational cycles in a module, setting `detectedCycle` if
+  /// there are any, and return the combinational paths between its IOs.
+  CombPathsType checkModule(FModuleOp module, const CombPathsMap &map,
+                            InstanceGraph &instanceGraph, bool &detectedCycle) {
+    NodeContext context(&map, &instanceGraph, module.getOps<FConnectLike>());
+    auto dummyNode = Node(nullptr, &context);
+
+    // Traversing SCCs in the combinational graph to detect cycles. As FIRRTL
+    // module is an SSA region, all cycles must contain at least one connect
+    // op. Thus we introduce a dummy source node to iterate on the `dest`s of
+    // all connect ops in the module.
+    for (auto combSCC = SCCIterator::begin(dummyNode); !combSCC.isAtEnd();
+         ++combSCC) {
+      if (combSCC.hasCycle()) {
+        detectedCycle = true;
+        auto errorDiag = mlir::emitError(
+            module.getLoc(), "detected combinational cycle in a FIRRTL module");
+        if (printSimpleCycle)
+          dumpSimpleCycle(combSCC, module, errorDiag);
+        else {
+          for (auto node : *combSCC) {
+            auto &noteDiag = errorDiag.attachNote(node.value.getLoc());
+            noteDiag << "this operation is part of the combinational cycle";
           }
-          combPaths.push_back(outputVec);
         }
-        continue;
       }
-      if (auto extModule = dyn_cast<FExtModuleOp>(*node->getModule())) {
-        // TODO: Handle FExtModuleOp with `ExtModulePathAnnotation`s.
-        auto &combPaths = map[extModule];
-        combPaths.resize(extModule.getNumPorts());
+    }
+    SmallVector<bool, 8> directionVec;
+    for (auto &port : module.getPorts())
+      directionVec.push_back(port.isOutput());
+
+    CombPathsType combPaths;
+    NodeDenseSet nodeSet;
+    SmallVector<size_t, 2> outputVec;
+    unsigned index = 0;
+
+    // Record all combinational paths.
+    for (auto &port : module.getPorts()) {
+      nodeSet.clear();
+      outputVec.clear();
+      auto arg = module.getArgument(index++);
+      if (port.isOutput()) {
+        combPaths.push_back(outputVec);
         continue;
       }
-      llvm_unreachable("invalid instance graph node");
+      Node inputNode(arg, &context);
+      for (auto node : llvm::depth_first_ext<Node>(inputNode, nodeSet)) {
+        if (auto output = node.value.dyn_cast<BlockArgument>())
+          if (directionVec[output.getArgNumber()])
+            outputVec.push_back(output.getArgNumber());
+      }
+      combPaths.push_back(outputVec);
     }
-
-    if (detectedCycle)
-      signalPassFailure();
-    markAllAnalysesPreserved();
+    return combPaths;
   }
-
-private:
-  /// A global map from FIRRTL modules to their combinational paths between IOs.
-  CombPathsMap map;
 };
 } // namespace
 
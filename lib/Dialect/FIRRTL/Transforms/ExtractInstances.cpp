@@ -22,10 +22,12 @@
 #include "circt/Dialect/FIRRTL/Passes.h"
 #include "circt/Dialect/HW/HWAttributes.h"
 #include "circt/Dialect/HW/HWDialect.h"
+#include "circt/Dialect/HW/InstanceGraphLevels.h"
 #include "circt/Dialect/SV/SVOps.h"
 #include "circt/Support/Path.h"
 #include "mlir/IR/Attributes.h"
 #include "mlir/IR/ImplicitLocOpBuilder.h"
+#include "mlir/IR/Threading.h"
 #include "mlir/Support/FileUtilities.h"
 #include "llvm/ADT/SmallPtrSet.h"
 #include "llvm/Support/Debug.h"
@@ -273,45 +275,62 @@ void ExtractInstancesPass::collectAnnos() {
     });
   }
 
-  // Gather the annotations on instances to be extracted.
-  circuit.walk([&](InstanceOp inst) {
-    SmallVector<Annotation, 1> instAnnos;
-    Operation *module = instanceGraph->getReferencedModule(inst);
-
-    // Module-level annotations.
-    auto it = annotatedModules.find(module);
-    if (it != annotatedModules.end())
-      instAnnos.append(it->second);
-
-    // Instance-level annotations.
-    AnnotationSet::removeAnnotations(inst, [&](Annotation anno) {
-      if (!isAnnoInteresting(anno))
-        return false;
-      LLVM_DEBUG(llvm::dbgs() << "Annotated instance `" << inst.name()
-                              << "`:\n  " << anno.getDict() << "\n");
-      instAnnos.push_back(anno);
-      return true;
+  // Gather the annotations on instances to be extracted. Stripping the
+  // annotations only touches the instances themselves, so this is done for
+  // all modules in parallel. The results are then processed serially in
+  // module order to keep the worklist and diagnostics deterministic.
+  using AnnotatedInstance = std::pair<InstanceOp, SmallVector<Annotation, 1>>;
+  SmallVector<FModuleOp> modules(circuit.getBody()->getOps<FModuleOp>());
+  SmallVector<SmallVector<AnnotatedInstance>> annotatedInsts(modules.size());
+  mlir::parallelForEachN(&getContext(), 0, modules.size(), [&](size_t i) {
+    modules[i].walk([&](InstanceOp inst) {
+      SmallVector<Annotation, 1> instAnnos;
+      Operation *module = instanceGraph->getReferencedModule(inst);
+
+      // Module-level annotations.
+      auto it = annotatedModules.find(module);
+      if (it != annotatedModules.end())
+        instAnnos.append(it->second);
+
+      // Instance-level annotations.
+      AnnotationSet::removeAnnotations(inst, [&](Annotation anno) {
+        if (!isAnnoInteresting(anno))
+          return false;
+        instAnnos.push_back(anno);
+        return true;
+      });
+
+      // No need to do anything about unannotated instances.
+      if (!instAnnos.empty())
+        annotatedInsts[i].push_back({inst, std::move(instAnnos)});
     });
+  });
 
-    // No need to do anything about unannotated instances.
-    if (instAnnos.empty())
-      return;
+  for (auto &moduleInsts : annotatedInsts) {
+    for (auto &[inst, instAnnos] : moduleInsts) {
+      LLVM_DEBUG({
+        llvm::dbgs() << "Annotated instance `" << inst.name() << "`:\n";
+        for (auto anno : instAnnos)
+          llvm::dbgs() << "  " << anno.getDict() << "\n";
+      });
+
+      // Ensure there are no conflicting annotations.
+      if (instAnnos.size() > 1) {
+        auto d = inst.emitError("multiple extraction annotations on instance `")
+                 << inst.name() << "`";
+        d.attachNote(inst.getLoc())
+            << "instance has the following annotations, "
+               "but at most one is allowed:";
+        for (auto anno : instAnnos)
+          d.attachNote(inst.getLoc()) << anno.getDict();
+        anyFailures = true;
+        continue;
+      }
 
-    // Ensure there are no conflicting annotations.
-    if (instAnnos.size() > 1) {
-      auto d = inst.emitError("multiple extraction annotations on instance `")
-               << inst.name() << "`";
-      d.attachNote(inst.getLoc()) << "instance has the following annotations, "
-                                     "but at most one is allowed:";
-      for (auto anno : instAnnos)
-        d.attachNote(inst.getLoc()) << anno.getDict();
-      anyFailures = true;
-      return;
+      // Process the annotation.
+      collectAnno(inst, instAnnos[0]);
     }
-
-    // Process the annotation.
-    collectAnno(inst, instAnnos[0]);
-  });
+  }
 
   // Propagate the DUT marking to all arbitrarily nested submodules of the DUT.
   LLVM_DEBUG(llvm::dbgs() << "Marking DUT hierarchy\n");
@@ -436,383 +455,563 @@ void ExtractInstancesPass::collectAnno(InstanceOp inst, Annotation anno) {
 /// mentioning exactly the instance, or the instance's parent module). Returns a
 /// position within the NLA's path, or the length of the path if the instances
 /// was not found.
-static unsigned findInstanceInNLA(InstanceOp inst, HierPathOp nla) {
-  unsigned nlaLen = nla.namepath().size();
-  auto instName = getInnerSymName(inst);
+static unsigned findInstanceInNLA(NLATable &nlaTable, InstanceOp inst,
+                                  HierPathOp nla) {
   auto parentName = cast<FModuleOp>(inst->getParentOp()).moduleNameAttr();
-  for (unsigned nlaIdx = 0; nlaIdx < nlaLen; ++nlaIdx) {
-    auto refPart = nla.refPart(nlaIdx);
-    if (nla.modPart(nlaIdx) == parentName && (!refPart || refPart == instName))
-      return nlaIdx;
-  }
+  if (auto instName = getInnerSymName(inst))
+    if (auto nlaIdx = nlaTable.getInnerRefPosition(
+            nla, InnerRefAttr::get(parentName, instName)))
+      return *nlaIdx;
+  unsigned nlaLen = nla.namepath().size();
+  if (!nla.ref() && nla.leafMod() == parentName)
+    return nlaLen - 1;
   return nlaLen;
 }
 
-/// Move instances in the extraction worklist upwards in the hierarchy. This
-/// iteratively pushes instances up one level of hierarchy until they have
+namespace {
+/// The instances moved out of a module in one go, and the ports added to the
+/// module for them.
+struct ExtractionBatch {
+  /// The instances that are moved out of the module, in extraction order.
+  SmallVector<std::pair<InstanceOp, ExtractionInfo>> insts;
+  /// The instances that have arrived at their final location.
+  SmallVector<std::pair<InstanceOp, ExtractionInfo>> done;
+  /// The ports added to the module, for all instances in `insts`.
+  SmallVector<std::pair<unsigned, PortInfo>> newPorts;
+  /// The index into `newPorts` of the first port of each instance.
+  SmallVector<unsigned> portOffsets;
+  /// The number of ports the module had before the batch was added.
+  unsigned numParentPorts = 0;
+};
+
+/// One instance in the extraction order: either an instance in the worklist,
+/// or one of the copies made when an instance leaves its parent module.
+struct ExtractionStep {
+  /// The wiring prefix of the instance, if any.
+  SmallString<16> prefix;
+  /// The step of the copy made for each instantiation of the parent module, in
+  /// the order of the instantiations. Empty if the instance stays in place.
+  SmallVector<unsigned, 1> copies;
+};
+} // namespace
+
+/// Move instances in the extraction worklist upwards in the hierarchy. The
+/// modules are visited bottom-up, one level of the instance hierarchy at a
+/// time. All instances leaving a module are moved out as one batch: the module
+/// gains the ports for the whole batch at once, and each instantiation of the
+/// module is rewritten once to host the batch and wire it up. The moved
+/// instances join the batch of their new parent module, until they have
 /// arrived in the desired container module.
 void ExtractInstancesPass::extractInstances() {
-  // The list of ports to be added to an instance's parent module. Cleared and
-  // reused across instances.
-  SmallVector<std::pair<unsigned, PortInfo>> newPorts;
   // The number of instances with the same prefix. Used to uniquify prefices.
   DenseMap<StringRef, unsigned> prefixUniqueIDs;
+  // The extraction order, and the position of each instance in it. Batches
+  // are sorted by this position, which fixes the order of the ports added to
+  // a module.
+  SmallVector<ExtractionStep> steps;
+  DenseMap<Operation *, unsigned> extractionOrder;
 
   SmallPtrSet<Operation *, 4> nlasToRemove;
 
   auto &nlaTable = getAnalysis<NLATable>();
+  auto maybeLevels = hw::InstanceGraphLevels::get(*instanceGraph);
+  if (failed(maybeLevels)) {
+    anyFailures = true;
+    return;
+  }
+  auto &levels = *maybeLevels;
+
+  // Lay out the extraction order up front. This is the order in which moving
+  // one instance up by one level at a time, always picking the instance last
+  // added to the worklist, visits the instances and their copies. It
+  // determines the wiring prefices, the order of the added ports, and the
+  // order of the trace files.
+  //
+  // If we are supposed to use a wiring prefix (`info.prefix` is non-empty),
+  // we assemble a `<prefix>_<N>` string, where `N` is an unsigned integer used
+  // to uniquifiy the prefix. This is very close to what the original Scala
+  // implementation of the pass does, which would group instances to be
+  // extracted by prefix and then iterate over them with the index in the group
+  // being used as `N`. The copy made for the first instantiation of a parent
+  // module inherits the prefix of the instance it was copied from.
+  struct ReplayItem {
+    hw::InstanceGraphNode *parent;
+    StringRef prefix;
+    bool stopAtDUT;
+    /// The step this one is a copy of, and the index of the copy, or ~0U and
+    /// the position in the worklist for the instances in the worklist.
+    unsigned original;
+    unsigned copy;
+  };
+  SmallVector<unsigned> worklistSteps(extractionWorklist.size());
+  SmallVector<ReplayItem> replay;
+  for (unsigned i = 0, e = extractionWorklist.size(); i != e; ++i) {
+    auto &[inst, info] = extractionWorklist[i];
+    replay.push_back({instanceGraph->lookup(inst->getParentOfType<FModuleOp>()),
+                      info.prefix, info.stopAtDUT, ~0U, i});
+  }
+  while (!replay.empty()) {
+    auto item = replay.pop_back_val();
+    unsigned step = steps.size();
+    steps.emplace_back();
+    if (item.original == ~0U)
+      worklistSteps[item.copy] = step;
+    else
+      steps[item.original].copies[item.copy] = step;
+
+    if (item.original != ~0U && item.copy == 0)
+      steps[step].prefix = steps[item.original].prefix;
+    else if (!item.prefix.empty())
+      (Twine(item.prefix) + "_" + Twine(prefixUniqueIDs[item.prefix]++))
+          .toVector(steps[step].prefix);
+
+    Operation *parent = item.parent->getModule();
+    if (!dutModules.contains(parent) || item.parent->noUses() ||
+        (item.stopAtDUT && dutRootModules.contains(parent)))
+      continue;
+    unsigned copy = 0;
+    for (auto *instRecord : item.parent->uses())
+      replay.push_back({instRecord->getParent(), item.prefix, item.stopAtDUT,
+                        step, copy++});
+    steps[step].copies.resize(copy);
+  }
+
+  // Record the position and the wiring prefix of an instance.
+  auto assignStep = [&](InstanceOp inst, unsigned step) {
+    extractionOrder[inst] = step;
+    if (!steps[step].prefix.empty())
+      instPrefices[inst] = steps[step].prefix;
+  };
+  auto inExtractionOrder = [&](const auto &a, const auto &b) {
+    return extractionOrder.lookup(a.first) < extractionOrder.lookup(b.first);
+  };
+
+  // The instances to be moved out of each module, indexed by module.
+  SmallVector<SmallVector<std::pair<InstanceOp, ExtractionInfo>>> pending(
+      levels.size());
+  auto addPending = [&](InstanceOp inst, const ExtractionInfo &info) {
+    auto *node = instanceGraph->lookup(inst->getParentOfType<FModuleOp>());
+    pending[levels.getIndex(node)].push_back({inst, info});
+  };
 
   // Keep track of where the instance was originally.
-  for (auto &[inst, info] : extractionWorklist)
+  for (unsigned i = 0, e = extractionWorklist.size(); i != e; ++i) {
+    auto &[inst, info] = extractionWorklist[i];
     originalInstanceParents[inst] =
         inst->getParentOfType<FModuleLike>().moduleNameAttr();
+    assignStep(inst, worklistSteps[i]);
+    addPending(inst, info);
+  }
+  extractionWorklist.clear();
 
-  while (!extractionWorklist.empty()) {
-    InstanceOp inst;
-    ExtractionInfo info;
-    std::tie(inst, info) = extractionWorklist.pop_back_val();
-    auto parent = inst->getParentOfType<FModuleOp>();
-
-    // Figure out the wiring prefix to use for this instance. If we are supposed
-    // to use a wiring prefix (`info.prefix` is non-empty), we assemble a
-    // `<prefix>_<N>` string, where `N` is an unsigned integer used to uniquifiy
-    // the prefix. This is very close to what the original Scala implementation
-    // of the pass does, which would group instances to be extracted by prefix
-    // and then iterate over them with the index in the group being used as `N`.
-    StringRef prefix;
-    if (!info.prefix.empty()) {
-      auto &prefixSlot = instPrefices[inst];
-      if (prefixSlot.empty()) {
-        auto idx = prefixUniqueIDs[info.prefix]++;
-        (Twine(info.prefix) + "_" + Twine(idx)).toVector(prefixSlot);
-      }
-      prefix = prefixSlot;
-    }
-
-    // If the instance is already in the right place (outside the DUT or already
-    // in the root module), there's nothing left for us to do. Otherwise we
-    // proceed to bubble it up one level in the hierarchy and add the resulting
-    // instances back to the worklist.
-    if (!dutModules.contains(parent) ||
-        instanceGraph->lookup(parent)->noUses() ||
-        (info.stopAtDUT && dutRootModules.contains(parent))) {
-      LLVM_DEBUG(llvm::dbgs() << "\nNo need to further move " << inst << "\n");
-      extractedInstances.push_back({inst, info});
-      continue;
-    }
-    LLVM_DEBUG({
-      llvm::dbgs() << "\nMoving ";
-      if (!prefix.empty())
-        llvm::dbgs() << "`" << prefix << "` ";
-      llvm::dbgs() << inst << "\n";
-    });
-
-    // Add additional ports to the parent module as a replacement for the
-    // instance port signals once the instance is extracted.
-    unsigned numParentPorts = parent.getNumPorts();
-    unsigned numInstPorts = inst.getNumResults();
-
-    for (unsigned portIdx = 0; portIdx < numInstPorts; ++portIdx) {
-      // Assemble the new port name as "<prefix>_<name>", where the prefix is
-      // provided by the extraction annotation.
-      auto name = inst.getPortNameStr(portIdx);
-      auto nameAttr = StringAttr::get(
-          &getContext(),
-          prefix.empty() ? Twine(name) : Twine(prefix) + "_" + name);
-
-      PortInfo newPort{nameAttr,
-                       inst.getResult(portIdx).getType().cast<FIRRTLType>(),
-                       direction::flip(inst.getPortDirection(portIdx))};
-      newPort.loc = inst.getResult(portIdx).getLoc();
-      newPorts.push_back({numParentPorts, newPort});
-      LLVM_DEBUG(llvm::dbgs()
-                 << "- Adding port " << newPort.direction << " "
-                 << newPort.name.getValue() << ": " << newPort.type << "\n");
-    }
-    parent.insertPorts(newPorts);
-    anythingChanged = true;
-
-    // Replace all uses of the existing instance ports with the newly-created
-    // module ports.
-    for (unsigned portIdx = 0; portIdx < numInstPorts; ++portIdx) {
-      inst.getResult(portIdx).replaceAllUsesWith(
-          parent.getArgument(numParentPorts + portIdx));
-    }
-    assert(inst.use_empty() && "instance ports should have been detached");
-    DenseSet<HierPathOp> instanceNLAs;
-    // Get the NLAs that pass through the InstanceOp `inst`.
-    // This does not returns NLAs that have the `inst` as the leaf.
-    nlaTable.getInstanceNLAs(inst, instanceNLAs);
-    // Map of the NLAs, that are applied to the InstanceOp. That is the NLA
-    // terminates on the InstanceOp.
-    DenseMap<HierPathOp, SmallVector<Annotation>> instNonlocalAnnos;
-    AnnotationSet::removeAnnotations(inst, [&](Annotation anno) {
-      // Only consider annotations with a `circt.nonlocal` field.
-      auto nlaName = anno.getMember<FlatSymbolRefAttr>("circt.nonlocal");
-      if (!nlaName)
-        return false;
-      // Track the NLA.
-      if (HierPathOp nla = nlaTable.getNLA(nlaName.getAttr())) {
-        instNonlocalAnnos[nla].push_back(anno);
-        instanceNLAs.insert(nla);
+  for (unsigned level = 0, e = levels.getNumLevels(); level != e; ++level) {
+    auto nodes = levels.getLevel(level);
+
+    // Add the ports of each batch to its module, and replace all uses of the
+    // instance ports with the new module ports. This only touches the module
+    // itself, so all modules on a level are handled in parallel.
+    SmallVector<ExtractionBatch> batches(nodes.size());
+    mlir::parallelForEachN(&getContext(), 0, nodes.size(), [&](size_t i) {
+      auto &insts = pending[levels.getIndex(nodes[i])];
+      if (insts.empty())
+        return;
+      auto parent = cast<FModuleOp>(nodes[i]->getModule().getOperation());
+      auto &batch = batches[i];
+
+      // If the instance is already in the right place (outside the DUT or
+      // already in the root module), there's nothing left for us to do.
+      // Otherwise we proceed to bubble it up one level in the hierarchy.
+      for (auto &instAndInfo : insts) {
+        auto &info = instAndInfo.second;
+        if (!dutModules.contains(parent) || nodes[i]->noUses() ||
+            (info.stopAtDUT && dutRootModules.contains(parent)))
+          batch.done.push_back(instAndInfo);
+        else
+          batch.insts.push_back(instAndInfo);
       }
-      return true;
-    });
-
-    // Sort the instance NLAs we've collected by the NLA name to have a
-    // deterministic output.
-    SmallVector<HierPathOp> sortedInstanceNLAs(instanceNLAs.begin(),
-                                               instanceNLAs.end());
-    llvm::sort(sortedInstanceNLAs,
-               [](auto a, auto b) { return a.sym_name() < b.sym_name(); });
-
-    // Move the original instance one level up such that it is right next to
-    // the instances of the parent module, and wire the instance ports up to
-    // the newly added parent module ports.
-    auto *instParentNode =
-        instanceGraph->lookup(cast<hw::HWModuleLike>(*parent));
-    for (auto *instRecord : instParentNode->uses()) {
-      auto oldParentInst = cast<InstanceOp>(*instRecord->getInstance());
-      auto newParent = oldParentInst->getParentOfType<FModuleLike>();
-      LLVM_DEBUG(llvm::dbgs() << "- Updating " << oldParentInst << "\n");
-      auto newParentInst = oldParentInst.cloneAndInsertPorts(newPorts);
-
-      // Migrate connections to existing ports.
-      for (unsigned portIdx = 0; portIdx < numParentPorts; ++portIdx)
-        oldParentInst.getResult(portIdx).replaceAllUsesWith(
-            newParentInst.getResult(portIdx));
-
-      // Clone the existing instance and remove it from its current parent, such
-      // that we can insert it at its extracted location.
-      auto newInst = inst.cloneAndInsertPorts({});
-      newInst->remove();
-
-      // Ensure that the `inner_sym` of the instance is unique within the parent
-      // module we're extracting it to.
-      if (auto instSym = getInnerSymName(inst)) {
-        auto newName =
-            getModuleNamespace(newParent).newName(instSym.getValue());
-        if (newName != instSym.getValue())
-          newInst.inner_symAttr(
-              InnerSymAttr::get(StringAttr::get(&getContext(), newName)));
+      if (batch.insts.empty())
+        return;
+      llvm::sort(batch.insts, inExtractionOrder);
+
+      // Add additional ports to the parent module as a replacement for the
+      // instance port signals once the instances are extracted.
+      batch.numParentPorts = parent.getNumPorts();
+      for (auto &[inst, info] : batch.insts) {
+        batch.portOffsets.push_back(batch.newPorts.size());
+        StringRef prefix;
+        auto prefixIt = instPrefices.find(inst);
+        if (prefixIt != instPrefices.end())
+          prefix = prefixIt->second;
+        for (unsigned portIdx = 0, e = inst.getNumResults(); portIdx < e;
+             ++portIdx) {
+          // Assemble the new port name as "<prefix>_<name>", where the prefix
+          // is provided by the extraction annotation.
+          auto name = inst.getPortNameStr(portIdx);
+          auto nameAttr = StringAttr::get(
+              &getContext(),
+              prefix.empty() ? Twine(name) : Twine(prefix) + "_" + name);
+
+          auto type = inst.getResult(portIdx).getType().cast<FIRRTLType>();
+          PortInfo newPort{nameAttr, type,
+                           direction::flip(inst.getPortDirection(portIdx))};
+          newPort.loc = inst.getResult(portIdx).getLoc();
+          batch.newPorts.push_back({batch.numParentPorts, newPort});
+        }
       }
-
-      // Add the moved instance and hook it up to the added ports.
-      ImplicitLocOpBuilder builder(inst.getLoc(), newParentInst);
-      builder.setInsertionPointAfter(newParentInst);
-      builder.insert(newInst);
-      for (unsigned portIdx = 0; portIdx < numInstPorts; ++portIdx) {
-        auto dst = newInst.getResult(portIdx);
-        auto src = newParentInst.getResult(numParentPorts + portIdx);
-        if (newPorts[portIdx].second.direction == Direction::In)
-          std::swap(src, dst);
-        builder.create<StrictConnectOp>(dst, src);
+      parent.insertPorts(batch.newPorts);
+
+      // Replace all uses of the existing instance ports with the newly-created
+      // module ports.
+      for (unsigned instIdx = 0, e = batch.insts.size(); instIdx != e;
+           ++instIdx) {
+        auto inst = batch.insts[instIdx].first;
+        unsigned firstPort = batch.numParentPorts + batch.portOffsets[instIdx];
+        for (unsigned portIdx = 0, e = inst.getNumResults(); portIdx < e;
+             ++portIdx)
+          inst.getResult(portIdx).replaceAllUsesWith(
+              parent.getArgument(firstPort + portIdx));
+        assert(inst.use_empty() && "instance ports should have been detached");
       }
+    });
 
-      // Move the wiring prefix from the old to the new instance. We just look
-      // up the prefix for the old instance and if it exists, we remove it and
-      // assign it to the new instance. This has the effect of making the first
-      // new instance we create inherit the wiring prefix, and all additional
-      // new instances (e.g. through multiple instantiation of the parent) will
-      // pick a new prefix.
-      auto oldPrefix = instPrefices.find(inst);
-      if (oldPrefix != instPrefices.end()) {
-        LLVM_DEBUG(llvm::dbgs()
-                   << "  - Reusing prefix `" << oldPrefix->second << "`\n");
-        auto newPrefix = std::move(oldPrefix->second);
-        instPrefices.erase(oldPrefix);
-        instPrefices.insert({newInst, newPrefix});
+    // Move the batches into the instantiations of their modules. This updates
+    // the NLAs and the namespaces of the parent modules, so it is done
+    // serially.
+    for (unsigned nodeIdx = 0, e = nodes.size(); nodeIdx != e; ++nodeIdx) {
+      auto *instParentNode = nodes[nodeIdx];
+      auto &batch = batches[nodeIdx];
+      extractedInstances.append(batch.done.begin(), batch.done.end());
+      if (batch.insts.empty())
+        continue;
+      auto parent = cast<FModuleOp>(instParentNode->getModule().getOperation());
+      anythingChanged = true;
+      LLVM_DEBUG({
+        llvm::dbgs() << "\nMoving " << batch.insts.size()
+                     << " instances out of `" << parent.moduleName() << "`\n";
+        for (auto &[inst, info] : batch.insts)
+          llvm::dbgs() << "- " << inst << "\n";
+        for (auto &[portIdx, newPort] : batch.newPorts)
+          llvm::dbgs() << "- Added port " << newPort.direction << " "
+                       << newPort.name.getValue() << ": " << newPort.type
+                       << "\n";
+      });
+
+      // Collect the NLAs that touch each moved instance.
+      SmallVector<DenseSet<HierPathOp>> instanceNLAs(batch.insts.size());
+      SmallVector<DenseMap<HierPathOp, SmallVector<Annotation>>>
+          instNonlocalAnnos(batch.insts.size());
+      SmallVector<SmallVector<HierPathOp>> sortedInstanceNLAs(
+          batch.insts.size());
+      for (unsigned instIdx = 0, e = batch.insts.size(); instIdx != e;
+           ++instIdx) {
+        auto inst = batch.insts[instIdx].first;
+        // Get the NLAs that pass through the InstanceOp `inst`.
+        // This does not returns NLAs that have the `inst` as the leaf.
+        nlaTable.getInstanceNLAs(inst, instanceNLAs[instIdx]);
+        // Map of the NLAs, that are applied to the InstanceOp. That is the NLA
+        // terminates on the InstanceOp.
+        AnnotationSet::removeAnnotations(inst, [&](Annotation anno) {
+          // Only consider annotations with a `circt.nonlocal` field.
+          auto nlaName = anno.getMember<FlatSymbolRefAttr>("circt.nonlocal");
+          if (!nlaName)
+            return false;
+          // Track the NLA.
+          if (HierPathOp nla = nlaTable.getNLA(nlaName.getAttr())) {
+            instNonlocalAnnos[instIdx][nla].push_back(anno);
+            instanceNLAs[instIdx].insert(nla);
+          }
+          return true;
+        });
+
+        // Sort the instance NLAs we've collected by the NLA name to have a
+        // deterministic output.
+        sortedInstanceNLAs[instIdx].assign(instanceNLAs[instIdx].begin(),
+                                           instanceNLAs[instIdx].end());
+        llvm::sort(sortedInstanceNLAs[instIdx],
+                   [](auto a, auto b) { return a.sym_name() < b.sym_name(); });
       }
 
-      // Inherit the old instance's extraction path.
-      extractionPaths.try_emplace(newInst); // (create entry first)
-      auto &extractionPath = (extractionPaths[newInst] = extractionPaths[inst]);
-      extractionPath.push_back(getInnerRefTo(newParentInst));
-      originalInstanceParents.try_emplace(newInst); // (create entry first)
-      originalInstanceParents[newInst] = originalInstanceParents[inst];
-      // Record the Nonlocal annotations that need to be applied to the new
-      // Inst.
-      SmallVector<Annotation> newInstNonlocalAnnos;
-
-      // Update all NLAs that touch the moved instance.
-      for (auto nla : sortedInstanceNLAs) {
-        LLVM_DEBUG(llvm::dbgs() << "  - Updating " << nla << "\n");
-
-        // Find the position of the instance in the NLA path. This is going to
-        // be the position at which we have to modify the NLA.
-        SmallVector<Attribute> nlaPath(nla.namepath().begin(),
-                                       nla.namepath().end());
-        unsigned nlaIdx = findInstanceInNLA(inst, nla);
-
-        // Handle the case where the instance no longer shows up in the NLA's
-        // path. This usually happens if the instance is extracted into multiple
-        // parents (because the current parent module is multiply instantiated).
-        // In that case NLAs that were specific to one instance may have been
-        // moved when we arrive at the second instance, and the NLA is already
-        // updated.
-        if (nlaIdx >= nlaPath.size()) {
-          LLVM_DEBUG(llvm::dbgs() << "    - Instance no longer in path\n");
+      // Ensure that the `inner_sym` of each copy is unique within the parent
+      // module we're extracting it to. The names are picked one instance at a
+      // time, in extraction order, such that conflicts resolve the same way
+      // regardless of how the instances are batched.
+      SmallVector<SmallVector<StringAttr>> newInstSyms(batch.insts.size());
+      for (unsigned instIdx = 0, e = batch.insts.size(); instIdx != e;
+           ++instIdx) {
+        auto instSym = getInnerSymName(batch.insts[instIdx].first);
+        if (!instSym)
           continue;
+        for (auto *instRecord : instParentNode->uses()) {
+          auto newParent =
+              instRecord->getInstance()->getParentOfType<FModuleLike>();
+          newInstSyms[instIdx].push_back(StringAttr::get(
+              &getContext(),
+              getModuleNamespace(newParent).newName(instSym.getValue())));
         }
-        LLVM_DEBUG(llvm::dbgs() << "    - Position " << nlaIdx << "\n");
+      }
 
-        // Handle the case where the NLA's path doesn't go through the
-        // instance's new parent module, which happens if the current parent
-        // module is multiply instantiated. In that case, we only move over NLAs
-        // that actually affect the instance through the new parent module.
-        if (nlaIdx > 0) {
-          auto innerRef = nlaPath[nlaIdx - 1].dyn_cast<InnerRefAttr>();
-          if (innerRef &&
-              !(innerRef.getModule() == newParent.moduleNameAttr() &&
-                innerRef.getName() == getInnerSymName(newParentInst))) {
-            LLVM_DEBUG(llvm::dbgs()
-                       << "    - Ignored since NLA parent " << innerRef
-                       << " does not pass through extraction parent\n");
-            continue;
+      // Move the original instances one level up such that they are right next
+      // to the instances of the parent module, and wire the instance ports up
+      // to the newly added parent module ports.
+      unsigned copyIdx = 0;
+      for (auto *instRecord : instParentNode->uses()) {
+        auto oldParentInst = cast<InstanceOp>(*instRecord->getInstance());
+        auto newParent = oldParentInst->getParentOfType<FModuleLike>();
+        LLVM_DEBUG(llvm::dbgs() << "- Updating " << oldParentInst << "\n");
+        auto newParentInst = oldParentInst.cloneAndInsertPorts(batch.newPorts);
+
+        // Migrate connections to existing ports.
+        for (unsigned portIdx = 0; portIdx < batch.numParentPorts; ++portIdx)
+          oldParentInst.getResult(portIdx).replaceAllUsesWith(
+              newParentInst.getResult(portIdx));
+
+        for (unsigned instIdx = 0, e = batch.insts.size(); instIdx != e;
+             ++instIdx) {
+          auto [inst, info] = batch.insts[instIdx];
+          unsigned portOffset = batch.portOffsets[instIdx];
+          unsigned numInstPorts = inst.getNumResults();
+
+          // Clone the existing instance and remove it from its current parent,
+          // such that we can insert it at its extracted location.
+          auto newInst = inst.cloneAndInsertPorts({});
+          newInst->remove();
+
+          // Use the unique `inner_sym` picked for this copy.
+          if (!newInstSyms[instIdx].empty()) {
+            auto newName = newInstSyms[instIdx][copyIdx];
+            if (newName != getInnerSymName(inst))
+              newInst.inner_symAttr(InnerSymAttr::get(newName));
           }
-        }
 
-        // There are two interesting cases now:
-        // - If `nlaIdx == 0`, the NLA is rooted at the module the instance was
-        //   located in prior to extraction. This indicates that the NLA applies
-        //   to all instances of that parent module. Since we are extracting
-        //   *out* of that module, we have to create a new NLA rooted at the new
-        //   parent module after extraction.
-        // - If `nlaIdx > 0`, the NLA is rooted further up in the hierarchy and
-        //   we can simply remove the old parent module from the path.
-
-        // Handle the case where we need to come up with a new NLA for this
-        // instance since we've moved it past the module at which the old NLA
-        // was rooted at.
-        if (nlaIdx == 0) {
-          LLVM_DEBUG(llvm::dbgs() << "    - Re-rooting " << nlaPath[0] << "\n");
-          assert(nlaPath[0].isa<InnerRefAttr>() &&
-                 "head of hierpath must be an InnerRefAttr");
-          nlaPath[0] =
-              InnerRefAttr::get(newParent.moduleNameAttr(),
-                                nlaPath[0].cast<InnerRefAttr>().getName());
-
-          if (instParentNode->hasOneUse()) {
-            // Simply update the existing NLA since our parent is only
-            // instantiated once, and we therefore are not creating multiple
-            // instances through the extraction.
-            nlaTable.erase(nla);
-            nla.namepathAttr(builder.getArrayAttr(nlaPath));
-            for (auto anno : instNonlocalAnnos.lookup(nla))
-              newInstNonlocalAnnos.push_back(anno);
-            nlaTable.addNLA(nla);
-            LLVM_DEBUG(llvm::dbgs() << "    - Modified to " << nla << "\n");
-          } else {
-            // Since we are extracting to multiple parent locations, create a
-            // new NLA for each instantiation site.
-            auto newNla = cloneWithNewNameAndPath(nla, nlaPath);
-            for (auto anno : instNonlocalAnnos.lookup(nla)) {
-              anno.setMember("circt.nonlocal",
-                             FlatSymbolRefAttr::get(newNla.sym_nameAttr()));
-              newInstNonlocalAnnos.push_back(anno);
+          // Add the moved instance and hook it up to the added ports.
+          ImplicitLocOpBuilder builder(inst.getLoc(), newParentInst);
+          builder.setInsertionPointAfter(newParentInst);
+          builder.insert(newInst);
+          for (unsigned portIdx = 0; portIdx < numInstPorts; ++portIdx) {
+            auto dst = newInst.getResult(portIdx);
+            auto src = newParentInst.getResult(batch.numParentPorts +
+                                               portOffset + portIdx);
+            if (batch.newPorts[portOffset + portIdx].second.direction ==
+                Direction::In)
+              std::swap(src, dst);
+            builder.create<StrictConnectOp>(dst, src);
+          }
+
+          // Give the new instance its position in the extraction order and
+          // its wiring prefix. The first new instance we create inherits the
+          // wiring prefix of the old one, and all additional new instances
+          // (e.g. through multiple instantiation of the parent) have a new
+          // prefix.
+          assignStep(newInst,
+                     steps[extractionOrder.lookup(inst)].copies[copyIdx]);
+
+          // Inherit the old instance's extraction path.
+          extractionPaths.try_emplace(newInst); // (create entry first)
+          auto &extractionPath =
+              (extractionPaths[newInst] = extractionPaths[inst]);
+          extractionPath.push_back(getInnerRefTo(newParentInst));
+          originalInstanceParents.try_emplace(newInst); // (create entry first)
+          originalInstanceParents[newInst] = originalInstanceParents[inst];
+          // Record the Nonlocal annotations that need to be applied to the new
+          // Inst.
+          SmallVector<Annotation> newInstNonlocalAnnos;
+
+          // Update all NLAs that touch the moved instance.
+          for (auto nla : sortedInstanceNLAs[instIdx]) {
+            LLVM_DEBUG(llvm::dbgs() << "  - Updating " << nla << "\n");
+
+            // Find the position of the instance in the NLA path. This is going
+            // to be the position at which we have to modify the NLA.
+            SmallVector<Attribute> nlaPath(nla.namepath().begin(),
+                                           nla.namepath().end());
+            unsigned nlaIdx = findInstanceInNLA(nlaTable, inst, nla);
+
+            // Handle the case where the instance no longer shows up in the
+            // NLA's path. This usually happens if the instance is extracted
+            // into multiple parents (because the current parent module is
+            // multiply instantiated). In that case NLAs that were specific to
+            // one instance may have been moved when we arrive at the second
+            // instance, and the NLA is already updated.
+            if (nlaIdx >= nlaPath.size()) {
+              LLVM_DEBUG(llvm::dbgs() << "    - Instance no longer in path\n");
+              continue;
+            }
+            LLVM_DEBUG(llvm::dbgs() << "    - Position " << nlaIdx << "\n");
+
+            // Handle the case where the NLA's path doesn't go through the
+            // instance's new parent module, which happens if the current parent
+            // module is multiply instantiated. In that case, we only move over
+            // NLAs that actually affect the instance through the new parent
+            // module.
+            if (nlaIdx > 0) {
+              auto innerRef = nlaPath[nlaIdx - 1].dyn_cast<InnerRefAttr>();
+              if (innerRef &&
+                  !(innerRef.getModule() == newParent.moduleNameAttr() &&
+                    innerRef.getName() == getInnerSymName(newParentInst))) {
+                LLVM_DEBUG(llvm::dbgs()
+                           << "    - Ignored since NLA parent " << innerRef
+                           << " does not pass through extraction parent\n");
+                continue;
+              }
             }
 
-            nlaTable.addNLA(newNla);
-            LLVM_DEBUG(llvm::dbgs() << "    - Created " << newNla << "\n");
-            // CAVEAT(fschuiki): This results in annotations in the subhierarchy
-            // below `inst` with the old NLA symbol name, instead of those
-            // annotations duplicated for each of the newly-created NLAs. This
-            // shouldn't come up in our current use cases, but is a weakness of
-            // the current implementation. Instead, we should keep an NLA
-            // replication table that we fill with mappings from old NLA names
-            // to lists of new NLA names. A post-pass would then traverse the
-            // entire subhierarchy and go replicate all annotations with the old
-            // names.
-            inst.emitWarning("extraction of instance `")
-                << inst.instanceName()
-                << "` could break non-local annotations rooted at `"
-                << parent.moduleName() << "`";
-          }
-          continue;
-        }
+            // There are two interesting cases now:
+            // - If `nlaIdx == 0`, the NLA is rooted at the module the instance
+            //   was located in prior to extraction. This indicates that the NLA
+            //   applies to all instances of that parent module. Since we are
+            //   extracting *out* of that module, we have to create a new NLA
+            //   rooted at the new parent module after extraction.
+            // - If `nlaIdx > 0`, the NLA is rooted further up in the hierarchy
+            //   and we can simply remove the old parent module from the path.
+
+            // Handle the case where we need to come up with a new NLA for this
+            // instance since we've moved it past the module at which the old
+            // NLA was rooted at.
+            if (nlaIdx == 0) {
+              LLVM_DEBUG(llvm::dbgs()
+                         << "    - Re-rooting " << nlaPath[0] << "\n");
+              assert(nlaPath[0].isa<InnerRefAttr>() &&
+                     "head of hierpath must be an InnerRefAttr");
+              nlaPath[0] =
+                  InnerRefAttr::get(newParent.moduleNameAttr(),
+                                    nlaPath[0].cast<InnerRefAttr>().getName());
+
+              if (instParentNode->hasOneUse()) {
+                // Simply update the existing NLA since our parent is only
+                // instantiated once, and we therefore are not creating multiple
+                // instances through the extraction.
+                nlaTable.erase(nla);
+                nla.namepathAttr(builder.getArrayAttr(nlaPath));
+                for (auto anno : instNonlocalAnnos[instIdx].lookup(nla))
+                  newInstNonlocalAnnos.push_back(anno);
+                nlaTable.addNLA(nla);
+                LLVM_DEBUG(llvm::dbgs() << "    - Modified to " << nla << "\n");
+              } else {
+                // Since we are extracting to multiple parent locations, create
+                // a new NLA for each instantiation site.
+                auto newNla = cloneWithNewNameAndPath(nla, nlaPath);
+                for (auto anno : instNonlocalAnnos[instIdx].lookup(nla)) {
+                  anno.setMember("circt.nonlocal",
+                                 FlatSymbolRefAttr::get(newNla.sym_nameAttr()));
+                  newInstNonlocalAnnos.push_back(anno);
+                }
+
+                nlaTable.addNLA(newNla);
+                LLVM_DEBUG(llvm::dbgs() << "    - Created " << newNla << "\n");
+                // CAVEAT(fschuiki): This results in annotations in the
+                // subhierarchy below `inst` with the old NLA symbol name,
+                // instead of those annotations duplicated for each of the
+                // newly-created NLAs. This shouldn't come up in our current use
+                // cases, but is a weakness of the current implementation.
+                // Instead, we should keep an NLA replication table that we fill
+                // with mappings from old NLA names to lists of new NLA names. A
+                // post-pass would then traverse the entire subhierarchy and go
+                // replicate all annotations with the old names.
+                inst.emitWarning("extraction of instance `")
+                    << inst.instanceName()
+                    << "` could break non-local annotations rooted at `"
+                    << parent.moduleName() << "`";
+              }
+              continue;
+            }
 
-        // In the subequent code block we are going to remove one element from
-        // the NLA path, corresponding to the fact that the extracted instance
-        // has moved up in the hierarchy by one level. Removing that element may
-        // leave the NLA in a degenerate state, with only a single element in
-        // its path. If that is the case we have to convert the NLA into a
-        // regular local annotation.
-        if (nlaPath.size() == 2) {
-          for (auto anno : instNonlocalAnnos.lookup(nla)) {
-            anno.removeMember("circt.nonlocal");
-            newInstNonlocalAnnos.push_back(anno);
-            LLVM_DEBUG(llvm::dbgs() << "    - Converted to local "
-                                    << anno.getDict() << "\n");
-          }
-          nlaTable.erase(nla);
-          nlasToRemove.insert(nla);
-          continue;
-        }
+            // In the subequent code block we are going to remove one element
+            // from the NLA path, corresponding to the fact that the extracted
+            // instance has moved up in the hierarchy by one level. Removing
+            // that element may leave the NLA in a degenerate state, with only a
+            // single element in its path. If that is the case we have to
+            // convert the NLA into a regular local annotation.
+            if (nlaPath.size() == 2) {
+              for (auto anno : instNonlocalAnnos[instIdx].lookup(nla)) {
+                anno.removeMember("circt.nonlocal");
+                newInstNonlocalAnnos.push_back(anno);
+                LLVM_DEBUG(llvm::dbgs() << "    - Converted to local "
+                                        << anno.getDict() << "\n");
+              }
+              nlaTable.erase(nla);
+              nlasToRemove.insert(nla);
+              continue;
+            }
 
-        // At this point the NLA looks like `NewParent::X, OldParent::BB`, and
-        // the `nlaIdx` points at `OldParent::BB`. To make our lives easier,
-        // since we know that `nlaIdx` is a `InnerRefAttr`, we'll modify
-        // `OldParent::BB` to be `NewParent::BB` and delete `NewParent::X`.
-        StringAttr parentName =
-            nlaPath[nlaIdx - 1].cast<InnerRefAttr>().getModule();
-        Attribute newRef;
-        if (nlaPath[nlaIdx].isa<InnerRefAttr>())
-          newRef = InnerRefAttr::get(parentName, getInnerSymName(newInst));
-        else
-          newRef = FlatSymbolRefAttr::get(parentName);
-        LLVM_DEBUG(llvm::dbgs()
-                   << "    - Replacing " << nlaPath[nlaIdx - 1] << " and "
-                   << nlaPath[nlaIdx] << " with " << newRef << "\n");
-        nlaPath[nlaIdx] = newRef;
-        nlaPath.erase(nlaPath.begin() + nlaIdx - 1);
-
-        if (newRef.isa<FlatSymbolRefAttr>()) {
-          // Since the original NLA ended at the instance's parent module, there
-          // is no guarantee that the instance is the sole user of the NLA (as
-          // opposed to the original NLA explicitly naming the instance). Create
-          // a new NLA.
-          auto newNla = cloneWithNewNameAndPath(nla, nlaPath);
-          nlaTable.addNLA(newNla);
-          LLVM_DEBUG(llvm::dbgs() << "    - Created " << newNla << "\n");
-          for (auto anno : instNonlocalAnnos.lookup(nla)) {
-            anno.setMember("circt.nonlocal",
-                           FlatSymbolRefAttr::get(newNla.sym_nameAttr()));
-            newInstNonlocalAnnos.push_back(anno);
+            // At this point the NLA looks like `NewParent::X, OldParent::BB`,
+            // and the `nlaIdx` points at `OldParent::BB`. To make our lives
+            // easier, since we know that `nlaIdx` is a `InnerRefAttr`, we'll
+            // modify `OldParent::BB` to be `NewParent::BB` and delete
+            // `NewParent::X`.
+            StringAttr parentName =
+                nlaPath[nlaIdx - 1].cast<InnerRefAttr>().getModule();
+            Attribute newRef;
+            if (nlaPath[nlaIdx].isa<InnerRefAttr>())
+              newRef = InnerRefAttr::get(parentName, getInnerSymName(newInst));
+            else
+              newRef = FlatSymbolRefAttr::get(parentName);
+            LLVM_DEBUG(llvm::dbgs()
+                       << "    - Replacing " << nlaPath[nlaIdx - 1] << " and "
+                       << nlaPath[nlaIdx] << " with " << newRef << "\n");
+            nlaPath[nlaIdx] = newRef;
+            nlaPath.erase(nlaPath.begin() + nlaIdx - 1);
+
+            if (newRef.isa<FlatSymbolRefAttr>()) {
+              // Since the original NLA ended at the instance's parent module,
+              // there is no guarantee that the instance is the sole user of the
+              // NLA (as opposed to the original NLA explicitly naming the
+              // instance). Create a new NLA.
+              auto newNla = cloneWithNewNameAndPath(nla, nlaPath);
+              nlaTable.addNLA(newNla);
+              LLVM_DEBUG(llvm::dbgs() << "    - Created " << newNla << "\n");
+              for (auto anno : instNonlocalAnnos[instIdx].lookup(nla)) {
+                anno.setMember("circt.nonlocal",
+                               FlatSymbolRefAttr::get(newNla.sym_nameAttr()));
+                newInstNonlocalAnnos.push_back(anno);
+              }
+            } else {
+              // Re-add the NLA to keep the inner reference index of the
+              // NLATable in sync with the new path.
+              nlaTable.erase(nla);
+              nla.namepathAttr(builder.getArrayAttr(nlaPath));
+              nlaTable.addNLA(nla);
+              LLVM_DEBUG(llvm::dbgs() << "    - Modified to " << nla << "\n");
+              for (auto anno : instNonlocalAnnos[instIdx].lookup(nla))
+                newInstNonlocalAnnos.push_back(anno);
+            }
           }
-        } else {
-          nla.namepathAttr(builder.getArrayAttr(nlaPath));
-          LLVM_DEBUG(llvm::dbgs() << "    - Modified to " << nla << "\n");
-          for (auto anno : instNonlocalAnnos.lookup(nla))
-            newInstNonlocalAnnos.push_back(anno);
+          AnnotationSet newInstAnnos(newInst);
+          newInstAnnos.addAnnotations(newInstNonlocalAnnos);
+          newInstAnnos.applyToOperation(newInst);
+
+          // Add the moved instance to the batch of its new parent such that it
+          // gets bubbled up further if needed.
+          addPending(newInst, info);
+          LLVM_DEBUG(llvm::dbgs() << "  - Updated to " << newInst << "\n");
         }
 
-        // No update to NLATable required, since it will be deleted from the
-        // parent, and it should already exist in the new parent module.
-        continue;
+        // Keep instance graph up-to-date.
+        instanceGraph->replaceInstance(oldParentInst, newParentInst);
+        oldParentInst.erase();
+        ++copyIdx;
+      }
+
+      for (unsigned instIdx = 0, e = batch.insts.size(); instIdx != e;
+           ++instIdx) {
+        // Remove the obsolete NLAs from the instance of the parent module,
+        // since the extracted instance no longer resides in that module and any
+        // NLAs to it no longer go through the parent module.
+        nlaTable.removeNLAsfromModule(instanceNLAs[instIdx],
+                                      parent.getNameAttr());
+
+        // Clean up the original instance.
+        auto inst = batch.insts[instIdx].first;
+        extractionOrder.erase(inst);
+        instPrefices.erase(inst);
+        inst.erase();
       }
-      AnnotationSet newInstAnnos(newInst);
-      newInstAnnos.addAnnotations(newInstNonlocalAnnos);
-      newInstAnnos.applyToOperation(newInst);
-
-      // Add the moved instance to the extraction worklist such that it gets
-      // bubbled up further if needed.
-      extractionWorklist.push_back({newInst, info});
-      LLVM_DEBUG(llvm::dbgs() << "  - Updated to " << newInst << "\n");
-
-      // Keep instance graph up-to-date.
-      instanceGraph->replaceInstance(oldParentInst, newParentInst);
-      oldParentInst.erase();
     }
-    // Remove the obsolete NLAs from the instance of the parent module, since
-    // the extracted instance no longer resides in that module and any NLAs to
-    // it no longer go through the parent module.
-    nlaTable.removeNLAsfromModule(instanceNLAs, parent.getNameAttr());
-
-    // Clean up the original instance.
-    inst.erase();
-    newPorts.clear();
   }
 
+  // List the extracted instances in extraction order, which is the order the
+  // wrapper ports and trace file entries are generated in.
+  llvm::stable_sort(extractedInstances, inExtractionOrder);
+
   // Remove unused NLAs.
   for (Operation *op : nlasToRemove) {
     LLVM_DEBUG(llvm::dbgs() << "Removing obsolete " << *op << "\n");
@@ -898,7 +1097,7 @@ void ExtractInstancesPass::groupInstances() {
         // be the position at which we have to modify the NLA.
         SmallVector<Attribute> nlaPath(nla.namepath().begin(),
                                        nla.namepath().end());
-        unsigned nlaIdx = findInstanceInNLA(inst, nla);
+        unsigned nlaIdx = findInstanceInNLA(nlaTable, inst, nla);
         assert(nlaIdx < nlaPath.size() && "instance not found in its own NLA");
         LLVM_DEBUG(llvm::dbgs() << "    - Position " << nlaIdx << "\n");
 
@@ -918,10 +1117,11 @@ void ExtractInstancesPass::groupInstances() {
         // CAVEAT: This is likely to conflict with additional users of `nla`
         // that have nothing to do with this instance. Might need some NLATable
         // machinery at some point to allow for these things to be updated.
+        // Re-adding the NLA also adds it to the wrapper module.
+        nlaTable.erase(nla);
         nla.namepathAttr(builder.getArrayAttr(nlaPath));
+        nlaTable.addNLA(nla);
         LLVM_DEBUG(llvm::dbgs() << "    - Modified to " << nla << "\n");
-        // Add the NLA to the wrapper module.
-        nlaTable.addNLAtoModule(nla, wrapperNameAttr);
       }
     }
 
@@ -23,6 +23,7 @@
 #include "circt/Dialect/HW/HWOps.h"
 #include "circt/Dialect/SV/SVOps.h"
 #include "mlir/IR/ImplicitLocOpBuilder.h"
+#include "mlir/IR/Threading.h"
 #include "llvm/ADT/TypeSwitch.h"
 #include "llvm/Support/Debug.h"
 #include "llvm/Support/YAMLTraits.h"
@@ -561,6 +562,13 @@ private:
   /// associated with that ID.
   DenseMap<Attribute, FieldAndNLA> leafMap;
 
+  /// Mapping of view element to its AugmentedType.  This is populated in
+  /// parallel for all views before any interface is built.
+  DenseMap<Attribute, Attribute> augmentedTypes;
+
+  /// Mapping of ground type ID to the value driving its leaf, if any.
+  DenseMap<Attribute, Value> leafDrivers;
+
   /// Mapping of ID to parent instance and module.  If this module is the top
   /// module, then the first tuple member will be None.
   DenseMap<Attribute, std::pair<Optional<InstanceOp>, FModuleOp>> parentIDMap;
@@ -1080,17 +1088,26 @@ LogicalResult circt::firrtl::applyGCTView(const AnnoPathValue &target,
 // GrandCentralPass Implementation
 //===----------------------------------------------------------------------===//
 
-Optional<Attribute> GrandCentralPass::fromAttr(Attribute attr) {
+/// Build an AugmentedType from an attribute.  Return null if the attribute is
+/// not a dictionary or if it does not match any of the known templates for
+/// AugmentedTypes.  Errors are reported through `emitError` if it is provided.
+/// This does not modify any state, so it is safe to call from multiple threads.
+static Attribute
+getAugmentedType(MLIRContext *context, Attribute attr,
+                 const DenseMap<Attribute, FieldAndNLA> &leafMap,
+                 llvm::function_ref<InFlightDiagnostic()> emitError = {}) {
   auto dict = attr.dyn_cast<DictionaryAttr>();
   if (!dict) {
-    emitCircuitError() << "attribute is not a dictionary: " << attr << "\n";
-    return None;
+    if (emitError)
+      emitError() << "attribute is not a dictionary: " << attr << "\n";
+    return {};
   }
 
   auto clazz = dict.getAs<StringAttr>("class");
   if (!clazz) {
-    emitCircuitError() << "missing 'class' key in " << dict << "\n";
-    return None;
+    if (emitError)
+      emitError() << "missing 'class' key in " << dict << "\n";
+    return {};
   }
 
   auto classBase = clazz.getValue();
@@ -1098,52 +1115,94 @@ Optional<Attribute> GrandCentralPass::fromAttr(Attribute attr) {
 
   if (classBase == "BundleType") {
     if (dict.getAs<StringAttr>("defName") && dict.getAs<ArrayAttr>("elements"))
-      return AugmentedBundleTypeAttr::get(&getContext(), dict);
-    emitCircuitError() << "has an invalid AugmentedBundleType that does not "
-                          "contain 'defName' and 'elements' fields: "
-                       << dict;
+      return AugmentedBundleTypeAttr::get(context, dict);
+    if (emitError)
+      emitError() << "has an invalid AugmentedBundleType that does not "
+                     "contain 'defName' and 'elements' fields: "
+                  << dict;
   } else if (classBase == "VectorType") {
     if (dict.getAs<StringAttr>("name") && dict.getAs<ArrayAttr>("elements"))
-      return AugmentedVectorTypeAttr::get(&getContext(), dict);
-    emitCircuitError() << "has an invalid AugmentedVectorType that does not "
-                          "contain 'name' and 'elements' fields: "
-                       << dict;
+      return AugmentedVectorTypeAttr::get(context, dict);
+    if (emitError)
+      emitError() << "has an invalid AugmentedVectorType that does not "
+                     "contain 'name' and 'elements' fields: "
+                  << dict;
   } else if (classBase == "GroundType") {
     auto id = dict.getAs<IntegerAttr>("id");
     auto name = dict.getAs<StringAttr>("name");
     if (id && leafMap.count(id) && name)
-      return AugmentedGroundTypeAttr::get(&getContext(), dict);
+      return AugmentedGroundTypeAttr::get(context, dict);
+    if (!emitError)
+      return {};
     if (!id || !name)
-      emitCircuitError() << "has an invalid AugmentedGroundType that does not "
-                            "contain 'id' and 'name' fields:  "
-                         << dict;
+      emitError() << "has an invalid AugmentedGroundType that does not "
+                     "contain 'id' and 'name' fields:  "
+                  << dict;
     if (id && !leafMap.count(id))
-      emitCircuitError() << "has an AugmentedGroundType with 'id == "
-                         << id.getValue().getZExtValue()
-                         << "' that does not have a scattered leaf to connect "
-                            "to in the circuit "
-                            "(was the leaf deleted or constant prop'd away?)";
+      emitError() << "has an AugmentedGroundType with 'id == "
+                  << id.getValue().getZExtValue()
+                  << "' that does not have a scattered leaf to connect "
+                     "to in the circuit "
+                     "(was the leaf deleted or constant prop'd away?)";
   } else if (classBase == "StringType") {
     if (auto name = dict.getAs<StringAttr>("name"))
-      return AugmentedStringTypeAttr::get(&getContext(), dict);
+      return AugmentedStringTypeAttr::get(context, dict);
   } else if (classBase == "BooleanType") {
     if (auto name = dict.getAs<StringAttr>("name"))
-      return AugmentedBooleanTypeAttr::get(&getContext(), dict);
+      return AugmentedBooleanTypeAttr::get(context, dict);
   } else if (classBase == "IntegerType") {
     if (auto name = dict.getAs<StringAttr>("name"))
-      return AugmentedIntegerTypeAttr::get(&getContext(), dict);
+      return AugmentedIntegerTypeAttr::get(context, dict);
   } else if (classBase == "DoubleType") {
     if (auto name = dict.getAs<StringAttr>("name"))
-      return AugmentedDoubleTypeAttr::get(&getContext(), dict);
+      return AugmentedDoubleTypeAttr::get(context, dict);
   } else if (classBase == "LiteralType") {
     if (auto name = dict.getAs<StringAttr>("name"))
-      return AugmentedLiteralTypeAttr::get(&getContext(), dict);
+      return AugmentedLiteralTypeAttr::get(context, dict);
   } else if (classBase == "DeletedType") {
     if (auto name = dict.getAs<StringAttr>("name"))
-      return AugmentedDeletedTypeAttr::get(&getContext(), dict);
-  } else {
-    emitCircuitError() << "has an invalid AugmentedType";
+      return AugmentedDeletedTypeAttr::get(context, dict);
+  } else if (emitError) {
+    emitError() << "has an invalid AugmentedType";
+  }
+  return {};
+}
+
+/// Walk the element tree of a view and record the AugmentedType of every
+/// element, along with the driver of every ground type leaf.  Malformed
+/// elements are skipped here and diagnosed later by `fromAttr`.
+static void
+collectViewElements(MLIRContext *context, AugmentedBundleTypeAttr view,
+                    const DenseMap<Attribute, FieldAndNLA> &leafMap,
+                    SmallVectorImpl<std::pair<Attribute, Attribute>> &types,
+                    SmallVectorImpl<std::pair<Attribute, Value>> &drivers) {
+  SmallVector<ArrayAttr> worklist;
+  if (auto elements = view.getElements())
+    worklist.push_back(elements);
+  while (!worklist.empty()) {
+    for (auto element : worklist.pop_back_val()) {
+      auto type = getAugmentedType(context, element, leafMap);
+      if (!type)
+        continue;
+      types.emplace_back(element, type);
+      if (auto bundle = type.dyn_cast<AugmentedBundleTypeAttr>())
+        worklist.push_back(bundle.getElements());
+      else if (auto vector = type.dyn_cast<AugmentedVectorTypeAttr>())
+        worklist.push_back(vector.getElements());
+      else if (auto ground = type.dyn_cast<AugmentedGroundTypeAttr>()) {
+        auto leafValue = leafMap.lookup(ground.getID()).field.getValue();
+        drivers.emplace_back(ground.getID(), getDriverFromConnect(leafValue));
+      }
+    }
   }
+}
+
+Optional<Attribute> GrandCentralPass::fromAttr(Attribute attr) {
+  if (auto type = augmentedTypes.lookup(attr))
+    return type;
+  if (auto type = getAugmentedType(&getContext(), attr, leafMap,
+                                   [&]() { return emitCircuitError(); }))
+    return type;
   return None;
 }
 
@@ -1181,7 +1240,10 @@ bool GrandCentralPass::traverseField(Attribute field, IntegerAttr id,
         //   1. This is a constant that will be synced into the mappings file.
         //   2. This is something else and we need an XMR.
         // Handle case (1) here and exit.  Handle case (2) following.
-        auto driver = getDriverFromConnect(leafValue);
+        auto driverIt = leafDrivers.find(ground.getID());
+        auto driver = driverIt != leafDrivers.end()
+                          ? driverIt->second
+                          : getDriverFromConnect(leafValue);
         if (driver) {
           if (auto constant =
                   dyn_cast_or_null<ConstantOp>(driver.getDefiningOp())) {
@@ -2095,6 +2157,25 @@ void GrandCentralPass::runOnOperation() {
   // will use XMRs to drive the interface.  If extraction info is available,
   // then the top-level instantiate interface will be marked for extraction via
   // a SystemVerilog bind.
+  //
+  // The element trees of the views are parsed, and the drivers of their
+  // leaves found, in parallel first.  This only reads the IR.  The results are
+  // merged in view order.
+  SmallVector<SmallVector<std::pair<Attribute, Attribute>>> viewTypes(
+      worklist.size());
+  SmallVector<SmallVector<std::pair<Attribute, Value>>> viewDrivers(
+      worklist.size());
+  mlir::parallelForEachN(&getContext(), 0, worklist.size(), [&](size_t i) {
+    auto view =
+        AugmentedBundleTypeAttr::get(&getContext(), worklist[i].getDict());
+    collectViewElements(&getContext(), view, leafMap, viewTypes[i],
+                        viewDrivers[i]);
+  });
+  for (auto [types, drivers] : llvm::zip(viewTypes, viewDrivers)) {
+    augmentedTypes.insert(types.begin(), types.end());
+    leafDrivers.insert(drivers.begin(), drivers.end());
+  }
+
   SmallVector<sv::InterfaceOp, 2> interfaceVec;
   for (auto anno : worklist) {
     auto bundle = AugmentedBundleTypeAttr::get(&getContext(), anno.getDict());
@@ -2179,6 +2260,8 @@ void GrandCentralPass::runOnOperation() {
                       maybeExtractInfo.getValue().bindFilename.getValue(),
                       /*excludeFromFileList=*/true));
   }
+  augmentedTypes.clear();
+  leafDrivers.clear();
 
   // If a `GrandCentralHierarchyFileAnnotation` was passed in, generate a YAML
   // representation of the interfaces that we produced with the filename that
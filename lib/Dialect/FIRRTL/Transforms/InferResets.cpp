@@ -18,12 +18,15 @@
 #include "circt/Support/FieldRef.h"
 #include "mlir/IR/Dominance.h"
 #include "mlir/IR/ImplicitLocOpBuilder.h"
+#include "mlir/IR/Threading.h"
 #include "llvm/ADT/EquivalenceClasses.h"
 #include "llvm/ADT/SetVector.h"
 #include "llvm/ADT/TinyPtrVector.h"
 #include "llvm/ADT/TypeSwitch.h"
 #include "llvm/Support/Debug.h"
 
+#include <atomic>
+
 #define DEBUG_TYPE "infer-resets"
 
 using llvm::BumpPtrAllocator;
@@ -260,6 +263,10 @@ struct ResetDrive {
 /// A list of connections to a reset network.
 using ResetDrives = SmallVector<ResetDrive, 1>;
 
+/// An instance that was recreated with an additional reset port, and the
+/// instance that replaces it.
+using InstanceReplacement = std::pair<InstanceOp, InstanceOp>;
+
 /// All signals connected together into a reset network.
 using ResetNetwork = llvm::iterator_range<
     llvm::EquivalenceClasses<ResetSignal>::member_iterator>;
@@ -416,11 +423,14 @@ struct InferResetsPass : public InferResetsBase<InferResetsPass> {
   // Reset type inference
 
   void traceResets(CircuitOp circuit);
-  void traceResets(InstanceOp inst);
-  void traceResets(Value dst, Value src, Location loc);
-  void traceResets(Value value);
+  void traceResets(FModuleOp module, SmallVectorImpl<ResetDrive> &drives);
+  void traceResets(InstanceOp inst, SmallVectorImpl<ResetDrive> &drives);
+  void traceResets(Value dst, Value src, Location loc,
+                   SmallVectorImpl<ResetDrive> &drives);
   void traceResets(FIRRTLType dstType, Value dst, unsigned dstID,
-                   FIRRTLType srcType, Value src, unsigned srcID, Location loc);
+                   FIRRTLType srcType, Value src, unsigned srcID, Location loc,
+                   SmallVectorImpl<ResetDrive> &drives);
+  void addResetDrive(const ResetDrive &drive);
 
   LogicalResult inferAndUpdateResets();
   FailureOr<ResetKind> inferReset(ResetNetwork net);
@@ -442,8 +452,12 @@ struct InferResetsPass : public InferResetsBase<InferResetsPass> {
   void determineImpl(FModuleOp module, ResetDomain &domain);
 
   LogicalResult implementAsyncReset();
-  LogicalResult implementAsyncReset(FModuleOp module, ResetDomain &domain);
-  void implementAsyncReset(Operation *op, FModuleOp module, Value actualReset);
+  LogicalResult
+  implementAsyncReset(FModuleOp module, ResetDomain &domain,
+                      SmallVectorImpl<InstanceReplacement> &replacedInsts);
+  LogicalResult
+  implementAsyncReset(Operation *op, FModuleOp module, Value actualReset,
+                      SmallVectorImpl<InstanceReplacement> &replacedInsts);
 
   LogicalResult verifyNoAbstractReset();
 
@@ -723,15 +737,35 @@ static bool typeContainsReset(FIRRTLType type) {
 /// them into reset nets. After this function returns, the `resetMap` is
 /// populated with the reset networks in the circuit, alongside information on
 /// drivers and their types that contribute to the reset.
+///
+/// The modules are traced in parallel, each into its own list of drives. The
+/// drives are then merged into the reset networks in module order, such that
+/// the networks come out the same regardless of how the work was scheduled.
 void InferResetsPass::traceResets(CircuitOp circuit) {
   LLVM_DEBUG(
       llvm::dbgs() << "\n===----- Tracing uninferred resets -----===\n\n");
-  circuit.walk([&](Operation *op) {
+  SmallVector<FModuleOp> modules(circuit.getBody()->getOps<FModuleOp>());
+  SmallVector<SmallVector<ResetDrive>> moduleDrives(modules.size());
+  mlir::parallelForEachN(&getContext(), 0, modules.size(), [&](size_t i) {
+    traceResets(modules[i], moduleDrives[i]);
+  });
+  for (auto &drives : moduleDrives)
+    for (auto &drive : drives)
+      addResetDrive(drive);
+}
+
+/// Collect the drives involving a `ResetType` within a single module. This
+/// only modifies the IR of the module itself and may run concurrently for
+/// different modules.
+void InferResetsPass::traceResets(FModuleOp module,
+                                  SmallVectorImpl<ResetDrive> &drives) {
+  module.walk([&](Operation *op) {
     TypeSwitch<Operation *>(op)
-        .Case<ConnectOp, StrictConnectOp>(
-            [&](auto op) { traceResets(op.dest(), op.src(), op.getLoc()); })
+        .Case<ConnectOp, StrictConnectOp>([&](auto op) {
+          traceResets(op.dest(), op.src(), op.getLoc(), drives);
+        })
 
-        .Case<InstanceOp>([&](auto op) { traceResets(op); })
+        .Case<InstanceOp>([&](auto op) { traceResets(op, drives); })
 
         .Case<InvalidValueOp>([&](auto op) {
           // Uniquify `InvalidValueOp`s that are contributing to multiple reset
@@ -744,7 +778,6 @@ void InferResetsPass::traceResets(CircuitOp circuit) {
           auto type = op.getType();
           if (!typeContainsReset(type) || op->hasOneUse() || op->use_empty())
             return;
-          LLVM_DEBUG(llvm::dbgs() << "Uniquify " << op << "\n");
           ImplicitLocOpBuilder builder(op->getLoc(), op);
           for (auto &use :
                llvm::make_early_inc_range(llvm::drop_begin(op->getUses()))) {
@@ -762,7 +795,7 @@ void InferResetsPass::traceResets(CircuitOp circuit) {
           auto index = op.fieldIndex();
           traceResets(op.getType(), op.getResult(), 0,
                       bundleType.getElements()[index].type, op.input(),
-                      getFieldID(bundleType, index), op.getLoc());
+                      getFieldID(bundleType, index), op.getLoc(), drives);
         })
 
         .Case<SubindexOp, SubaccessOp>([&](auto op) {
@@ -780,19 +813,19 @@ void InferResetsPass::traceResets(CircuitOp circuit) {
           auto vectorType = op.input().getType().template cast<FVectorType>();
           traceResets(op.getType(), op.getResult(), 0,
                       vectorType.getElementType(), op.input(),
-                      getFieldID(vectorType), op.getLoc());
+                      getFieldID(vectorType), op.getLoc(), drives);
         });
   });
 }
 
 /// Trace reset signals through an instance. This essentially associates the
 /// instance's port values with the target module's port values.
-void InferResetsPass::traceResets(InstanceOp inst) {
+void InferResetsPass::traceResets(InstanceOp inst,
+                                  SmallVectorImpl<ResetDrive> &drives) {
   // Lookup the referenced module. Nothing to do if its an extmodule.
   auto module = dyn_cast<FModuleOp>(*instanceGraph->getReferencedModule(inst));
   if (!module)
     return;
-  LLVM_DEBUG(llvm::dbgs() << "Visiting instance " << inst.name() << "\n");
 
   // Establish a connection between the instance ports and module ports.
   auto dirs = module.getPortDirections();
@@ -802,24 +835,26 @@ void InferResetsPass::traceResets(InstanceOp inst) {
     Value srcPort = it.value();
     if (dir == Direction::Out)
       std::swap(dstPort, srcPort);
-    traceResets(dstPort, srcPort, it.value().getLoc());
+    traceResets(dstPort, srcPort, it.value().getLoc(), drives);
   }
 }
 
 /// Analyze a connect of one (possibly aggregate) value to another.
 /// Each drive involving a `ResetType` is recorded.
-void InferResetsPass::traceResets(Value dst, Value src, Location loc) {
+void InferResetsPass::traceResets(Value dst, Value src, Location loc,
+                                  SmallVectorImpl<ResetDrive> &drives) {
   // Analyze the actual connection.
   auto dstType = dst.getType().cast<FIRRTLType>();
   auto srcType = src.getType().cast<FIRRTLType>();
-  traceResets(dstType, dst, 0, srcType, src, 0, loc);
+  traceResets(dstType, dst, 0, srcType, src, 0, loc, drives);
 }
 
 /// Analyze a connect of one (possibly aggregate) value to another.
 /// Each drive involving a `ResetType` is recorded.
 void InferResetsPass::traceResets(FIRRTLType dstType, Value dst, unsigned dstID,
                                   FIRRTLType srcType, Value src, unsigned srcID,
-                                  Location loc) {
+                                  Location loc,
+                                  SmallVectorImpl<ResetDrive> &drives) {
   if (auto dstBundle = dstType.dyn_cast<BundleType>()) {
     auto srcBundle = srcType.cast<BundleType>();
     for (unsigned dstIdx = 0, e = dstBundle.getNumElements(); dstIdx < e;
@@ -833,11 +868,11 @@ void InferResetsPass::traceResets(FIRRTLType dstType, Value dst, unsigned dstID,
       if (dstElt.isFlip) {
         traceResets(srcElt.type, src, srcID + getFieldID(srcBundle, *srcIdx),
                     dstElt.type, dst, dstID + getFieldID(dstBundle, dstIdx),
-                    loc);
+                    loc, drives);
       } else {
         traceResets(dstElt.type, dst, dstID + getFieldID(dstBundle, dstIdx),
                     srcElt.type, src, srcID + getFieldID(srcBundle, *srcIdx),
-                    loc);
+                    loc, drives);
       }
     }
     return;
@@ -860,54 +895,58 @@ void InferResetsPass::traceResets(FIRRTLType dstType, Value dst, unsigned dstID,
     // the field ID and make sure in `updateType` that we handle vectors
     // accordingly.
     traceResets(dstElType, dst, dstID + getFieldID(dstVector), srcElType, src,
-                srcID + getFieldID(srcVector), loc);
+                srcID + getFieldID(srcVector), loc, drives);
     return;
   }
 
   if (dstType.isGround()) {
-    if (dstType.isa<ResetType>() || srcType.isa<ResetType>()) {
-      FieldRef dstField(dst, dstID);
-      FieldRef srcField(src, srcID);
-      LLVM_DEBUG(llvm::dbgs()
-                 << "Visiting driver '" << dstField << "' = '" << srcField
-                 << "' (" << dstType << " = " << srcType << ")\n");
-
-      // Determine the leaders for the dst and src reset networks before we make
-      // the connection. This will allow us to later detect if dst got merged
-      // into src, or src into dst.
-      ResetSignal dstLeader =
-          *resetClasses.findLeader(resetClasses.insert({dstField, dstType}));
-      ResetSignal srcLeader =
-          *resetClasses.findLeader(resetClasses.insert({srcField, srcType}));
-
-      // Unify the two reset networks.
-      ResetSignal unionLeader = *resetClasses.unionSets(dstLeader, srcLeader);
-      assert(unionLeader == dstLeader || unionLeader == srcLeader);
-
-      // If dst got merged into src, append dst's drives to src's, or vice
-      // versa. Also, remove dst's or src's entry in resetDrives, because they
-      // will never come up as a leader again.
-      if (dstLeader != srcLeader) {
-        auto &unionDrives = resetDrives[unionLeader]; // needed before finds
-        auto mergedDrivesIt =
-            resetDrives.find(unionLeader == dstLeader ? srcLeader : dstLeader);
-        if (mergedDrivesIt != resetDrives.end()) {
-          unionDrives.append(mergedDrivesIt->second);
-          resetDrives.erase(mergedDrivesIt);
-        }
-      }
-
-      // Keep note of this drive so we can point the user at the right location
-      // in case something goes wrong.
-      resetDrives[unionLeader].push_back(
-          {{dstField, dstType}, {srcField, srcType}, loc});
-    }
+    if (dstType.isa<ResetType>() || srcType.isa<ResetType>())
+      drives.push_back({{FieldRef(dst, dstID), dstType},
+                        {FieldRef(src, srcID), srcType},
+                        loc});
     return;
   }
 
   llvm_unreachable("unknown type");
 }
 
+/// Add a drive collected by `traceResets` to the reset networks, merging the
+/// networks of its source and destination.
+void InferResetsPass::addResetDrive(const ResetDrive &drive) {
+  LLVM_DEBUG(llvm::dbgs() << "Visiting driver '" << drive.dst.field << "' = '"
+                          << drive.src.field << "' (" << drive.dst.type
+                          << " = " << drive.src.type << ")\n");
+
+  // Determine the leaders for the dst and src reset networks before we make
+  // the connection. This will allow us to later detect if dst got merged
+  // into src, or src into dst.
+  ResetSignal dstLeader =
+      *resetClasses.findLeader(resetClasses.insert(drive.dst));
+  ResetSignal srcLeader =
+      *resetClasses.findLeader(resetClasses.insert(drive.src));
+
+  // Unify the two reset networks.
+  ResetSignal unionLeader = *resetClasses.unionSets(dstLeader, srcLeader);
+  assert(unionLeader == dstLeader || unionLeader == srcLeader);
+
+  // If dst got merged into src, append dst's drives to src's, or vice
+  // versa. Also, remove dst's or src's entry in resetDrives, because they
+  // will never come up as a leader again.
+  if (dstLeader != srcLeader) {
+    auto &unionDrives = resetDrives[unionLeader]; // needed before finds
+    auto mergedDrivesIt =
+        resetDrives.find(unionLeader == dstLeader ? srcLeader : dstLeader);
+    if (mergedDrivesIt != resetDrives.end()) {
+      unionDrives.append(mergedDrivesIt->second);
+      resetDrives.erase(mergedDrivesIt);
+    }
+  }
+
+  // Keep note of this drive so we can point the user at the right location
+  // in case something goes wrong.
+  resetDrives[unionLeader].push_back(drive);
+}
+
 //===----------------------------------------------------------------------===//
 // Reset Inference
 //===----------------------------------------------------------------------===//
@@ -1496,14 +1535,33 @@ void InferResetsPass::determineImpl(FModuleOp module, ResetDomain &domain) {
 // Async Reset Implementation
 //===----------------------------------------------------------------------===//
 
-/// Implement the async resets gathered in the pass' `domains` map.
+/// Implement the async resets gathered in the pass' `domains` map. Each module
+/// only modifies its own body and the instances therein, so the modules are
+/// processed in parallel. Every module is processed even if another one
+/// fails, and the diagnostics are emitted in module order. Instances that had
+/// to be recreated with an extra reset port are updated in the instance graph
+/// afterwards, since the graph is shared between modules.
 LogicalResult InferResetsPass::implementAsyncReset() {
   LLVM_DEBUG(llvm::dbgs() << "\n===----- Implement async resets -----===\n\n");
-  for (auto &it : domains)
+  SmallVector<SmallVector<InstanceReplacement>> replacedInsts(domains.size());
+  std::atomic<bool> anyFailed = false;
+  mlir::ParallelDiagnosticHandler diagHandler(&getContext());
+  mlir::parallelForEachN(&getContext(), 0, domains.size(), [&](size_t i) {
+    auto &it = domains.begin()[i];
+    diagHandler.setOrderIDForThread(i);
     if (failed(implementAsyncReset(cast<FModuleOp>(it.first),
-                                   it.second.back().first)))
-      return failure();
-  return success();
+                                   it.second.back().first, replacedInsts[i])))
+      anyFailed = true;
+    diagHandler.eraseOrderIDForThread();
+  });
+
+  for (auto &moduleInsts : replacedInsts) {
+    for (auto [oldInst, newInst] : moduleInsts) {
+      instanceGraph->replaceInstance(oldInst, newInst);
+      oldInst->erase();
+    }
+  }
+  return failure(anyFailed);
 }
 
 /// Implement the async resets for a specific module.
@@ -1511,8 +1569,9 @@ LogicalResult InferResetsPass::implementAsyncReset() {
 /// This will add ports to the module as appropriate, update the register ops in
 /// the module, and update any instantiated submodules with their corresponding
 /// reset implementation details.
-LogicalResult InferResetsPass::implementAsyncReset(FModuleOp module,
-                                                   ResetDomain &domain) {
+LogicalResult InferResetsPass::implementAsyncReset(
+    FModuleOp module, ResetDomain &domain,
+    SmallVectorImpl<InstanceReplacement> &replacedInsts) {
   LLVM_DEBUG(llvm::dbgs() << "Implementing async reset for " << module.getName()
                           << "\n");
 
@@ -1620,16 +1679,22 @@ LogicalResult InferResetsPass::implementAsyncReset(FModuleOp module,
     }
   }
 
-  // Update the operations.
+  // Update the operations. Keep going after a failure, such that all
+  // registers with an invalid reset are reported.
+  bool anyFailed = false;
   for (auto *op : opsToUpdate)
-    implementAsyncReset(op, module, actualReset);
+    if (failed(implementAsyncReset(op, module, actualReset, replacedInsts)))
+      anyFailed = true;
 
-  return success();
+  return failure(anyFailed);
 }
 
 /// Modify an operation in a module to implement an async reset for that module.
-void InferResetsPass::implementAsyncReset(Operation *op, FModuleOp module,
-                                          Value actualReset) {
+/// Instances which are replaced by a new instance with an additional reset port
+/// are recorded in `replacedInsts` and left for the caller to erase.
+LogicalResult InferResetsPass::implementAsyncReset(
+    Operation *op, FModuleOp module, Value actualReset,
+    SmallVectorImpl<InstanceReplacement> &replacedInsts) {
   ImplicitLocOpBuilder builder(op->getLoc(), op);
 
   // Handle instances.
@@ -1640,13 +1705,13 @@ void InferResetsPass::implementAsyncReset(Operation *op, FModuleOp module,
     auto refModule =
         dyn_cast<FModuleOp>(*instanceGraph->getReferencedModule(instOp));
     if (!refModule)
-      return;
+      return success();
     auto domainIt = domains.find(refModule);
     if (domainIt == domains.end())
-      return;
+      return success();
     auto &domain = domainIt->second.back().first;
     if (!domain.reset)
-      return;
+      return success();
     LLVM_DEBUG(llvm::dbgs() << "- Update instance '" << instOp.name() << "'\n");
 
     // If needed, add a reset port to the instance.
@@ -1660,10 +1725,10 @@ void InferResetsPass::implementAsyncReset(Operation *op, FModuleOp module,
              Direction::In}}});
       instReset = newInstOp.getResult(0);
 
-      // Update the uses over to the new instance and drop the old instance.
+      // Update the uses over to the new instance. The old instance is dropped
+      // once all modules are done.
       instOp.replaceAllUsesWith(newInstOp.getResults().drop_front());
-      instanceGraph->replaceInstance(instOp, newInstOp);
-      instOp->erase();
+      replacedInsts.push_back({instOp, newInstOp});
       instOp = newInstOp;
     } else if (domain.existingPort.hasValue()) {
       auto idx = domain.existingPort.getValue();
@@ -1675,20 +1740,20 @@ void InferResetsPass::implementAsyncReset(Operation *op, FModuleOp module,
     // happen if the instantiated module has a reset domain, but that domain is
     // e.g. rooted at an internal wire.
     if (!instReset)
-      return;
+      return success();
 
     // Connect the instance's reset to the actual reset.
     assert(instReset && actualReset);
     builder.setInsertionPointAfter(instOp);
     builder.create<StrictConnectOp>(instReset, actualReset);
-    return;
+    return success();
   }
 
   // Handle reset-less registers.
   if (auto regOp = dyn_cast<RegOp>(op)) {
     if (AnnotationSet::removeAnnotations(
             regOp, "sifive.enterprise.firrtl.ExcludeMemFromMemToRegOfVec"))
-      return;
+      return success();
 
     LLVM_DEBUG(llvm::dbgs() << "- Adding async reset to " << regOp << "\n");
     auto zero = createZeroValue(builder, regOp.getType());
@@ -1697,7 +1762,7 @@ void InferResetsPass::implementAsyncReset(Operation *op, FModuleOp module,
         regOp.nameKindAttr(), regOp.annotations(), regOp.inner_symAttr());
     regOp.getResult().replaceAllUsesWith(newRegOp);
     regOp->erase();
-    return;
+    return success();
   }
 
   // Handle registers with reset.
@@ -1708,9 +1773,7 @@ void InferResetsPass::implementAsyncReset(Operation *op, FModuleOp module,
                  << "- Skipping (has async reset) " << regOp << "\n");
       // The following performs the logic of `CheckResets` in the original Scala
       // source code.
-      if (failed(regOp.verifyInvariants()))
-        signalPassFailure();
-      return;
+      return regOp.verifyInvariants();
     }
     LLVM_DEBUG(llvm::dbgs() << "- Updating reset of " << regOp << "\n");
 
@@ -1731,6 +1794,8 @@ void InferResetsPass::implementAsyncReset(Operation *op, FModuleOp module,
     regOp.resetSignalMutable().assign(actualReset);
     regOp.resetValueMutable().assign(zero);
   }
+
+  return success();
 }
 
 LogicalResult InferResetsPass::verifyNoAbstractReset() {
@@ -70,6 +70,7 @@ struct LowerCHIRRTLPass : public LowerCHIRRTLPassBase<LowerCHIRRTLPass>,
     constCache.clear();
     invalidCache.clear();
     opsToDelete.clear();
+    subfieldIndices.clear();
     subfieldDirs.clear();
     rdataValues.clear();
     wdataValues.clear();
@@ -77,7 +78,16 @@ struct LowerCHIRRTLPass : public LowerCHIRRTLPassBase<LowerCHIRRTLPass>,
 
   void emitInvalid(ImplicitLocOpBuilder &builder, Value value);
 
-  MemDirAttr inferMemoryPortKind(MemoryPortOp memPort);
+  void inferMemoryPortKinds(Block *body);
+
+  /// Get the inferred direction of a memory port, or of a subfield-like
+  /// operation which indexes one. Returns None for any other operation.
+  Optional<MemDirAttr> getSubfieldDir(Operation *op) {
+    auto it = subfieldIndices.find(op);
+    if (it == subfieldIndices.end())
+      return None;
+    return subfieldDirs[it->second];
+  }
 
   void replaceMem(Operation *op, StringRef name, bool isSequential, RUWAttr ruw,
                   ArrayAttr annotations);
@@ -94,10 +104,15 @@ struct LowerCHIRRTLPass : public LowerCHIRRTLPassBase<LowerCHIRRTLPass>,
   /// List of operations to delete at the end of the pass.
   SmallVector<Operation *> opsToDelete;
 
+  /// The MemoryPortOps and the subfield operations which (transitively) index
+  /// them, numbered in the order they appear in the module.
+  DenseMap<Operation *, unsigned> subfieldIndices;
+
   /// This tracks how the result of a subfield operation which is indexes a
-  /// MemoryPortOp is used.  This is used to track if the subfield operation
-  /// needs to be cloned to access a memories rdata or wdata.
-  DenseMap<Operation *, MemDirAttr> subfieldDirs;
+  /// MemoryPortOp is used, indexed by the number of the operation.  This is
+  /// used to track if the subfield operation needs to be cloned to access a
+  /// memories rdata or wdata.
+  SmallVector<MemDirAttr> subfieldDirs;
 
   /// This maps a subfield-like operation from a MemoryPortOp to a new subfield
   /// operation which can be used to read from the MemoryOp. This is used to
@@ -172,98 +187,86 @@ static MemOp::PortKind memDirAttrToPortKind(MemDirAttr direction) {
   }
 }
 
-/// This function infers the memory direction of each CHIRRTL memory port. Each
-/// memory port has an initial memory direction which is explicitly declared in
-/// the MemoryPortOp, which is used as a starting point.  For example, if the
-/// port is declared to be Write, but it is only ever read from, the port will
-/// become a ReadWrite port.
+/// This function infers the memory direction of each CHIRRTL memory port in a
+/// module. Each memory port has an initial memory direction which is
+/// explicitly declared in the MemoryPortOp, which is used as a starting point.
+/// For example, if the port is declared to be Write, but it is only ever read
+/// from, the port will become a ReadWrite port.
 ///
 /// When the memory port is eventually replaced with a memory, we will go from
 /// having a single data value to having separate rdata and wdata values.  In
 /// this function we record how the result of each data subfield operation is
 /// used, so that later on we can make sure the SubfieldOp is cloned to index
 /// into the correct rdata and wdata fields of the memory.
-MemDirAttr LowerCHIRRTLPass::inferMemoryPortKind(MemoryPortOp memPort) {
-  // This function does a depth-first walk of the use-lists of the memport
-  // operation to look through subindex operations and find the places where it
-  // is ultimately used.  At each node we record how the children ops are using
-  // the result of the current operation.  When we are done visiting the current
-  // operation we store how it is used into a global hashtable for later use.
-  // This records how both the MemoryPort and Subfield operations are used.
-  struct StackElement {
-    StackElement(Value value, Value::use_iterator iterator, MemDirAttr mode)
-        : value(value), iterator(iterator), mode(mode) {}
-    Value value;
-    Value::use_iterator iterator;
-    MemDirAttr mode;
-  };
-
-  SmallVector<StackElement> stack;
-  stack.emplace_back(memPort.data(), memPort.data().use_begin(),
-                     memPort.direction());
-  MemDirAttr mode = MemDirAttr::Infer;
-
-  while (!stack.empty()) {
-    auto *iter = &stack.back().iterator;
-    auto end = stack.back().value.use_end();
-    stack.back().mode |= mode;
-
-    while (*iter != end) {
-      auto &element = stack.back();
-      auto &use = *(*iter);
+void LowerCHIRRTLPass::inferMemoryPortKinds(Block *body) {
+  // Number every memory port and every subindex-like operation which
+  // (transitively) indexes one, and remember the number of the operation each
+  // subindex-like operation indexes. Definitions dominate their uses, so a
+  // single walk numbers the input of each subindex-like operation before the
+  // operation itself.
+  const unsigned noInput = -1;
+  SmallVector<Operation *> ops;
+  SmallVector<unsigned> inputIndices;
+  body->walk([&](Operation *op) {
+    unsigned inputIndex = noInput;
+    MemDirAttr direction = MemDirAttr::Infer;
+    if (auto memPort = dyn_cast<MemoryPortOp>(op)) {
+      direction = memPort.direction();
+    } else {
+      if (!isa<SubindexOp, SubfieldOp, SubaccessOp>(op))
+        return;
+      auto *inputOp = op->getOperand(0).getDefiningOp();
+      if (!inputOp)
+        return;
+      auto it = subfieldIndices.find(inputOp);
+      if (it == subfieldIndices.end())
+        return;
+      inputIndex = it->second;
+    }
+    subfieldIndices.insert({op, ops.size()});
+    ops.push_back(op);
+    inputIndices.push_back(inputIndex);
+    subfieldDirs.push_back(direction);
+  });
+
+  // Visit the numbered operations bottom-up. Every subindex-like user of an
+  // operation was numbered after it, and has already added its direction to
+  // the operation by the time we get to it. Each use is only looked at once,
+  // regardless of how deep the chains are.
+  for (unsigned index = ops.size(); index-- != 0;) {
+    auto mode = subfieldDirs[index];
+    for (auto &use : ops[index]->getResult(0).getUses()) {
       auto *user = use.getOwner();
-      ++(*iter);
-      if (isa<SubindexOp, SubfieldOp>(user)) {
-        // We recurse into Subindex ops to find the leaf-uses.
-        auto output = user->getResult(0);
-        stack.emplace_back(output, output.use_begin(), MemDirAttr::Infer);
-        mode = MemDirAttr::Infer;
-        iter = &stack.back().iterator;
-        end = output.use_end();
+      if (isa<SubindexOp, SubfieldOp>(user) ||
+          (isa<SubaccessOp>(user) && use.getOperandNumber() == 0)) {
+        // We look through subindex ops to find the leaf-uses, which have
+        // already been added to this operation. If we are using the memory
+        // port as the index of a subaccess, we fall through and treat it as a
+        // read.
         continue;
       }
-      if (auto subaccessOp = dyn_cast<SubaccessOp>(user)) {
-        // Subaccess has two arguments, the vector and the index. If we are
-        // using the memory port as an index, we can ignore it. If we are using
-        // the memory as the vector, we need to recurse.
-        auto input = subaccessOp.input();
-        if (use.get() == input) {
-          auto output = subaccessOp.getResult();
-          stack.emplace_back(output, output.use_begin(), MemDirAttr::Infer);
-          mode = MemDirAttr::Infer;
-          iter = &stack.back().iterator;
-          end = output.use_end();
-          continue;
-        }
-        // Otherwise we are reading from a memory for the index.
-        element.mode |= MemDirAttr::Read;
-      } else if (auto connectOp = dyn_cast<ConnectOp>(user)) {
-        if (use.get() == connectOp.dest()) {
-          element.mode |= MemDirAttr::Write;
-        } else {
-          element.mode |= MemDirAttr::Read;
-        }
+      if (auto connectOp = dyn_cast<ConnectOp>(user)) {
+        if (use.get() == connectOp.dest())
+          mode |= MemDirAttr::Write;
+        else
+          mode |= MemDirAttr::Read;
       } else if (auto connectOp = dyn_cast<StrictConnectOp>(user)) {
-        if (use.get() == connectOp.dest()) {
-          element.mode |= MemDirAttr::Write;
-        } else {
-          element.mode |= MemDirAttr::Read;
-        }
+        if (use.get() == connectOp.dest())
+          mode |= MemDirAttr::Write;
+        else
+          mode |= MemDirAttr::Read;
       } else {
         // Every other use of a memory is a read operation.
-        element.mode |= MemDirAttr::Read;
+        mode |= MemDirAttr::Read;
       }
     }
-    mode = stack.back().mode;
-
-    // Store the direction of the current operation in the global map. This will
-    // be used later to determine if this subaccess operation needs to be cloned
-    // into rdata, wdata, and wmask.
-    subfieldDirs[stack.back().value.getDefiningOp()] = mode;
-    stack.pop_back();
+    // Store the direction of the current operation. This will be used later to
+    // determine if this subaccess operation needs to be cloned into rdata,
+    // wdata, and wmask. The operation it indexes is used the same way.
+    subfieldDirs[index] = mode;
+    if (inputIndices[index] != noInput)
+      subfieldDirs[inputIndices[index]] |= mode;
   }
-
-  return mode;
 }
 
 void LowerCHIRRTLPass::replaceMem(Operation *cmem, StringRef name,
@@ -291,8 +294,8 @@ void LowerCHIRRTLPass::replaceMem(Operation *cmem, StringRef name,
   for (auto *user : cmem->getUsers()) {
     auto cmemoryPort = cast<MemoryPortOp>(user);
 
-    // Infer the type of memory port we need to create.
-    auto portDirection = inferMemoryPortKind(cmemoryPort);
+    // The type of memory port we need to create was inferred up front.
+    auto portDirection = *getSubfieldDir(cmemoryPort);
 
     // If the memory port is never used, it will have the Infer type and should
     // just be deleted. TODO: this is mirroring SFC, but should we be checking
@@ -546,8 +549,8 @@ void LowerCHIRRTLPass::cloneSubindexOpForMemory(OpType op, Value input,
                                                 T... operands) {
   // If the subaccess operation has no direction recorded, then it does not
   // index a CHIRRTL memory and will be left alone.
-  auto it = subfieldDirs.find(op);
-  if (it == subfieldDirs.end())
+  auto subfieldDir = getSubfieldDir(op);
+  if (!subfieldDir)
     return;
 
   // All uses of this op will be updated to use the appropriate clone.  If the
@@ -556,7 +559,7 @@ void LowerCHIRRTLPass::cloneSubindexOpForMemory(OpType op, Value input,
   // removed.
   opsToDelete.push_back(op);
 
-  auto direction = it->second;
+  auto direction = *subfieldDir;
   ImplicitLocOpBuilder builder(op->getLoc(), op);
 
   // If the subaccess operation is used to read from a memory port, we need to
@@ -608,6 +611,9 @@ void LowerCHIRRTLPass::visitUnhandledOp(Operation *op) {
 }
 
 void LowerCHIRRTLPass::runOnOperation() {
+  // Infer the kind of every memory port in the module in one go.
+  inferMemoryPortKinds(getOperation().getBody());
+
   // Walk the entire body of the module and dispatch the visitor on each
   // function.  This will replace all CHIRRTL memories and ports, and update all
   // uses.
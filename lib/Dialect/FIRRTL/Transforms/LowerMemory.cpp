@@ -18,6 +18,7 @@
 #include "circt/Dialect/FIRRTL/Passes.h"
 #include "circt/Dialect/HW/HWAttributes.h"
 #include "mlir/IR/Dominance.h"
+#include "mlir/IR/Threading.h"
 #include "llvm/ADT/DepthFirstIterator.h"
 #include "llvm/ADT/STLExtras.h"
 #include "llvm/ADT/STLFunctionalExtras.h"
@@ -83,6 +84,14 @@ FirMemory getSummary(MemOp op) {
 }
 
 namespace {
+/// A memory which will be lowered, along with its summary and, once it is
+/// created, the wrapper module which replaces it.
+struct MemoryToLower {
+  MemOp mem;
+  FirMemory summary;
+  FModuleOp wrapper;
+};
+
 struct LowerMemoryPass : public LowerMemoryBase<LowerMemoryPass> {
 
   /// Get the cached namespace for a module.
@@ -100,8 +109,8 @@ struct LowerMemoryPass : public LowerMemoryBase<LowerMemoryPass> {
                                 bool shouldDedup);
   InstanceOp emitMemoryInstance(MemOp op, FModuleOp module,
                                 const FirMemory &summary);
-  void lowerMemory(MemOp mem, const FirMemory &summary, bool shouldDedup);
-  LogicalResult runOnModule(FModuleOp module, bool shouldDedup);
+  LogicalResult collectMemories(FModuleOp module,
+                                SmallVectorImpl<MemoryToLower> &memories);
   void runOnOperation() override;
 
   /// Cached module namespaces.
@@ -206,8 +215,13 @@ LowerMemoryPass::getOrCreateMemModule(MemOp op, const FirMemory &summary,
   return module;
 }
 
-void LowerMemoryPass::lowerMemory(MemOp mem, const FirMemory &summary,
-                                  bool shouldDedup) {
+/// Create the wrapper module for a memory, which instantiates the (possibly
+/// deduplicated) memory module. This only touches the circuit and the new
+/// modules, not the module containing `mem`, except to give `mem` a symbol if
+/// a non-local annotation needs one.
+FModuleOp LowerMemoryPass::createWrapperModule(MemOp mem,
+                                               const FirMemory &summary,
+                                               bool shouldDedup) {
   auto *context = &getContext();
   auto ports = getMemoryModulePorts(summary);
 
@@ -237,10 +251,6 @@ void LowerMemoryPass::lowerMemory(MemOp mem, const FirMemory &summary,
       b.create<StrictConnectOp>(mem->getLoc(), src, dst);
   }
 
-  // Create an instance of the wrapper memory module, which will replace the
-  // original mem op.
-  auto inst = emitMemoryInstance(mem, wrapper, summary);
-
   // We fixup the annotations here. We will be copying all annotations on to the
   // module op, so we have to fix up the NLA to have the module as the leaf
   // element.
@@ -269,9 +279,11 @@ void LowerMemoryPass::lowerMemory(MemOp mem, const FirMemory &summary,
       auto nla = dyn_cast<HierPathOp>(symbolTable->lookup(nlaSym.getAttr()));
       auto namepath = nla.namepath().getValue();
       SmallVector<Attribute> newNamepath(namepath.begin(), namepath.end());
+      // The instance of the wrapper which replaces the memory inherits its
+      // symbol.
       if (!nla.isComponent())
         newNamepath.back() =
-            getInnerRefTo(inst, "", [&](FModuleOp mod) -> ModuleNamespace & {
+            getInnerRefTo(mem, "", [&](FModuleOp mod) -> ModuleNamespace & {
               return getModuleNamespace(mod);
             });
       newNamepath.push_back(leafAttr);
@@ -296,7 +308,7 @@ void LowerMemoryPass::lowerMemory(MemOp mem, const FirMemory &summary,
     newAnnos.addAnnotations(newMemModAnnos);
     newAnnos.applyToOperation(memInst);
   }
-  mem->erase();
+  return wrapper;
 }
 
 static SmallVector<SubfieldOp> getAllFieldAccesses(Value structValue,
@@ -474,9 +486,12 @@ InstanceOp LowerMemoryPass::emitMemoryInstance(MemOp op, FModuleOp module,
   return inst;
 }
 
-LogicalResult LowerMemoryPass::runOnModule(FModuleOp module, bool shouldDedup) {
-  for (auto op :
-       llvm::make_early_inc_range(module.getBody()->getOps<MemOp>())) {
+/// Summarize all the memories in a module which should be lowered. Only reads
+/// the module, so this is safe to run on many modules in parallel.
+LogicalResult
+LowerMemoryPass::collectMemories(FModuleOp module,
+                                 SmallVectorImpl<MemoryToLower> &memories) {
+  for (auto op : module.getBody()->getOps<MemOp>()) {
     // Check that the memory has been properly lowered already.
     if (!op.getDataType().isa<UIntType>())
       return op->emitError(
@@ -494,7 +509,7 @@ LogicalResult LowerMemoryPass::runOnModule(FModuleOp module, bool shouldDedup) {
           (summary.numReadPorts <= 1) && summary.dataWidth > 0))
       continue;
 
-    lowerMemory(op, summary, shouldDedup);
+    memories.push_back({op, summary, {}});
   }
   return success();
 }
@@ -521,18 +536,40 @@ void LowerMemoryPass::runOnOperation() {
     dutModuleSet.insert(node->getModule());
   });
 
-  // We iterate the circuit from top-to-bottom to make sure that we get
-  // consistent memory names.
-  for (auto module : body->getOps<FModuleOp>()) {
+  // Summarize the memories of every module in parallel.
+  SmallVector<FModuleOp> modules(body->getOps<FModuleOp>());
+  SmallVector<SmallVector<MemoryToLower>> memoriesPerModule(modules.size());
+  auto result = mlir::failableParallelForEachN(
+      &getContext(), 0, modules.size(), [&](size_t i) {
+        return collectMemories(modules[i], memoriesPerModule[i]);
+      });
+  if (failed(result))
+    return signalPassFailure();
+
+  // Create the memory and wrapper modules. This dedups memories and picks
+  // names, so we iterate the circuit from top-to-bottom to make sure that we
+  // get consistent memory names.
+  for (auto [module, moduleMemories] : llvm::zip(modules, memoriesPerModule)) {
     // We don't dedup memories in the testharness with any other memories.
     auto shouldDedup = dutModuleSet.contains(module);
-    if (failed(runOnModule(module, shouldDedup)))
-      return signalPassFailure();
+    for (auto &memory : moduleMemories)
+      memory.wrapper =
+          createWrapperModule(memory.mem, memory.summary, shouldDedup);
   }
 
+  // Replace each memory with an instance of its wrapper. This only changes the
+  // module containing the memory, so do the modules in parallel.
+  mlir::parallelForEachN(&getContext(), 0, modules.size(), [&](size_t i) {
+    for (auto &memory : memoriesPerModule[i]) {
+      emitMemoryInstance(memory.mem, memory.wrapper, memory.summary);
+      memory.mem->erase();
+    }
+  });
+
   circuitNamespace.clear();
   symbolTable = nullptr;
   memories.clear();
+  moduleNamespaces.clear();
 }
 
 std::unique_ptr<mlir::Pass> circt::firrtl::createLowerMemoryPass() {
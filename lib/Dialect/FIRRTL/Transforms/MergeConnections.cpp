@@ -61,10 +61,19 @@ struct MergeConnection {
   // Return true if the given connect op is merged.
   bool peelConnect(StrictConnectOp connect);
 
-  // A map from a destination FieldRef to a pair of (i) the number of
-  // connections seen so far and (ii) the vector to store subconnections.
-  DenseMap<FieldRef, std::pair<unsigned, SmallVector<StrictConnectOp>>>
-      connections;
+  // A map from a destination FieldRef to an index into `subConnectionList`.
+  DenseMap<FieldRef, unsigned> connections;
+
+  // A list of pairs of (i) the number of connections seen so far and (ii) the
+  // vector to store subconnections, one for each destination in
+  // `connections`. These are kept out of the map so that growing it only moves
+  // integers around.
+  SmallVector<std::pair<unsigned, SmallVector<StrictConnectOp>>>
+      subConnectionList;
+
+  // The number of connections visited and merged, for statistics.
+  size_t numConnections = 0;
+  size_t numMergedConnections = 0;
 
   FModuleOp moduleOp;
   ImplicitLocOpBuilder *builder = nullptr;
@@ -79,6 +88,13 @@ bool MergeConnection::peelConnect(StrictConnectOp connect) {
   // partial connect. Also ignore non-passive connections or non-integer
   // connections.
   LLVM_DEBUG(llvm::dbgs() << "Visiting " << connect << "\n");
+  ++numConnections;
+
+  // Fast path: connections to ports and declarations, which are the vast
+  // majority after LowerTypes, are never merged.
+  if (!isa_and_nonnull<SubfieldOp, SubindexOp>(connect.dest().getDefiningOp()))
+    return false;
+
   auto destTy = connect.dest().getType().cast<FIRRTLType>();
   if (!destTy.isPassive() || !firrtl::getBitWidth(destTy).hasValue())
     return false;
@@ -100,7 +116,11 @@ bool MergeConnection::peelConnect(StrictConnectOp connect) {
   else
     llvm_unreachable("unexpected destination");
 
-  auto &countAndSubConnections = connections[getFieldRefFromValue(parent)];
+  auto [it, inserted] = connections.try_emplace(getFieldRefFromValue(parent),
+                                                subConnectionList.size());
+  if (inserted)
+    subConnectionList.emplace_back();
+  auto &countAndSubConnections = subConnectionList[it->second];
   auto &count = countAndSubConnections.first;
   auto &subConnections = countAndSubConnections.second;
 
@@ -239,6 +259,7 @@ bool MergeConnection::peelConnect(StrictConnectOp connect) {
     return false;
 
   builder->create<StrictConnectOp>(connect.getLoc(), parent, merged);
+  numMergedConnections += subConnections.size();
   return true;
 }
 
@@ -290,6 +311,8 @@ void MergeConnectionsPass::runOnOperation() {
 
   MergeConnection mergeConnection(getOperation(), enableAggressiveMerging);
   bool changed = mergeConnection.run();
+  numConnections += mergeConnection.numConnections;
+  numMergedConnections += mergeConnection.numMergedConnections;
 
   if (!changed)
     return markAllAnalysesPreserved();
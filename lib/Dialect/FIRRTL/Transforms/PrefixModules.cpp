@@ -19,6 +19,7 @@
 #include "circt/Dialect/FIRRTL/Passes.h"
 #include "circt/Dialect/HW/HWAttributes.h"
 #include "circt/Support/LLVM.h"
+#include "mlir/IR/Threading.h"
 #include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/PostOrderIterator.h"
 #include "llvm/ADT/StringMap.h"
@@ -53,6 +54,16 @@ struct PrefixInfo {
 };
 } // end anonymous namespace
 
+/// Returns true if instances of this module should be prefixed.  External
+/// modules are skipped unless they are Grand Central data or memory taps.
+static bool shouldPrefixInstancesOf(FModuleLike target) {
+  auto extModule = dyn_cast<FExtModuleOp>(target.getOperation());
+  if (!extModule)
+    return true;
+  return AnnotationSet(extModule).hasAnnotation(dataTapsBlackboxClass) ||
+         AnnotationSet::forPort(extModule, 0).hasAnnotation(memTapPortClass);
+}
+
 /// Get the PrefixInfo for a module from a NestedPrefixModulesAnnotation on a
 /// module. If the module is not annotated, the prefix returned will be empty.
 static PrefixInfo getPrefixInfo(Operation *module) {
@@ -92,6 +103,8 @@ static StringRef getPrefix(Operation *module) {
 namespace {
 class PrefixModulesPass : public PrefixModulesBase<PrefixModulesPass> {
   void removeDeadAnnotations(StringAttr moduleName, Operation *op);
+  void collectPrefixes(ArrayRef<InstanceGraphNode *> modules);
+  void cloneModules();
   void renameModuleBody(std::string prefix, FModuleOp module);
   void renameModule(FModuleOp module);
   void renameExtModule(FExtModuleOp extModule);
@@ -107,6 +120,10 @@ class PrefixModulesPass : public PrefixModulesBase<PrefixModulesPass> {
   /// This is a map from a module name to new prefixes to be applied.
   PrefixMap prefixMap;
 
+  /// Detached copies of each module which needs more than one prefix, one for
+  /// every prefix but the first.
+  DenseMap<Operation *, SmallVector<FModuleOp>> moduleClones;
+
   /// Map prefix to group ID.
   /// Store strings in the map, they may not stay alive.
   llvm::StringMap<uint32_t> prefixIdMap;
@@ -160,8 +177,64 @@ void PrefixModulesPass::removeDeadAnnotations(StringAttr moduleName,
       op, std::bind(canRemoveAnno, std::placeholders::_1, op));
 }
 
-/// Applies the prefix to the module.  This will update the required prefixes of
-/// any referenced module in the prefix map.
+/// Compute the full list of prefixes required by every module before anything
+/// is renamed.  `modules` must be in top-down order so that all prefixes of a
+/// module are known before they are propagated to its children.  The prefixes
+/// of each child are recorded in the same order that `renameModule` visits the
+/// clones of its parent, which determines the order the clones are created in.
+void PrefixModulesPass::collectPrefixes(ArrayRef<InstanceGraphNode *> modules) {
+  for (auto *node : modules) {
+    auto module = dyn_cast<FModuleOp>(*node->getModule());
+    if (!module)
+      continue;
+
+    // If there are no required prefixes of this module, then this module is a
+    // top-level module, and there is an implicit requirement that it has an
+    // empty prefix.
+    auto &prefixes = prefixMap[module.getName()];
+    if (prefixes.empty())
+      prefixes.push_back("");
+
+    // Clones are renamed before the original module, so their children see
+    // their prefixes first.
+    SmallVector<std::string> outerPrefixes(llvm::drop_begin(prefixes));
+    outerPrefixes.push_back(prefixes.front());
+
+    auto innerPrefix = getPrefixInfo(module).prefix;
+    for (auto *record : *node) {
+      auto target = cast<FModuleLike>(*record->getTarget()->getModule());
+      if (!shouldPrefixInstancesOf(target))
+        continue;
+      for (auto &outerPrefix : outerPrefixes)
+        recordPrefix(prefixMap, target.moduleName(),
+                     (outerPrefix + innerPrefix).str());
+    }
+  }
+}
+
+/// Create all the module clones required by the prefix map.  The modules are
+/// not modified until every clone has been made, so they can be copied in
+/// parallel.  The clones are inserted into the circuit by `renameModule`.
+void PrefixModulesPass::cloneModules() {
+  SmallVector<std::pair<FModuleOp, size_t>> worklist;
+  for (auto module : getOperation().getBody()->getOps<FModuleOp>()) {
+    auto it = prefixMap.find(module.getName());
+    if (it != prefixMap.end() && it->second.size() > 1)
+      worklist.emplace_back(module, it->second.size() - 1);
+  }
+
+  SmallVector<SmallVector<FModuleOp>> clones(worklist.size());
+  mlir::parallelForEachN(&getContext(), 0, worklist.size(), [&](size_t i) {
+    auto [module, numClones] = worklist[i];
+    for (size_t j = 0; j < numClones; ++j)
+      clones[i].push_back(cast<FModuleOp>(module->clone()));
+  });
+
+  for (auto [entry, cloned] : llvm::zip(worklist, clones))
+    moduleClones[entry.first] = std::move(cloned);
+}
+
+/// Applies the prefix to the module.
 void PrefixModulesPass::renameModuleBody(std::string prefix, FModuleOp module) {
   auto *context = module.getContext();
   uint32_t groupID = 0;
@@ -197,21 +270,10 @@ void PrefixModulesPass::renameModuleBody(std::string prefix, FModuleOp module) {
       auto target = dyn_cast<FModuleLike>(
           *instanceGraph->getReferencedModule(instanceOp));
 
-      // Skip all external modules, unless one of the following conditions
-      // is true:
-      //   - This is a Grand Central Data Tap
-      //   - This is a Grand Central Mem Tap
-      if (auto *extModule = dyn_cast_or_null<FExtModuleOp>(&target)) {
-        auto isDataTap =
-            AnnotationSet(*extModule).hasAnnotation(dataTapsBlackboxClass);
-        auto isMemTap = AnnotationSet::forPort(*extModule, 0)
-                            .hasAnnotation(memTapPortClass);
-        if (!isDataTap && !isMemTap)
-          return;
-      }
-
-      // Record that we must prefix the target module with the current prefix.
-      recordPrefix(prefixMap, target.moduleName(), prefix);
+      // The prefixes required by the target module were already recorded by
+      // collectPrefixes.
+      if (!shouldPrefixInstancesOf(target))
+        return;
 
       // Fixup this instance op to use the prefixed module name.  Note that the
       // referenced FModuleOp will be renamed later.
@@ -240,8 +302,7 @@ void PrefixModulesPass::renameModuleBody(std::string prefix, FModuleOp module) {
   });
 }
 
-/// Apply all required renames to the current module.  This will update the
-/// prefix map for any referenced module.
+/// Apply all required renames to the current module.
 void PrefixModulesPass::renameModule(FModuleOp module) {
   // If the module is annotated to have a prefix, it will be applied after the
   // parent's prefix.
@@ -256,15 +317,8 @@ void PrefixModulesPass::renameModule(FModuleOp module) {
   if (prefixInfo.inclusive)
     moduleName = (innerPrefix + moduleName).str();
 
+  // There is always at least 1 prefix, see collectPrefixes.
   auto &prefixes = prefixMap[module.getName()];
-
-  // If there are no required prefixes of this module, then this module is a
-  // top-level module, and there is an implicit requirement that it has an empty
-  // prefix. This empty prefix will be applied to to all modules instantiated by
-  // this module.
-  if (prefixes.empty())
-    prefixes.push_back("");
-
   auto &firstPrefix = prefixes.front();
 
   auto fixNLAsRootedAt = [&](StringAttr oldModName, StringAttr newModuleName) {
@@ -274,13 +328,17 @@ void PrefixModulesPass::renameModule(FModuleOp module) {
       if (n.root() == oldModName)
         nlaTable->updateModuleInNLA(n, oldModName, newModuleName);
   };
-  // Rename the module for each required prefix. This will clone the module
-  // once for each prefix but the first.
+  // Rename the module for each required prefix. The module was cloned once for
+  // each prefix but the first by cloneModules.
   OpBuilder builder(module);
   builder.setInsertionPointAfter(module);
   auto oldModName = module.getNameAttr();
-  for (auto &outerPrefix : llvm::drop_begin(prefixes)) {
-    auto moduleClone = cast<FModuleOp>(builder.clone(*module));
+  auto clones = moduleClones.lookup(module);
+  for (auto [outerPrefix, moduleClone] :
+       llvm::zip(llvm::drop_begin(prefixes), clones)) {
+    builder.insert(moduleClone);
+    AnnotationSet::removeAnnotations(moduleClone, prefixModulesAnnoClass);
+    ++numModulesCloned;
     auto newModuleName = (outerPrefix + moduleName);
     auto newModNameAttr = StringAttr::get(module.getContext(), newModuleName);
     moduleClone.setName(newModuleName);
@@ -288,7 +346,6 @@ void PrefixModulesPass::renameModule(FModuleOp module) {
     // rename operation would fail.
     nlaTable->addModule(moduleClone);
     fixNLAsRootedAt(oldModName, newModNameAttr);
-    // Each call to this function could invalidate the `prefixes` reference.
     renameModuleBody((outerPrefix + innerPrefix).str(), moduleClone);
   }
 
@@ -368,6 +425,7 @@ void PrefixModulesPass::renameExtModule(FExtModuleOp extModule) {
   for (auto &prefix : llvm::drop_begin(prefixes)) {
     auto duplicate = cast<FExtModuleOp>(builder.clone(*extModule));
     applyPrefixToNameAndDefName(duplicate, prefix);
+    ++numModulesCloned;
   }
 
   // Update the original module with a new prefix.
@@ -390,6 +448,7 @@ void PrefixModulesPass::renameMemModule(FMemModuleOp memModule) {
     auto duplicate = cast<FMemModuleOp>(builder.clone(*memModule));
     duplicate.setName((prefix + originalName).str());
     removeDeadAnnotations(duplicate.getNameAttr(), duplicate);
+    ++numModulesCloned;
   }
 
   // Update the original module with a new prefix.
@@ -462,24 +521,33 @@ void PrefixModulesPass::runOnOperation() {
         nlaTable->updateModuleInNLA(n, oldModName, newMainModuleName);
   }
 
-  // Walk all Modules in a top-down order.  For each module, look at the list of
-  // required prefixes to be applied.
+  // Sort all modules in a top-down order.
+  SmallVector<InstanceGraphNode *> modules;
   DenseSet<InstanceGraphNode *> visited;
-  for (auto *current : *instanceGraph) {
-    for (auto &node : llvm::inverse_post_order_ext(current, visited)) {
-      if (auto module = dyn_cast<FModuleOp>(*node->getModule()))
-        renameModule(module);
-      if (auto extModule = dyn_cast<FExtModuleOp>(*node->getModule()))
-        renameExtModule(extModule);
-      if (auto memModule = dyn_cast<FMemModuleOp>(*node->getModule()))
-        renameMemModule(memModule);
-    }
+  for (auto *current : *instanceGraph)
+    for (auto &node : llvm::inverse_post_order_ext(current, visited))
+      modules.push_back(node);
+
+  // Figure out every distinct prefix of each module up front, so that modules
+  // are cloned exactly once per prefix.
+  collectPrefixes(modules);
+  cloneModules();
+
+  // For each module, apply the list of required prefixes.
+  for (auto *node : modules) {
+    if (auto module = dyn_cast<FModuleOp>(*node->getModule()))
+      renameModule(module);
+    if (auto extModule = dyn_cast<FExtModuleOp>(*node->getModule()))
+      renameExtModule(extModule);
+    if (auto memModule = dyn_cast<FMemModuleOp>(*node->getModule()))
+      renameMemModule(memModule);
   }
 
   // Update any interface definitions if needed.
   prefixGrandCentralInterfaces();
 
   prefixMap.clear();
+  moduleClones.clear();
   prefixIdMap.clear();
   interfacePrefixMap.clear();
   if (!anythingChanged)
@@ -13,6 +13,7 @@
 #include "circt/Dialect/FIRRTL/Passes.h"
 #include "mlir/IR/ImplicitLocOpBuilder.h"
 #include "llvm/ADT/APSInt.h"
+#include "llvm/ADT/BitVector.h"
 #include "llvm/ADT/PostOrderIterator.h"
 #include "llvm/Support/Debug.h"
 
@@ -59,6 +60,15 @@ void RemoveUnusedPortsPass::removeUnusedModulePorts(
   // value.
   SmallVector<llvm::Optional<APSInt>> outputPortConstants;
   auto ports = module.getPorts();
+  numPorts += ports.size();
+
+  // Mark every port which is used by at least one instance of this module, so
+  // that each instance result is only checked once.
+  llvm::BitVector usedByInstances(ports.size());
+  for (auto *use : instanceGraphNode->uses())
+    for (auto result : use->getInstance()->getResults())
+      if (!result.use_empty())
+        usedByInstances.set(result.getResultNumber());
 
   for (const auto &e : llvm::enumerate(ports)) {
     unsigned index = e.index();
@@ -79,18 +89,13 @@ void RemoveUnusedPortsPass::removeUnusedModulePorts(
     if (port.isInput() && !arg.use_empty())
       continue;
 
-    auto portIsUnused = [&](InstanceRecord *a) -> bool {
-      auto port = a->getInstance()->getResult(arg.getArgNumber());
-      return port.getUses().empty();
-    };
-
     // Output port.
     if (port.isOutput()) {
       if (arg.use_empty()) {
         // Sometimes the connection is already removed possibly by IMCP.
         // In that case, regard the port value as an invalid value.
         outputPortConstants.push_back(None);
-      } else if (llvm::all_of(instanceGraphNode->uses(), portIsUnused)) {
+      } else if (!usedByInstances.test(index)) {
         // Replace the port with a wire if it is unused.
         auto builder =
             ImplicitLocOpBuilder::atBlockBegin(arg.getLoc(), module.getBody());
@@ -675,8 +675,43 @@ static Attribute simplifyStrConcat(SmallVector<Attribute, 4> &operands) {
   return {};
 }
 
+/// Return the memoized parameter expressions of a context on this thread.
+static detail::ParamExprCache::ThreadCache &
+getParamExprCache(MLIRContext *context) {
+  return context->getLoadedDialect<HWDialect>()
+      ->getParamExprCache()
+      .threadCaches.get();
+}
+
+Attribute detail::ParamExprCache::ThreadCache::lookup(const Key &key) {
+  if (auto result = current.canonical.lookup(key))
+    return result;
+  auto result = previous.canonical.lookup(key);
+  if (result)
+    insert(key, result);
+  return result;
+}
+
+void detail::ParamExprCache::ThreadCache::insert(const Key &key,
+                                                 Attribute result) {
+  // Expressions built while canonicalizing this one may have added it.
+  if (current.canonical.count(key))
+    return;
+  if (current.canonical.size() >= maxEntries) {
+    std::swap(current, previous);
+    current.canonical.clear();
+    current.allocator.Reset();
+  }
+  current.canonical.try_emplace({key.first, key.second.copy(current.allocator)},
+                                result);
+}
+
 /// Build a parameter expression.  This automatically canonicalizes and
 /// folds, so it may not necessarily return a ParamExprAttr.
+///
+/// Recently built expressions are not canonicalized again.  Since
+/// operands are built through this function as well, expressions are
+/// simplified bottom-up and their subexpressions are already in normal form.
 Attribute ParamExprAttr::get(PEO opcode, ArrayRef<Attribute> operandsIn) {
   assert(!operandsIn.empty() && "Cannot have expr with no operands");
   // All operands must have the same type, which is the type of the result.
@@ -684,6 +719,11 @@ Attribute ParamExprAttr::get(PEO opcode, ArrayRef<Attribute> operandsIn) {
   assert(llvm::all_of(operandsIn.drop_front(),
                       [&](auto op) { return op.getType() == type; }));
 
+  auto &cache = getParamExprCache(operandsIn.front().getContext());
+  auto key = std::make_pair(static_cast<unsigned>(opcode), operandsIn);
+  if (auto cached = cache.lookup(key))
+    return cached;
+
   SmallVector<Attribute, 4> operands(operandsIn.begin(), operandsIn.end());
 
   // Verify and canonicalize parameter expressions.
@@ -733,11 +773,12 @@ Attribute ParamExprAttr::get(PEO opcode, ArrayRef<Attribute> operandsIn) {
     break;
   }
 
-  // If we folded to an operand, return it.
-  if (result)
-    return result;
+  // If we didn't fold to an operand, build the expression.
+  if (!result)
+    result = Base::get(operands[0].getContext(), opcode, operands, type);
 
-  return Base::get(operands[0].getContext(), opcode, operands, type);
+  cache.insert(key, result);
+  return result;
 }
 
 Attribute ParamExprAttr::parse(AsmParser &p, Type type) {
@@ -779,7 +820,7 @@ void ParamExprAttr::print(AsmPrinter &p) const {
 // corresponding value from the map of provided parameters.
 static FailureOr<Attribute>
 replaceDeclRefInExpr(Location loc,
-                     const std::map<std::string, Attribute> &parameters,
+                     const DenseMap<StringAttr, Attribute> &parameters,
                      Attribute paramAttr) {
   if (paramAttr.dyn_cast<IntegerAttr>()) {
     // Nothing to do, constant value.
@@ -787,7 +828,7 @@ replaceDeclRefInExpr(Location loc,
   }
   if (auto paramRefAttr = paramAttr.dyn_cast<hw::ParamDeclRefAttr>()) {
     // Get the value from the provided parameters.
-    auto it = parameters.find(paramRefAttr.getName().str());
+    auto it = parameters.find(paramRefAttr.getName());
     if (it == parameters.end())
       return emitError(loc)
              << "Could not find parameter " << paramRefAttr.getName().str()
@@ -814,10 +855,10 @@ FailureOr<Attribute> hw::evaluateParametricAttr(Location loc,
                                                 ArrayAttr parameters,
                                                 Attribute paramAttr) {
   // Create a map of the provided parameters for faster lookup.
-  std::map<std::string, Attribute> parameterMap;
+  DenseMap<StringAttr, Attribute> parameterMap;
   for (auto param : parameters) {
     auto paramDecl = param.cast<ParamDeclAttr>();
-    parameterMap[paramDecl.getName().str()] = paramDecl.getValue();
+    parameterMap[paramDecl.getName()] = paramDecl.getValue();
   }
 
   // First, replace any ParamDeclRefAttr in the expression with its
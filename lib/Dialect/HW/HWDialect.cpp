@@ -68,6 +68,7 @@ void HWDialect::initialize() {
   // Register types and attributes.
   registerTypes();
   registerAttributes();
+  paramExprCache = std::make_unique<detail::ParamExprCache>();
 
   // Register operations.
   addOperations<
@@ -0,0 +1,146 @@
+//===- InstanceGraphLevels.cpp - Level-synchronous module traversal -------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+
+#include "circt/Dialect/HW/InstanceGraphLevels.h"
+#include "mlir/IR/Threading.h"
+#include "llvm/ADT/SetVector.h"
+
+using namespace circt;
+using namespace hw;
+
+/// Report an instance cycle.  `path` holds the instances leading from the
+/// first module on the cycle to the instance which closes it.
+static void emitCycleError(ArrayRef<InstanceRecord *> path) {
+  auto *module = path.front()->getParent();
+  auto diag = module->getModule().emitError("module '")
+              << module->getModule().moduleName()
+              << "' recursively instantiates itself";
+  for (auto *record : path)
+    diag.attachNote(record->getInstance().getLoc())
+        << "through instance '" << record->getInstance().instanceName()
+        << "' of module '" << record->getTarget()->getModule().moduleName()
+        << "'";
+}
+
+FailureOr<InstanceGraphLevels>
+InstanceGraphLevels::get(InstanceGraphBase &graph) {
+  // Compute the level of every module in post-order, so that every module it
+  // instantiates already has a level.  Starting from every node also covers
+  // modules which are not reachable from the top.  `stack` holds the modules
+  // on the current path, and `path` the instances between them.
+  DenseMap<InstanceGraphNode *, unsigned> levels;
+  llvm::SetVector<InstanceGraphNode *> stack;
+  SmallVector<InstanceGraphNode::iterator> nextInstances;
+  SmallVector<InstanceRecord *> path;
+  unsigned numLevels = 0;
+  for (auto *root : graph) {
+    if (levels.count(root))
+      continue;
+    stack.insert(root);
+    nextInstances.push_back(root->begin());
+    while (!stack.empty()) {
+      auto *node = stack.back();
+      auto &next = nextInstances.back();
+      if (next != node->end()) {
+        auto *record = *next++;
+        auto *target = record->getTarget();
+        if (levels.count(target))
+          continue;
+        path.push_back(record);
+        if (!stack.insert(target)) {
+          auto cycleBegin = llvm::find(stack, target) - stack.begin();
+          emitCycleError(makeArrayRef(path).drop_front(cycleBegin));
+          return failure();
+        }
+        nextInstances.push_back(target->begin());
+        continue;
+      }
+
+      unsigned level = 0;
+      for (auto *record : *node)
+        level = std::max(level, levels.lookup(record->getTarget()) + 1);
+      levels[node] = level;
+      numLevels = std::max(numLevels, level + 1);
+      stack.pop_back();
+      nextInstances.pop_back();
+      if (!path.empty())
+        path.pop_back();
+    }
+  }
+
+  // Number the modules level by level.  Use the order of the instance graph
+  // within each level, rather than the post-order, so that the modules on a
+  // level stay in a predictable order.
+  SmallVector<SmallVector<InstanceGraphNode *>> buckets(numLevels);
+  for (auto *node : graph)
+    buckets[levels[node]].push_back(node);
+
+  InstanceGraphLevels result;
+  result.nodes.reserve(levels.size());
+  result.levelBegins.reserve(numLevels + 1);
+  for (auto &bucket : buckets) {
+    result.levelBegins.push_back(result.nodes.size());
+    for (auto *node : bucket) {
+      result.indices[node] = result.nodes.size();
+      result.nodes.push_back(node);
+    }
+  }
+  result.levelBegins.push_back(result.nodes.size());
+  return result;
+}
+
+unsigned InstanceGraphLevels::getLevelOf(InstanceGraphNode *node) const {
+  auto index = getIndex(node);
+  // Find the first level which begins after the module.
+  auto it = llvm::upper_bound(levelBegins, index);
+  return std::distance(levelBegins.begin(), it) - 1;
+}
+
+void hw::parallelForEachBottomUp(MLIRContext *context,
+                                 const InstanceGraphLevels &levels,
+                                 function_ref<void(InstanceGraphNode *)> fn) {
+  for (unsigned level = 0, e = levels.getNumLevels(); level != e; ++level) {
+    auto nodes = levels.getLevel(level);
+    mlir::parallelForEachN(context, 0, nodes.size(),
+                           [&](size_t i) { fn(nodes[i]); });
+  }
+}
+
+void hw::parallelForEachTopDown(MLIRContext *context,
+                                const InstanceGraphLevels &levels,
+                                function_ref<void(InstanceGraphNode *)> fn) {
+  for (unsigned level = levels.getNumLevels(); level != 0; --level) {
+    auto nodes = levels.getLevel(level - 1);
+    mlir::parallelForEachN(context, 0, nodes.size(),
+                           [&](size_t i) { fn(nodes[i]); });
+  }
+}
+
+LogicalResult hw::failableParallelForEachBottomUp(
+    MLIRContext *context, const InstanceGraphLevels &levels,
+    function_ref<LogicalResult(InstanceGraphNode *)> fn) {
+  for (unsigned level = 0, e = levels.getNumLevels(); level != e; ++level) {
+    auto nodes = levels.getLevel(level);
+    if (failed(mlir::failableParallelForEachN(
+            context, 0, nodes.size(), [&](size_t i) { return fn(nodes[i]); })))
+      return failure();
+  }
+  return success();
+}
+
+LogicalResult hw::failableParallelForEachTopDown(
+    MLIRContext *context, const InstanceGraphLevels &levels,
+    function_ref<LogicalResult(InstanceGraphNode *)> fn) {
+  for (unsigned level = levels.getNumLevels(); level != 0; --level) {
+    auto nodes = levels.getLevel(level - 1);
+    if (failed(mlir::failableParallelForEachN(
+            context, 0, nodes.size(), [&](size_t i) { return fn(nodes[i]); })))
+      return failure();
+  }
+  return success();
+}
@@ -22,6 +22,7 @@
 #include "mlir/IR/BlockAndValueMapping.h"
 #include "mlir/IR/Builders.h"
 #include "mlir/IR/PatternMatch.h"
+#include "mlir/IR/Threading.h"
 #include "mlir/Transforms/DialectConversion.h"
 #include "llvm/ADT/TypeSwitch.h"
 
@@ -102,15 +103,68 @@ struct ParameterSpecializationRegistry {
   }
 };
 
+// Evaluates parametric attributes and types against a single set of
+// parameters, memoizing the results. Parameterized modules tend to repeat the
+// same parameter expressions in many operations. The memo lives as long as the
+// specialization, so it is released once the module body is elaborated.
+struct ParametricEvaluator {
+  ParametricEvaluator(ArrayAttr parameters) : parameters(parameters) {}
+
+  FailureOr<Attribute> evaluate(Location loc, Attribute attr) {
+    auto it = attrCache.find(attr);
+    if (it != attrCache.end())
+      return it->second;
+    auto result = evaluateParametricAttr(loc, parameters, attr);
+    if (succeeded(result))
+      attrCache.try_emplace(attr, *result);
+    return result;
+  }
+
+  FailureOr<Type> evaluate(Location loc, Type type) {
+    auto it = typeCache.find(type);
+    if (it != typeCache.end())
+      return it->second;
+    auto result = evaluateParametricType(loc, parameters, type);
+    if (succeeded(result))
+      typeCache.try_emplace(type, *result);
+    return result;
+  }
+
+  ArrayAttr parameters;
+  DenseMap<Attribute, Attribute> attrCache;
+  DenseMap<Type, Type> typeCache;
+};
+
+// A parametric instance found in a specialized module, along with the module
+// it instantiates and its evaluated parameters.
+struct NestedInstance {
+  hw::HWModuleOp target;
+  ArrayAttr parameters;
+  hw::InstanceOp instanceOp;
+};
+
+// A single specialization of a parametric module. Specializations of the same
+// generation are elaborated in parallel, so each owns all of its state.
+struct Specialization {
+  Specialization(HWModuleOp source, ArrayAttr parameters)
+      : source(source), evaluator(parameters) {}
+
+  HWModuleOp source;
+  HWModuleOp target;
+  ParametricEvaluator evaluator;
+  SmallVector<NestedInstance> nestedInstances;
+};
+
 struct EliminateParamValueOpPattern : public OpRewritePattern<ParamValueOp> {
-  EliminateParamValueOpPattern(MLIRContext *context, ArrayAttr parameters)
-      : OpRewritePattern<ParamValueOp>(context), parameters(parameters) {}
+  EliminateParamValueOpPattern(MLIRContext *context,
+                               ParametricEvaluator &evaluator)
+      : OpRewritePattern<ParamValueOp>(context), evaluator(evaluator) {}
 
   LogicalResult matchAndRewrite(ParamValueOp op,
                                 PatternRewriter &rewriter) const override {
     // Substitute the param value op with an evaluated constant operation.
     FailureOr<Attribute> evaluated =
-        evaluateParametricAttr(op.getLoc(), parameters, op.value());
+        evaluator.evaluate(op.getLoc(), op.value());
     if (failed(evaluated))
       return failure();
     rewriter.replaceOpWithNewOp<hw::ConstantOp>(
@@ -119,7 +173,7 @@ struct EliminateParamValueOpPattern : public OpRewritePattern<ParamValueOp> {
     return success();
   }
 
-  ArrayAttr parameters;
+  ParametricEvaluator &evaluator;
 };
 
 // hw.array_get operations require indexes to be of equal width of the
@@ -156,10 +210,10 @@ public:
 struct ParametricTypeConversionPattern : public ConversionPattern {
   ParametricTypeConversionPattern(MLIRContext *ctx,
                                   TypeConverter &typeConverter,
-                                  ArrayAttr parameters)
+                                  ParametricEvaluator &evaluator)
       : ConversionPattern(typeConverter, MatchAnyOpTypeTag(), /*benefit=*/1,
                           ctx),
-        parameters(parameters) {}
+        evaluator(evaluator) {}
 
   LogicalResult
   matchAndRewrite(Operation *op, ArrayRef<Value> operands,
@@ -170,8 +224,7 @@ struct ParametricTypeConversionPattern : public ConversionPattern {
     rewriter.updateRootInPlace(op, [&]() {
       // Mutate result types
       for (auto &it : llvm::enumerate(op->getResultTypes())) {
-        FailureOr<Type> res =
-            evaluateParametricType(op->getLoc(), parameters, it.value());
+        FailureOr<Type> res = evaluator.evaluate(op->getLoc(), it.value());
         ok &= succeeded(res);
         if (!ok)
           return;
@@ -186,7 +239,7 @@ struct ParametricTypeConversionPattern : public ConversionPattern {
 
     return success(ok);
   };
-  ArrayAttr parameters;
+  ParametricEvaluator &evaluator;
 };
 
 struct HWSpecializePass : public hw::HWSpecializeBase<HWSpecializePass> {
@@ -194,29 +247,24 @@ struct HWSpecializePass : public hw::HWSpecializeBase<HWSpecializePass> {
 };
 
 static void populateTypeConversion(Location loc, TypeConverter &typeConverter,
-                                   ArrayAttr parameters) {
+                                   ParametricEvaluator &evaluator) {
   // Possibly parametric types
-  typeConverter.addConversion([=](hw::IntType type) {
-    return evaluateParametricType(loc, parameters, type).getValue();
+  typeConverter.addConversion([=, &evaluator](hw::IntType type) {
+    return evaluator.evaluate(loc, type).getValue();
   });
-  typeConverter.addConversion([=](hw::ArrayType type) {
-    return evaluateParametricType(loc, parameters, type).getValue();
+  typeConverter.addConversion([=, &evaluator](hw::ArrayType type) {
+    return evaluator.evaluate(loc, type).getValue();
   });
 
   // Valid target types.
   typeConverter.addConversion([](mlir::IntegerType type) { return type; });
 }
 
-// Registers any nested parametric instance ops of `target` for the next
-// specialization loop
-static LogicalResult registerNestedParametricInstanceOps(
-    HWModuleOp target, ArrayAttr parameters, SymbolCache &sc,
-    const ParameterSpecializationRegistry &currentRegistry,
-    ParameterSpecializationRegistry &nextRegistry,
-    llvm::DenseMap<hw::HWModuleOp,
-                   llvm::DenseMap<ArrayAttr, llvm::SmallVector<hw::InstanceOp>>>
-        &parametersUsers) {
-  // Register any nested parametric instance ops for the next loop
+// Collects any nested parametric instance ops of the specialized module, to be
+// registered for the next specialization loop.
+static LogicalResult collectNestedParametricInstanceOps(Specialization &spec,
+                                                        const SymbolCache &sc) {
+  auto target = spec.target;
   auto walkResult = target->walk([&](InstanceOp instanceOp) -> WalkResult {
     auto instanceParameters = instanceOp.parameters();
     // We can ignore non-parametric instances
@@ -229,8 +277,8 @@ static LogicalResult registerNestedParametricInstanceOps(
     for (auto instanceParameter : instanceParameters) {
       auto instanceParameterDecl = instanceParameter.cast<hw::ParamDeclAttr>();
       auto instanceParameterValue = instanceParameterDecl.getValue();
-      auto evaluated = evaluateParametricAttr(target.getLoc(), parameters,
-                                              instanceParameterValue);
+      auto evaluated =
+          spec.evaluator.evaluate(target.getLoc(), instanceParameterValue);
       if (failed(evaluated))
         return WalkResult::interrupt();
       evaluatedInstanceParameters.push_back(hw::ParamDeclAttr::get(
@@ -240,14 +288,9 @@ static LogicalResult registerNestedParametricInstanceOps(
     auto evaluatedInstanceParametersAttr =
         ArrayAttr::get(target.getContext(), evaluatedInstanceParameters);
 
-    if (auto targetHWModule = targetModuleOp(instanceOp, sc)) {
-      if (!currentRegistry.isRegistered(targetHWModule,
-                                        evaluatedInstanceParametersAttr))
-        nextRegistry.registerModuleOp(targetHWModule,
-                                      evaluatedInstanceParametersAttr);
-      parametersUsers[targetHWModule][evaluatedInstanceParametersAttr]
-          .push_back(instanceOp);
-    }
+    if (auto targetHWModule = targetModuleOp(instanceOp, sc))
+      spec.nestedInstances.push_back(
+          {targetHWModule, evaluatedInstanceParametersAttr, instanceOp});
 
     return WalkResult::advance();
   });
@@ -255,49 +298,56 @@ static LogicalResult registerNestedParametricInstanceOps(
   return failure(walkResult.wasInterrupted());
 }
 
-// Specializes the provided 'base' module into the 'target' module. By doing
-// so, we create a new module which
+// Creates the 'target' module of a specialization of its 'source' module. The
+// new module
 // 1. has no parameters
-// 2. has a name composing the name of 'base' as well as the 'parameters'
-// parameters.
+// 2. has a name composing the name of 'source' as well as the parameters.
 // 3. Has a top-level interface with any parametric types resolved.
-// 4. Any references to module parameters have been replaced with the
-// parameter value.
-static LogicalResult specializeModule(
-    OpBuilder builder, ArrayAttr parameters, SymbolCache &sc, Namespace &ns,
-    HWModuleOp source, HWModuleOp &target,
-    const ParameterSpecializationRegistry &currentRegistry,
-    ParameterSpecializationRegistry &nextRegistry,
-    llvm::DenseMap<hw::HWModuleOp,
-                   llvm::DenseMap<ArrayAttr, llvm::SmallVector<hw::InstanceOp>>>
-        &parametersUsers) {
+// The body is filled in by 'specializeModuleBody'.
+static LogicalResult createSpecializedModule(OpBuilder &builder, Namespace &ns,
+                                             Specialization &spec) {
   auto *ctx = builder.getContext();
+  auto source = spec.source;
+  auto parameters = spec.evaluator.parameters;
   // Update the types of the source module ports based on evaluating any
   // parametric in/output ports.
   auto ports = source.getPorts();
   for (auto &in : llvm::enumerate(source.getFunctionType().getInputs())) {
     FailureOr<Type> resType =
-        evaluateParametricType(source.getLoc(), parameters, in.value());
+        spec.evaluator.evaluate(source.getLoc(), in.value());
     if (failed(resType))
       return failure();
     ports.inputs[in.index()].type = resType.getValue();
   }
   for (auto &out : llvm::enumerate(source.getFunctionType().getResults())) {
     FailureOr<Type> resolvedType =
-        evaluateParametricType(source.getLoc(), parameters, out.value());
+        spec.evaluator.evaluate(source.getLoc(), out.value());
     if (failed(resolvedType))
       return failure();
     ports.outputs[out.index()].type = resolvedType.getValue();
   }
 
   // Create the specialized module using the evaluated port info.
-  target = builder.create<HWModuleOp>(
+  spec.target = builder.create<HWModuleOp>(
       source.getLoc(),
       StringAttr::get(ctx, generateModuleName(ns, source, parameters)), ports);
 
   // Erase the default created hw.output op - we'll copy the correct operation
   // during body elaboration.
-  (*target.getOps<hw::OutputOp>().begin()).erase();
+  (*spec.target.getOps<hw::OutputOp>().begin()).erase();
+  return success();
+}
+
+// Clones the body of the 'source' module of a specialization into its 'target'
+// module, such that any references to module parameters have been replaced
+// with the parameter value. This only touches the target module, so it can run
+// on many specializations in parallel.
+static LogicalResult specializeModuleBody(Specialization &spec,
+                                          const SymbolCache &sc) {
+  auto source = spec.source;
+  auto target = spec.target;
+  auto *ctx = target.getContext();
+  OpBuilder builder(ctx);
 
   // Clone body of the source into the target. Use ValueMapper to ensure safe
   // cloning in the presence of backedges.
@@ -318,10 +368,8 @@ static LogicalResult specializeModule(
       mapper.set(oldRes, newRes);
   }
 
-  // Register any nested parametric instance ops for the next loop
-  auto nestedRegistrationResult = registerNestedParametricInstanceOps(
-      target, parameters, sc, currentRegistry, nextRegistry, parametersUsers);
-  if (failed(nestedRegistrationResult))
+  // Collect any nested parametric instance ops for the next loop
+  if (failed(collectNestedParametricInstanceOps(spec, sc)))
     return failure();
 
   // We've now created a separate copy of the source module with a rewritten
@@ -329,10 +377,10 @@ static LogicalResult specializeModule(
   // types within operations.
   RewritePatternSet patterns(ctx);
   TypeConverter t;
-  populateTypeConversion(target.getLoc(), t, parameters);
-  patterns.add<EliminateParamValueOpPattern>(ctx, parameters);
+  populateTypeConversion(target.getLoc(), t, spec.evaluator);
+  patterns.add<EliminateParamValueOpPattern>(ctx, spec.evaluator);
   patterns.add<NarrowArrayGetIndexPattern>(ctx);
-  patterns.add<ParametricTypeConversionPattern>(ctx, t, parameters);
+  patterns.add<ParametricTypeConversionPattern>(ctx, t, spec.evaluator);
   ConversionTarget convTarget(*ctx);
   convTarget.addLegalOp<hw::HWModuleOp>();
   convTarget.addIllegalOp<hw::ParamValueOp>();
@@ -384,23 +432,44 @@ void HWSpecializePass::runOnOperation() {
   // registered for the next loop. We loop until no new nested modules have been
   // registered.
   while (!registry.uniqueModuleParameters.empty()) {
-    // The registry for the next specialization loop
-    ParameterSpecializationRegistry nextRegistry;
-    for (auto it : registry.uniqueModuleParameters) {
-      for (auto parameters : it.second) {
-        HWModuleOp specializedModule;
-        if (failed(specializeModule(builder, parameters, sc, ns, it.first,
-                                    specializedModule, registry, nextRegistry,
-                                    parametersUsers))) {
-          signalPassFailure();
-          return;
-        }
+    // Create the specialized modules of this generation in order, so that
+    // their names and positions are deterministic.
+    std::vector<Specialization> generation;
+    for (auto it : registry.uniqueModuleParameters)
+      for (auto parameters : it.second)
+        generation.emplace_back(it.first, parameters);
+
+    for (auto &spec : generation) {
+      if (failed(createSpecializedModule(builder, ns, spec))) {
+        signalPassFailure();
+        return;
+      }
+
+      // Extend the symbol cache with the newly created module.
+      sc.addDefinition(spec.target.getNameAttr(), spec.target);
+
+      // Add the specialization
+      specializations[spec.source][spec.evaluator.parameters] = spec.target;
+    }
 
-        // Extend the symbol cache with the newly created module.
-        sc.addDefinition(specializedModule.getNameAttr(), specializedModule);
+    // Elaborate the bodies of the specialized modules in parallel.
+    if (failed(failableParallelForEachN(
+            &getContext(), 0, generation.size(), [&](size_t i) {
+              return specializeModuleBody(generation[i], sc);
+            }))) {
+      signalPassFailure();
+      return;
+    }
 
-        // Add the specialization
-        specializations[it.first][parameters] = specializedModule;
+    // Register any nested parametric instance ops for the next loop, in the
+    // order they would have been found serially.
+    ParameterSpecializationRegistry nextRegistry;
+    for (auto &spec : generation) {
+      for (auto &nested : spec.nestedInstances) {
+        if (!registry.isRegistered(nested.target, nested.parameters))
+          nextRegistry.registerModuleOp(nested.target, nested.parameters);
+        parametersUsers[nested.target][nested.parameters].push_back(
+            nested.instanceOp);
       }
     }
 
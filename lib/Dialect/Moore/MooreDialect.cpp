@@ -20,6 +20,8 @@ using namespace circt::moore;
 //===----------------------------------------------------------------------===//
 
 void MooreDialect::initialize() {
+  typeLayoutCache = std::make_unique<detail::TypeLayoutCache>();
+
   // Register types.
   registerTypes();
 
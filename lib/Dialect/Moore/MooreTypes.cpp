@@ -128,8 +128,10 @@ Sign UnpackedType::getSign() const {
       .Default([](auto) { return Sign::Unsigned; });
 }
 
-Optional<unsigned> UnpackedType::getBitSize() const {
-  return TypeSwitch<UnpackedType, Optional<unsigned>>(*this)
+/// Compute the size of a type in bits. Nested unpacked types go through the
+/// memoized `getBitSize`.
+static Optional<unsigned> computeBitSize(UnpackedType type) {
+  return TypeSwitch<UnpackedType, Optional<unsigned>>(type)
       .Case<PackedType, RealType>([](auto type) { return type.getBitSize(); })
       .Case<UnpackedUnsizedDim>([](auto) { return Optional<unsigned>{}; })
       .Case<UnpackedArrayDim>([](auto type) -> Optional<unsigned> {
@@ -157,8 +159,9 @@ static SimpleBitVectorType getSimpleBitVectorFromIntType(IntType type) {
                              usedAtom, type.isSignExplicit(), false);
 }
 
-SimpleBitVectorType UnpackedType::getSimpleBitVectorOrNull() const {
-  return TypeSwitch<UnpackedType, SimpleBitVectorType>(fullyResolved())
+/// Map a type to the SBVT it is equivalent to, or a null SBVT.
+static SimpleBitVectorType computeSimpleBitVector(UnpackedType type) {
+  return TypeSwitch<UnpackedType, SimpleBitVectorType>(type.fullyResolved())
       .Case<IntType>([](auto type) {
         // Integer types trivially map to SBVTs.
         return getSimpleBitVectorFromIntType(type);
@@ -187,6 +190,29 @@ SimpleBitVectorType UnpackedType::getSimpleBitVectorOrNull() const {
       .Default([](auto) { return SimpleBitVectorType{}; });
 }
 
+TypeLayout UnpackedType::getLayout() const {
+  // Leaf types are cheaper to lay out than to look up.
+  if (isa<IntType, RealType, StringType, ChandleType, EventType>())
+    return {computeBitSize(*this), computeSimpleBitVector(*this)};
+
+  auto &cache =
+      static_cast<MooreDialect &>(getDialect()).getTypeLayoutCache();
+  {
+    llvm::sys::SmartScopedReader<true> lock(cache.mutex);
+    auto it = cache.layouts.find(*this);
+    if (it != cache.layouts.end())
+      return it->second;
+  }
+
+  // Compute the layout without holding the lock, since nested types look
+  // themselves up. Another thread may race us to the same result, which is
+  // harmless.
+  TypeLayout layout{computeBitSize(*this), computeSimpleBitVector(*this)};
+  llvm::sys::SmartScopedWriter<true> lock(cache.mutex);
+  cache.layouts.try_emplace(*this, layout);
+  return layout;
+}
+
 SimpleBitVectorType UnpackedType::castToSimpleBitVectorOrNull() const {
   // If the type is already a valid SBVT, return that immediately without
   // casting.
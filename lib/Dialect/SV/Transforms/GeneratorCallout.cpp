@@ -15,9 +15,13 @@
 #include "circt/Dialect/HW/HWOps.h"
 #include "circt/Dialect/SV/SVPasses.h"
 #include "mlir/IR/Builders.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/Support/FileUtilities.h"
 #include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Support/Path.h"
 #include "llvm/Support/Process.h"
+#include "llvm/Support/SHA256.h"
+#include "llvm/Support/ThreadPool.h"
 
 using namespace circt;
 using namespace sv;
@@ -29,13 +33,35 @@ using namespace hw;
 
 namespace {
 
+/// A single execution of the generator program for one generated module.
+struct Callout {
+  /// The arguments passed to the generator, starting with the executable.
+  SmallVector<std::string> args;
+
+  /// The path of this callout's result in the cache directory, if caching is
+  /// enabled.
+  std::string cachePath;
+
+  /// The generator binary hash and the arguments this callout's cache entry
+  /// must have been written for, separated by NUL characters.
+  std::string cacheKey;
+
+  /// The first line of the generator output.  Only valid if `error` is empty.
+  std::string result;
+
+  /// A description of the failure, if the callout failed.
+  std::string error;
+};
+
 struct HWGeneratorCalloutPass
     : public sv::HWGeneratorCalloutPassBase<HWGeneratorCalloutPass> {
   void runOnOperation() override;
 
-  void processGenerator(HWModuleGeneratedOp generatedModuleOp,
-                        StringRef generatorExe,
-                        ArrayRef<StringRef> extraGeneratorArgs);
+  Optional<SmallVector<std::string>>
+  getGeneratorArgs(HWModuleGeneratedOp generatedModuleOp,
+                   StringRef generatorExe,
+                   ArrayRef<StringRef> extraGeneratorArgs);
+  void runCallout(Callout &callout, StringRef generatorExe);
 };
 } // end anonymous namespace
 
@@ -58,25 +84,128 @@ void HWGeneratorCalloutPass::runOnOperation() {
                    execPath + "'");
     return;
   }
-  for (auto &op : llvm::make_early_inc_range(root.getBody()->getOperations())) {
-    if (auto generator = dyn_cast<HWModuleGeneratedOp>(op))
-      processGenerator(generator, *generatorExe, extraGeneratorArgs);
+
+  // Gather the arguments of every generated module.  The arguments include
+  // the module name, so every generated module needs its own callout.
+  std::vector<Callout> callouts;
+  SmallVector<HWModuleGeneratedOp> generatedModules;
+  for (auto &op : root.getBody()->getOperations()) {
+    auto generator = dyn_cast<HWModuleGeneratedOp>(op);
+    if (!generator)
+      continue;
+    auto args = getGeneratorArgs(generator, *generatorExe, extraGeneratorArgs);
+    if (!args)
+      continue;
+    callouts.push_back({std::move(*args), {}, {}, {}, {}});
+    generatedModules.push_back(generator);
+  }
+
+  // If there is a cache, key each callout by a hash of the generator binary
+  // and its arguments, and look up the results of previous runs.  Without the
+  // contents of the binary the key would not change when the generator does,
+  // so don't cache at all if it cannot be read.
+  Optional<std::array<uint8_t, 32>> exeHash;
+  if (!cacheDir.empty() && !callouts.empty()) {
+    if (auto exeBuffer = llvm::MemoryBuffer::getFile(*generatorExe)) {
+      llvm::SHA256 exeHasher;
+      exeHasher.update((*exeBuffer)->getBuffer());
+      exeHash = exeHasher.final();
+    } else {
+      root.emitWarning("cannot read generator executable '")
+          << *generatorExe << "', caching disabled";
+    }
+  }
+  if (exeHash) {
+    (void)llvm::sys::fs::create_directories(cacheDir);
+
+    auto exeHashHex = llvm::toHex(*exeHash, /*LowerCase=*/true);
+    for (auto &callout : callouts) {
+      callout.cacheKey = exeHashHex;
+      for (auto &arg : callout.args) {
+        callout.cacheKey.push_back('\0');
+        callout.cacheKey += arg;
+      }
+      SmallString<128> cachePath(cacheDir);
+      llvm::sys::path::append(
+          cachePath,
+          llvm::toHex(llvm::SHA256::hash(llvm::arrayRefFromStringRef(
+                          callout.cacheKey)),
+                      /*LowerCase=*/true));
+      callout.cachePath = std::string(cachePath);
+    }
+  }
+
+  // Run all the callouts which are not cached concurrently.  Each callout only
+  // touches its own entry.  A cache entry holds the key it was written for on
+  // its first line and the generator result on the second.  It is only used
+  // if the key matches the callout exactly, such that a hash collision or a
+  // stale or damaged entry never produces a wrong result, and if the file the
+  // generator produced still exists.
+  auto runOrLoad = [&](Callout &callout) {
+    if (!callout.cachePath.empty()) {
+      if (auto cached = llvm::MemoryBuffer::getFile(callout.cachePath)) {
+        auto [key, result] = (*cached)->getBuffer().split('\n');
+        if (key == callout.cacheKey && !result.empty() &&
+            llvm::sys::fs::exists(result)) {
+          callout.result = result.str();
+          ++numCacheHits;
+          return;
+        }
+      }
+    }
+    runCallout(callout, *generatorExe);
+    // Failing to update the cache is not an error.
+    if (callout.error.empty() && !callout.cachePath.empty())
+      llvm::consumeError(llvm::writeFileAtomically(
+          callout.cachePath + "-%%%%%%%%", callout.cachePath,
+          callout.cacheKey + "\n" + callout.result));
+  };
+  if (getContext().isMultithreadingEnabled() && callouts.size() > 1) {
+    llvm::ThreadPool pool(llvm::hardware_concurrency(numJobs));
+    for (auto &callout : callouts)
+      pool.async([&runOrLoad, c = &callout] { runOrLoad(*c); });
+    pool.wait();
+  } else {
+    for (auto &callout : callouts)
+      runOrLoad(callout);
+  }
+
+  // Replace the generated modules with external modules in their original
+  // order, reporting any failures.
+  for (auto [generatedModuleOp, callout] :
+       llvm::zip(generatedModules, callouts)) {
+    if (!callout.error.empty()) {
+      generatedModuleOp.emitError(callout.error);
+      continue;
+    }
+    OpBuilder builder(generatedModuleOp);
+    auto extMod = builder.create<hw::HWModuleExternOp>(
+        generatedModuleOp.getLoc(),
+        generatedModuleOp.getVerilogModuleNameAttr(),
+        generatedModuleOp.getPorts());
+    // Attach an attribute to which file the definition of the external
+    // module exists in.
+    extMod->setAttr("filenames", builder.getStringAttr(callout.result));
+    generatedModuleOp.erase();
   }
 }
 
-void HWGeneratorCalloutPass::processGenerator(
+/// Return the arguments to pass to the generator for this generated module,
+/// starting with the generator executable itself.  Return None if the module
+/// should not be generated, or if it is invalid.
+Optional<SmallVector<std::string>> HWGeneratorCalloutPass::getGeneratorArgs(
     HWModuleGeneratedOp generatedModuleOp, StringRef generatorExe,
     ArrayRef<StringRef> extraGeneratorArgs) {
   // Get the corresponding schema associated with this generated op.
   auto genSchema =
       dyn_cast<HWGeneratorSchemaOp>(generatedModuleOp.getGeneratorKindOp());
   if (!genSchema)
-    return;
+    return None;
 
   // Ignore the generator op if the schema does not match the user specified
   // schema name from command line "-schema-name"
   if (genSchema.descriptor().str() != schemaName)
-    return;
+    return None;
 
   SmallVector<std::string> generatorArgs;
   // First argument should be the executable name.
@@ -110,11 +239,19 @@ void HWGeneratorCalloutPass::processGenerator(
           " value specified on the rtl.module.generated operation is not "
           "handled, "
           "only integer and string types supported.");
-      return;
+      return None;
     }
   }
+  return generatorArgs;
+}
+
+/// Execute the generator and record the first line of its output in the
+/// callout.  This may run on any thread, so failures are recorded in the
+/// callout instead of being reported directly.
+void HWGeneratorCalloutPass::runCallout(Callout &callout,
+                                        StringRef generatorExe) {
   SmallVector<StringRef> generatorArgStrRef;
-  for (const std::string &a : generatorArgs)
+  for (const std::string &a : callout.args)
     generatorArgStrRef.push_back(a);
 
   std::string errMsg;
@@ -124,38 +261,32 @@ void HWGeneratorCalloutPass::processGenerator(
   // Default error code is 0.
   std::error_code ok;
   if (errCode != ok) {
-    generatedModuleOp.emitError("cannot generate a unique temporary file name");
+    callout.error = "cannot generate a unique temporary file name";
     return;
   }
   Optional<StringRef> redirects[] = {None, StringRef(genExecOutFileName), None};
+  ++numCallouts;
   int result = llvm::sys::ExecuteAndWait(
       generatorExe, generatorArgStrRef, /*Env=*/None,
       /*Redirects=*/redirects,
       /*SecondsToWait=*/0, /*MemoryLimit=*/0, &errMsg);
 
   if (result != 0) {
-    generatedModuleOp.emitError("execution of '" + generatorExe + "' failed");
+    callout.error = ("execution of '" + generatorExe + "' failed").str();
     return;
   }
 
   auto bufferRead = llvm::MemoryBuffer::getFile(genExecOutFileName);
   if (!bufferRead || !*bufferRead) {
-    generatedModuleOp.emitError("execution of '" + generatorExe +
-                                "' did not produce any output file named '" +
-                                genExecOutFileName + "'");
+    callout.error = ("execution of '" + generatorExe +
+                     "' did not produce any output file named '" +
+                     genExecOutFileName + "'")
+                        .str();
     return;
   }
 
   // Only extract the first line from the output.
-  auto fileContent = (*bufferRead)->getBuffer().split('\n').first.str();
-  OpBuilder builder(generatedModuleOp);
-  auto extMod = builder.create<hw::HWModuleExternOp>(
-      generatedModuleOp.getLoc(), generatedModuleOp.getVerilogModuleNameAttr(),
-      generatedModuleOp.getPorts());
-  // Attach an attribute to which file the definition of the external
-  // module exists in.
-  extMod->setAttr("filenames", builder.getStringAttr(fileContent));
-  generatedModuleOp.erase();
+  callout.result = (*bufferRead)->getBuffer().split('\n').first.str();
 }
 
 std::unique_ptr<Pass> circt::sv::createHWGeneratorCalloutPass() {
@@ -18,7 +18,9 @@
 #include "circt/Dialect/SV/SVPasses.h"
 #include "circt/Support/Path.h"
 #include "mlir/IR/Builders.h"
+#include "mlir/IR/Threading.h"
 #include "mlir/Support/FileUtilities.h"
+#include "llvm/ADT/DenseSet.h"
 #include "llvm/Support/FileSystem.h"
 #include "llvm/Support/JSON.h"
 #include "llvm/Support/Path.h"
@@ -39,51 +41,183 @@ struct HWExportModuleHierarchyPass
   void runOnOperation() override;
 };
 
-/// Recursively print the module hierarchy as serialized as JSON.
-static void printHierarchy(hw::InstanceOp &inst, SymbolTable &symbolTable,
-                           llvm::json::OStream &j) {
-  auto moduleOp = symbolTable.lookup(inst.moduleNameAttr().getValue());
+/// Write a string as a quoted and escaped JSON string.
+static void printString(llvm::raw_ostream &os, StringRef str) {
+  llvm::json::OStream(os).value(str);
+}
 
-  j.object([&] {
-    j.attribute("instance_name", inst.instanceName());
-    j.attribute("module_name", hw::getVerilogModuleName(moduleOp));
-    j.attributeArray("instances", [&] {
-      // Only recurse on module ops, not extern or generated ops, whose internal
-      // are opaque.
-      if (auto module = dyn_cast<hw::HWModuleOp>(moduleOp)) {
-        for (auto op : module.getOps<hw::InstanceOp>()) {
-          printHierarchy(op, symbolTable, j);
-        }
-      }
-    });
-  });
+/// Return a string quoted and escaped as a JSON string.
+static std::string quoteString(StringRef str) {
+  std::string result;
+  llvm::raw_string_ostream os(result);
+  printString(os, str);
+  return os.str();
 }
 
-/// Return the JSON-serialized module hierarchy for the given module as the top
-/// of the hierarchy.
-static void extractHierarchyFromTop(hw::HWModuleOp op, SymbolTable &symbolTable,
-                                    llvm::raw_ostream &os) {
-  llvm::json::OStream j(os, 2);
+namespace {
+/// Print the fully expanded instance hierarchy below a top module, with one
+/// nested object per instance.  A module instantiated many times has the same
+/// subtree below each of its instances.  The subtree is streamed to the output
+/// again every time, indented as it is written, and only the escaped names of
+/// the instances in every module are memoized.  The output is formatted
+/// exactly like `llvm::json::OStream` with an indentation of 2.
+class ExpandedHierarchyPrinter {
+public:
+  ExpandedHierarchyPrinter(SymbolTable &symbolTable, llvm::raw_ostream &os)
+      : symbolTable(symbolTable), os(os) {}
+
+  void print(hw::HWModuleOp top);
+
+private:
+  /// An instance in a module, with its names quoted and escaped.
+  struct Instance {
+    std::string instanceName;
+    std::string moduleName;
+    Operation *target;
+  };
+
+  /// Gather the instances of every module below `top`.
+  void collectInstances(hw::HWModuleOp top);
+
+  /// Print the JSON array of the instances in a module, indented as if it
+  /// started at column `indent`.
+  void printInstances(Operation *module, unsigned indent);
+
+  SymbolTable &symbolTable;
+  llvm::raw_ostream &os;
+
+  /// The instances of every module below the top.  This is filled in before
+  /// printing, so that it is not modified while it is being iterated.
+  DenseMap<Operation *, SmallVector<Instance, 0>> instances;
+};
+} // namespace
+
+void ExpandedHierarchyPrinter::collectInstances(hw::HWModuleOp top) {
+  SmallVector<hw::HWModuleOp> worklist;
+  worklist.push_back(top);
+  while (!worklist.empty()) {
+    auto module = worklist.pop_back_val();
+    auto [it, inserted] = instances.try_emplace(module);
+    if (!inserted)
+      continue;
+    auto &moduleInstances = it->second;
+    for (auto inst : module.getOps<hw::InstanceOp>()) {
+      auto *target = symbolTable.lookup(inst.moduleNameAttr().getAttr());
+      moduleInstances.push_back({quoteString(inst.instanceName()),
+                                 quoteString(hw::getVerilogModuleName(target)),
+                                 target});
+      // Only recurse on module ops, not extern or generated ops, whose
+      // internals are opaque.
+      auto targetModule = dyn_cast<hw::HWModuleOp>(target);
+      if (targetModule && !instances.count(targetModule))
+        worklist.push_back(targetModule);
+    }
+  }
+}
+
+void ExpandedHierarchyPrinter::printInstances(Operation *module,
+                                              unsigned indent) {
+  auto it = instances.find(module);
+  if (it == instances.end() || it->second.empty()) {
+    os << "[]";
+    return;
+  }
+
+  os << "[";
+  bool first = true;
+  for (auto &inst : it->second) {
+    os << (first ? "\n" : ",\n");
+    first = false;
+    os.indent(indent + 2) << "{\n";
+    os.indent(indent + 4) << "\"instance_name\": " << inst.instanceName
+                          << ",\n";
+    os.indent(indent + 4) << "\"module_name\": " << inst.moduleName << ",\n";
+    os.indent(indent + 4) << "\"instances\": ";
+    printInstances(inst.target, indent + 4);
+    os << "\n";
+    os.indent(indent + 2) << "}";
+  }
+  os << "\n";
+  os.indent(indent) << "]";
+}
+
+void ExpandedHierarchyPrinter::print(hw::HWModuleOp top) {
+  collectInstances(top);
 
   // As a special case for top-level module, set instance name to module name,
   // since the top-level module is not instantiated.
-  j.object([&] {
-    j.attribute("instance_name", op.getName());
-    j.attribute("module_name", hw::getVerilogModuleName(op));
+  os << "{\n";
+  os.indent(2) << "\"instance_name\": ";
+  printString(os, top.getName());
+  os << ",\n";
+  os.indent(2) << "\"module_name\": ";
+  printString(os, hw::getVerilogModuleName(top));
+  os << ",\n";
+  os.indent(2) << "\"instances\": ";
+  printInstances(top, 2);
+  os << "\n";
+  os << "}";
+}
+
+/// Print the compact instance hierarchy below a top module.  The instances of
+/// the top module are listed like in the expanded format, but only with their
+/// instance and module names.  Every module below the top is then listed once
+/// in the "modules" array, in the order it is first reached, with its own
+/// instances in the same form.  The output therefore grows with the number of
+/// modules rather than the number of instances.
+static void printCompactHierarchy(hw::HWModuleOp top, SymbolTable &symbolTable,
+                                  llvm::raw_ostream &os) {
+  llvm::json::OStream j(os, 2);
+  SmallVector<Operation *> worklist;
+  DenseSet<Operation *> seen;
+  seen.insert(top);
+
+  auto printInstances = [&](Operation *module) {
     j.attributeArray("instances", [&] {
-      for (auto op : op.getOps<hw::InstanceOp>())
-        printHierarchy(op, symbolTable, j);
+      // Only recurse on module ops, not extern or generated ops, whose
+      // internals are opaque.
+      auto moduleOp = dyn_cast<hw::HWModuleOp>(module);
+      if (!moduleOp)
+        return;
+      for (auto inst : moduleOp.getOps<hw::InstanceOp>()) {
+        auto *target = symbolTable.lookup(inst.moduleNameAttr().getAttr());
+        if (seen.insert(target).second)
+          worklist.push_back(target);
+        j.object([&] {
+          j.attribute("instance_name", inst.instanceName());
+          j.attribute("module_name", hw::getVerilogModuleName(target));
+        });
+      }
+    });
+  };
+
+  j.object([&] {
+    j.attribute("instance_name", top.getName());
+    j.attribute("module_name", hw::getVerilogModuleName(top));
+    printInstances(top);
+    j.attributeArray("modules", [&] {
+      for (size_t i = 0; i < worklist.size(); ++i) {
+        auto *module = worklist[i];
+        j.object([&] {
+          j.attribute("module_name", hw::getVerilogModuleName(module));
+          printInstances(module);
+        });
+      }
     });
   });
 }
 
-/// Find the modules corresponding to the firrtl mainModule and DesignUnderTest,
-/// and if they exist, emit a verbatim op with the module hierarchy for each.
+/// Find the modules with the firrtl.moduleHierarchyFile attribute, and emit
+/// the module hierarchy below each of them into the requested files.
 void HWExportModuleHierarchyPass::runOnOperation() {
   mlir::ModuleOp mlirModule = getOperation();
   Optional<SymbolTable> symbolTable = None;
   bool directoryCreated = false;
 
+  // Open all of the output files first, so that the hierarchies can then be
+  // printed in parallel.
+  SmallVector<std::pair<hw::HWModuleOp, std::unique_ptr<llvm::ToolOutputFile>>>
+      outputs;
   for (auto op : mlirModule.getOps<hw::HWModuleOp>()) {
     auto attr = op->getAttrOfType<ArrayAttr>("firrtl.moduleHierarchyFile");
     if (!attr)
@@ -113,13 +247,22 @@ void HWExportModuleHierarchyPass::runOnOperation() {
         signalPassFailure();
         return;
       }
-
-      extractHierarchyFromTop(op, symbolTable.getValue(), outputFile->os());
-
-      outputFile->keep();
+      outputs.emplace_back(op, std::move(outputFile));
     }
   }
 
+  // Every file only reads the IR, and has a printer of its own.
+  mlir::parallelForEachN(&getContext(), 0, outputs.size(), [&](size_t i) {
+    auto &[top, outputFile] = outputs[i];
+    if (compact)
+      printCompactHierarchy(top, *symbolTable, outputFile->os());
+    else
+      ExpandedHierarchyPrinter(*symbolTable, outputFile->os()).print(top);
+  });
+
+  for (auto &output : outputs)
+    output.second->keep();
+
   markAllAnalysesPreserved();
 }
 
@@ -18,7 +18,7 @@
 
 using namespace circt;
 
-Backedge::Backedge(mlir::Operation *op) : value(op->getResult(0)) {}
+Backedge::Backedge(mlir::Value value) : value(value) {}
 
 void Backedge::setValue(mlir::Value newValue) {
   assert(value.getType() == newValue.getType());
@@ -31,37 +31,92 @@ BackedgeBuilder::~BackedgeBuilder() { (void)clearOrEmitError(); }
 
 LogicalResult BackedgeBuilder::clearOrEmitError() {
   unsigned numInUse = 0;
-  for (Operation *op : edges) {
-    if (!op->use_empty()) {
-      auto diag = op->emitError("backedge of type `")
-                  << op->getResult(0).getType() << "`still in use";
-      for (auto user : op->getUsers())
-        diag.attachNote(user->getLoc()) << "used by " << *user;
-      ++numInUse;
+  for (auto [value, edgeLoc] : edges) {
+    if (value.use_empty())
+      continue;
+    auto diag = mlir::emitError(edgeLoc, "backedge of type `")
+                << value.getType() << "`still in use";
+    for (auto user : value.getUsers())
+      diag.attachNote(user->getLoc()) << "used by " << *user;
+    ++numInUse;
+  }
+
+  // Placeholder ops are erased once none of their backedges are in use. A
+  // placeholder op with backedges still in use is replaced by a smaller one
+  // with only those, so that an abandoned backedge does not keep every other
+  // result of its pool alive.
+  for (Operation *op : poolOps) {
+    SmallVector<unsigned> usedResults;
+    for (auto result : op->getResults())
+      if (!result.use_empty())
+        usedResults.push_back(result.getResultNumber());
+    if (usedResults.size() == op->getNumResults())
+      continue;
+
+    if (usedResults.empty()) {
+      if (rewriter)
+        rewriter->eraseOp(op);
+      else
+        op->erase();
       continue;
     }
-    if (rewriter)
-      rewriter->eraseOp(op);
-    else
+
+    OpBuilder::InsertionGuard guard(builder);
+    builder.setInsertionPoint(op);
+    SmallVector<Type> types(usedResults.size(), op->getResult(0).getType());
+    auto usedOp = builder.create<mlir::UnrealizedConversionCastOp>(
+        op->getLoc(), types, ValueRange{});
+    // The unused results are replaced too, but have no uses. Every result of
+    // a placeholder op has the same type.
+    SmallVector<Value> replacements(op->getNumResults(), usedOp.getResult(0));
+    for (unsigned i = 0, e = usedResults.size(); i != e; ++i)
+      replacements[usedResults[i]] = usedOp.getResult(i);
+    if (rewriter) {
+      rewriter->replaceOp(op, replacements);
+    } else {
+      op->replaceAllUsesWith(replacements);
       op->erase();
+    }
   }
+  pools.clear();
+  poolOps.clear();
   edges.clear();
   if (numInUse > 0)
     mlir::emitRemark(loc, "abandoned ") << numInUse << " backedges";
   return success(numInUse == 0);
 }
 
-void BackedgeBuilder::abandon() { edges.clear(); }
+void BackedgeBuilder::abandon() {
+  pools.clear();
+  poolOps.clear();
+  edges.clear();
+}
 
 BackedgeBuilder::BackedgeBuilder(OpBuilder &builder, Location loc)
     : builder(builder), rewriter(nullptr), loc(loc) {}
 BackedgeBuilder::BackedgeBuilder(PatternRewriter &rewriter, Location loc)
     : builder(rewriter), rewriter(&rewriter), loc(loc) {}
+/// The largest number of backedges handed out by one placeholder op.
+static constexpr unsigned maxPoolSize = 1024;
+
 Backedge BackedgeBuilder::get(Type t, mlir::LocationAttr optionalLoc) {
   if (!optionalLoc)
     optionalLoc = loc;
-  Operation *op = builder.create<mlir::UnrealizedConversionCastOp>(
-      optionalLoc, t, ValueRange{});
-  edges.push_back(op);
-  return Backedge(op);
+
+  // Start a new placeholder op, twice as large as the last one, when the
+  // current one has run out of results.
+  auto &pool = pools[{t, builder.getInsertionBlock()}];
+  if (!pool.op || pool.numUsed == pool.op->getNumResults()) {
+    unsigned size =
+        pool.op ? std::min(2 * pool.op->getNumResults(), maxPoolSize) : 1;
+    SmallVector<Type> types(size, t);
+    pool.op = builder.create<mlir::UnrealizedConversionCastOp>(
+        optionalLoc, types, ValueRange{});
+    pool.numUsed = 0;
+    poolOps.push_back(pool.op);
+  }
+
+  Value value = pool.op->getResult(pool.numUsed++);
+  edges.emplace_back(value, optionalLoc);
+  return Backedge(value);
 }
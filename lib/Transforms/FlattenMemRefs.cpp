@@ -21,6 +21,7 @@
 #include "mlir/IR/BuiltinTypes.h"
 #include "mlir/IR/ImplicitLocOpBuilder.h"
 #include "mlir/IR/OperationSupport.h"
+#include "mlir/IR/Threading.h"
 #include "mlir/Transforms/DialectConversion.h"
 #include "mlir/Transforms/GreedyPatternRewriteDriver.h"
 #include "llvm/Support/MathExtras.h"
@@ -40,7 +41,11 @@ struct FunctionRewrite {
 };
 
 // Flatten indices by generating the product of the i'th index and the [0:i-1]
-// shapes, for each index, and then summing these.
+// shapes, for each index, and then summing these.  Accesses are in bounds, so
+// the sum of the lower indices is always less than the [0:i-1] product.  If
+// that product is a power of two, the i'th term is therefore a shift which
+// cannot overlap the bits of the lower terms, and is combined with an `or`
+// rather than an adder.
 static Value flattenIndices(ConversionPatternRewriter &rewriter, Operation *op,
                             ValueRange indices, MemRefType memrefType) {
   assert(memrefType.hasStaticShape() && "expected statically shaped memref");
@@ -57,7 +62,8 @@ static Value flattenIndices(ConversionPatternRewriter &rewriter, Operation *op,
     }
 
     // Multiply product by the current index operand.
-    if (llvm::isPowerOf2_64(indexMulFactor)) {
+    bool isPowerOf2 = llvm::isPowerOf2_64(indexMulFactor);
+    if (isPowerOf2) {
       auto constant =
           rewriter
               .create<arith::ConstantOp>(
@@ -75,8 +81,10 @@ static Value flattenIndices(ConversionPatternRewriter &rewriter, Operation *op,
     }
 
     // Sum up with the prior lower dimension accessors.
-    auto sumOp = rewriter.create<arith::AddIOp>(loc, finalIdx, partialIdx);
-    finalIdx = sumOp.getResult();
+    if (isPowerOf2)
+      finalIdx = rewriter.create<arith::OrIOp>(loc, finalIdx, partialIdx);
+    else
+      finalIdx = rewriter.create<arith::AddIOp>(loc, finalIdx, partialIdx);
   }
   return finalIdx;
 }
@@ -301,27 +309,31 @@ static void populateTypeConversionPatterns(TypeConverter &typeConverter) {
 struct FlattenMemRefPass : public FlattenMemRefBase<FlattenMemRefPass> {
 public:
   void runOnOperation() override {
-
+    // None of the patterns reach outside of the function they are applied to:
+    // calls only have their result types converted, and each function only
+    // converts its own signature.  Functions are therefore flattened in
+    // parallel, each with a type converter of its own, since the type
+    // converter caches conversions without synchronization.
     auto *ctx = &getContext();
-    TypeConverter typeConverter;
-    populateTypeConversionPatterns(typeConverter);
-
-    RewritePatternSet patterns(ctx);
-    SetVector<StringRef> rewrittenCallees;
-    patterns.add<LoadOpConversion, StoreOpConversion, AllocOpConversion,
-                 ReturnOpConversion, CondBranchOpConversion, BranchOpConversion,
-                 CallOpConversion>(typeConverter, ctx);
-    populateFunctionOpInterfaceTypeConversionPattern<func::FuncOp>(
-        patterns, typeConverter);
-
-    ConversionTarget target(*ctx);
-    populateFlattenMemRefsLegality(target);
-
-    if (applyPartialConversion(getOperation(), target, std::move(patterns))
-            .failed()) {
+    auto funcOps = llvm::to_vector(getOperation().getOps<func::FuncOp>());
+    auto result = failableParallelForEach(ctx, funcOps, [&](func::FuncOp op) {
+      TypeConverter typeConverter;
+      populateTypeConversionPatterns(typeConverter);
+
+      RewritePatternSet patterns(ctx);
+      patterns.add<LoadOpConversion, StoreOpConversion, AllocOpConversion,
+                   ReturnOpConversion, CondBranchOpConversion,
+                   BranchOpConversion, CallOpConversion>(typeConverter, ctx);
+      populateFunctionOpInterfaceTypeConversionPattern<func::FuncOp>(
+          patterns, typeConverter);
+
+      ConversionTarget target(*ctx);
+      populateFlattenMemRefsLegality(target);
+
+      return applyPartialConversion(op, target, std::move(patterns));
+    });
+    if (failed(result))
       signalPassFailure();
-      return;
-    }
   }
 };
 
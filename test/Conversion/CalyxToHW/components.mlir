@@ -0,0 +1,59 @@
+// RUN: circt-opt -lower-calyx-to-hw %s | FileCheck %s
+// RUN: circt-opt -lower-calyx-to-hw --mlir-disable-threading %s | FileCheck %s
+
+// Every component becomes a module, in program order, and is converted
+// independently of the others.
+
+// CHECK-NOT: calyx.
+// CHECK-LABEL: hw.module @A(%in: i8, %clk: i1, %reset: i1, %go: i1) -> (out: i8, done: i1) {
+// CHECK:   %out = sv.wire  : !hw.inout<i8>
+// CHECK:   %[[OUT:.+]] = sv.read_inout %out : !hw.inout<i8>
+// CHECK:   %done = sv.wire  : !hw.inout<i1>
+// CHECK:   %[[DONE:.+]] = sv.read_inout %done : !hw.inout<i1>
+// CHECK:   %[[NOT:.+]] = comb.xor
+// CHECK:   sv.assign %out,
+// CHECK:   hw.output %[[OUT]], %[[DONE]] : i8, i1
+// CHECK: }
+// CHECK-LABEL: hw.module @B(%in: i8, %clk: i1, %reset: i1, %go: i1) -> (out: i8, done: i1) {
+// CHECK:   comb.and
+// CHECK:   hw.output
+// CHECK: }
+// CHECK-LABEL: hw.module @main(%in: i8, %clk: i1, %reset: i1, %go: i1) -> (out: i8, done: i1) {
+// CHECK:   comb.or
+// CHECK:   hw.output
+// CHECK: }
+// CHECK-NOT: calyx.
+calyx.program "main" {
+  calyx.component @A(%in: i8, %clk: i1 {clk}, %reset: i1 {reset}, %go: i1 {go}) -> (%out: i8, %done: i1 {done}) {
+    %true = hw.constant true
+    %not.in, %not.out = calyx.std_not @not : i8, i8
+    calyx.wires {
+      calyx.assign %not.in = %in : i8
+      calyx.assign %out = %not.out : i8
+      calyx.assign %done = %true : i1
+    }
+    calyx.control {}
+  }
+  calyx.component @B(%in: i8, %clk: i1 {clk}, %reset: i1 {reset}, %go: i1 {go}) -> (%out: i8, %done: i1 {done}) {
+    %true = hw.constant true
+    %and.left, %and.right, %and.out = calyx.std_and @and : i8, i8, i8
+    calyx.wires {
+      calyx.assign %and.left = %in : i8
+      calyx.assign %and.right = %in : i8
+      calyx.assign %out = %and.out : i8
+      calyx.assign %done = %true : i1
+    }
+    calyx.control {}
+  }
+  calyx.component @main(%in: i8, %clk: i1 {clk}, %reset: i1 {reset}, %go: i1 {go}) -> (%out: i8, %done: i1 {done}) {
+    %true = hw.constant true
+    %or.left, %or.right, %or.out = calyx.std_or @or : i8, i8, i8
+    calyx.wires {
+      calyx.assign %or.left = %in : i8
+      calyx.assign %or.right = %in : i8
+      calyx.assign %out = %or.out : i8
+      calyx.assign %done = %true : i1
+    }
+    calyx.control {}
+  }
+}
@@ -92,3 +92,12 @@ func.func @Expressions(%arg0: !moore.bit, %arg1: !moore.logic, %arg2: !moore.pac
   // CHECK-NEXT: return
   return
 }
+
+// Typedefs resolve to the same layout (and lowered type) as the types they
+// name, whether packed or unpacked.
+// CHECK-LABEL: func @NamedTypes
+// CHECK-SAME: (%arg0: i8, %arg1: i8, %arg2: i1) -> i8
+func.func @NamedTypes(%arg0: !moore.packed<named<"byte_t", range<bit, 7:0>, loc("foo.sv":1:1)>>, %arg1: !moore.unpacked<named<"alias_t", named<"byte_t", range<bit, 7:0>, loc("foo.sv":1:1)>, loc("foo.sv":2:1)>>, %arg2: !moore.packed<ref<bit, loc("foo.sv":3:1)>>) -> !moore.packed<named<"byte_t", range<bit, 7:0>, loc("foo.sv":1:1)>> {
+  // CHECK-NEXT: return %arg0 : i8
+  return %arg0 : !moore.packed<named<"byte_t", range<bit, 7:0>, loc("foo.sv":1:1)>>
+}
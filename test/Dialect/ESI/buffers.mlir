@@ -0,0 +1,58 @@
+// RUN: circt-opt %s --esi-infer-buffer-depths | FileCheck --check-prefix=INFER %s
+// RUN: circt-opt %s --esi-infer-buffer-depths --lower-esi-to-physical | FileCheck --check-prefix=PHYS %s
+// RUN: circt-opt %s --esi-infer-buffer-depths --lower-esi-to-physical --lower-esi-ports --lower-esi-to-hw | FileCheck --check-prefix=HW %s
+
+hw.module.extern @Sender(%clk: i1) -> (x: !esi.channel<i8>)
+hw.module.extern @Reciever(%a: !esi.channel<i8>, %clk: i1)
+hw.module.extern @Pipelined(%clk: i1, %in: !esi.channel<i8>) -> (out: !esi.channel<i8>)
+
+// INFER-LABEL: hw.module @straight
+// PHYS-LABEL: hw.module @straight
+hw.module @straight(%clk: i1, %rstn: i1) {
+  %chan = hw.instance "sender" @Sender(clk: %clk: i1) -> (x: !esi.channel<i8>)
+  // INFER: esi.buffer %clk, %rstn, %sender.x {depth = 2 : i64, impl = "fifo"} : i8
+  // PHYS:  [[FIFO:%.+]] = esi.fifo %clk, %rstn, %sender.x {depth = 2 : i64} : i8
+  %fifo = esi.buffer %clk, %rstn, %chan {impl = "fifo"} : i8
+  // INFER: esi.buffer %clk, %rstn, %{{.+}} {depth = 5 : i64, impl = "fifo"} : i8
+  // PHYS:  [[SIZED:%.+]] = esi.fifo %clk, %rstn, [[FIFO]] {depth = 5 : i64} : i8
+  %sized = esi.buffer %clk, %rstn, %fifo {impl = "fifo", depth = 5} : i8
+  // PHYS:  [[SKID:%.+]] = esi.skid %clk, %rstn, [[SIZED]] {name = "s"} : i8
+  %skid = esi.buffer %clk, %rstn, %sized {impl = "skid", name = "s"} : i8
+  // PHYS:  hw.instance "recv" @Reciever(a: [[SKID]]: !esi.channel<i8>
+  hw.instance "recv" @Reciever(a: %skid: !esi.channel<i8>, clk: %clk: i1) -> ()
+}
+
+// The loop is the FIFO (1 cycle), a 3 stage pipeline buffer, and a module
+// instance with 4 cycles of latency: 8 cycles round trip.
+// INFER-LABEL: hw.module @loop
+hw.module @loop(%clk: i1, %rstn: i1) {
+  // INFER: esi.buffer %clk, %rstn, %pipe.out {depth = 8 : i64, impl = "fifo"} : i8
+  %fifo = esi.buffer %clk, %rstn, %back {impl = "fifo"} : i8
+  %staged = esi.buffer %clk, %rstn, %fifo {stages = 3} : i8
+  %back = hw.instance "pipe" @Pipelined(clk: %clk: i1, in: %staged: !esi.channel<i8>) -> (out: !esi.channel<i8>) {esi.latency = 4}
+}
+
+// The A <-> B loop shares ops with the loop through the FIFO. The longest path
+// back is X (0), B (1), A (2), C (4), J (0): 7 cycles, plus the FIFO's own.
+// The depth must not depend on which of A and B is visited first.
+hw.module.extern @Split(%in: !esi.channel<i8>) -> (a: !esi.channel<i8>, b: !esi.channel<i8>)
+hw.module.extern @Join(%a: !esi.channel<i8>, %b: !esi.channel<i8>) -> (out: !esi.channel<i8>)
+hw.module.extern @Cross(%a: !esi.channel<i8>, %b: !esi.channel<i8>) -> (x: !esi.channel<i8>, y: !esi.channel<i8>)
+// INFER-LABEL: hw.module @nested_loop
+hw.module @nested_loop(%clk: i1, %rstn: i1) {
+  // INFER: esi.buffer %clk, %rstn, %j.out {depth = 8 : i64, impl = "fifo"} : i8
+  %fifo = esi.buffer %clk, %rstn, %j.out {impl = "fifo"} : i8
+  %x.a, %x.b = hw.instance "x" @Split(in: %fifo: !esi.channel<i8>) -> (a: !esi.channel<i8>, b: !esi.channel<i8>)
+  %a.x, %a.y = hw.instance "a" @Cross(a: %x.a: !esi.channel<i8>, b: %b.x: !esi.channel<i8>) -> (x: !esi.channel<i8>, y: !esi.channel<i8>) {esi.latency = 2}
+  %b.x, %b.y = hw.instance "b" @Cross(a: %x.b: !esi.channel<i8>, b: %a.x: !esi.channel<i8>) -> (x: !esi.channel<i8>, y: !esi.channel<i8>) {esi.latency = 1}
+  %c.out = hw.instance "c" @Pipelined(clk: %clk: i1, in: %a.y: !esi.channel<i8>) -> (out: !esi.channel<i8>) {esi.latency = 4}
+  %j.out = hw.instance "j" @Join(a: %b.y: !esi.channel<i8>, b: %c.out: !esi.channel<i8>) -> (out: !esi.channel<i8>)
+}
+
+// HW-LABEL: hw.module.extern @ESI_FIFO<WIDTH: ui32, DEPTH: ui32>
+// HW-LABEL: hw.module.extern @ESI_SkidBuffer<WIDTH: ui32>
+// HW-LABEL: hw.module @straight
+// HW:         hw.instance "fifo" @ESI_FIFO<WIDTH: ui32 = 8, DEPTH: ui32 = 2>
+// HW:         hw.instance "fifo" @ESI_FIFO<WIDTH: ui32 = 8, DEPTH: ui32 = 5>
+// HW:         hw.instance "s" @ESI_SkidBuffer<WIDTH: ui32 = 8>
+// HW-NOT:     esi.
@@ -3,6 +3,7 @@
 // RUN: circt-opt %s --lower-esi-ports --lower-esi-to-hw -verify-diagnostics | circt-opt -verify-diagnostics | FileCheck --check-prefix=COSIM %s
 // Disable the SV test : circt-opt %s --lower-esi-ports --lower-esi-to-hw | circt-opt --export-verilog | FileCheck --check-prefix=SV %s
 // RUN: circt-translate %s -export-esi-capnp -verify-diagnostics | FileCheck --check-prefix=CAPNP %s
+// RUN: circt-translate %s -export-esi-cosim-client -verify-diagnostics | FileCheck --check-prefix=CLIENT %s
 
 hw.module.extern @Sender() -> (x: !esi.channel<si14>)
 hw.module.extern @Reciever(%a: !esi.channel<i32>)
@@ -41,6 +42,16 @@ hw.module @top(%clk:i1, %rstn:i1) -> () {
   // CAPNP: list @0 () -> (ifaces :List(EsiDpiInterfaceDesc));
   // CAPNP: open @1 [S, T] (iface :EsiDpiInterfaceDesc) -> (iface :EsiDpiEndpoint(S, T));
 
+  // CLIENT:      #include ESI_COSIM_SCHEMA_HEADER
+  // CLIENT-NEXT: #include "circt/Dialect/ESI/cosim/Client.h"
+  // CLIENT:      namespace esi_cosim_client {
+  // CLIENT:      /// Endpoint #1 at
+  // CLIENT-NEXT: using TestEP = circt::esi::cosim::ClientEndpoint<
+  // CLIENT-NEXT:     ::Si14, ::I32, /*endpointID=*/1, /*sendWords=*/2>;
+  // CLIENT:      /// Endpoint #2 at
+  // CLIENT-NEXT: using ArrTestEP = circt::esi::cosim::ClientEndpoint<
+  // CLIENT-NEXT:     ::Si14, ::ArrayOf4xSi64, /*endpointID=*/2, /*sendWords=*/2>;
+
   // COSIM: %TestEP.DataOutValid, %TestEP.DataOut, %TestEP.DataInReady = hw.instance "TestEP" @Cosim_Endpoint<ENDPOINT_ID: i32 = 1, SEND_TYPE_ID: ui64 = 11229133067582987457, SEND_TYPE_SIZE_BITS: i32 = 128, RECV_TYPE_ID: ui64 = 10578209918096690139, RECV_TYPE_SIZE_BITS: i32 = 128>(clk: %clk: i1, rstn: %rstn: i1, DataOutReady: %{{.*}}: i1, DataInValid: %{{.*}}: i1, DataIn: %encodeSi14Inst.encoded: !hw.array<128xi1>) -> (DataOutValid: i1, DataOut: !hw.array<128xi1>, DataInReady: i1)
 
   // SV: assign _T.valid = TestEP_DataOutValid;
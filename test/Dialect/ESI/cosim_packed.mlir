@@ -0,0 +1,86 @@
+// RUN: circt-opt %s --lower-esi-ports --lower-esi-to-hw=cosim-encoding=packed -verify-diagnostics | circt-opt -verify-diagnostics | FileCheck --check-prefix=COSIM %s
+// RUN: circt-translate %s -export-esi-packed-cpp -verify-diagnostics | FileCheck --check-prefix=CPP %s
+
+!Hdr = !hw.struct<len: ui16, kind: si3>
+!DataPkt = !hw.struct<encrypted: i1, compressionLevel: ui4, blob: !hw.array<4 x i8>, hdr: !Hdr>
+
+hw.module.extern @Sender() -> (x: !esi.channel<si14>)
+hw.module.extern @Reciever(%a: !esi.channel<i32>)
+hw.module.extern @Compressor(%in: !esi.channel<i1>) -> (x: !esi.channel<!DataPkt>)
+
+hw.module @top(%clk:i1, %rstn:i1) -> () {
+  hw.instance "recv" @Reciever (a: %cosimRecv: !esi.channel<i32>) -> ()
+  %send.x = hw.instance "send" @Sender () -> (x: !esi.channel<si14>)
+  %cosimRecv = esi.cosim %clk, %rstn, %send.x, 1 {name="TestEP"} : !esi.channel<si14> -> !esi.channel<i32>
+
+  %compressedData = hw.instance "compressor" @Compressor(in: %inputData: !esi.channel<i1>) -> (x: !esi.channel<!DataPkt>)
+  %inputData = esi.cosim %clk, %rstn, %compressedData, 2 {name="Compressor"} : !esi.channel<!DataPkt> -> !esi.channel<i1>
+}
+
+// COSIM-LABEL: hw.module @top
+// COSIM:         [[PAYLOAD:%.+]] = hw.bitcast %{{.+}} : (si14) -> i14
+// COSIM:         [[MSG:%.+]] = comb.concat %{{.+}}, [[PAYLOAD]], %{{.+}} : i50, i14, i64
+// COSIM:         [[BITS:%.+]] = hw.bitcast [[MSG]] : (i128) -> !hw.array<128xi1>
+// COSIM:         %TestEP.DataOutValid, %TestEP.DataOut, %TestEP.DataInReady = hw.instance "TestEP" @Cosim_Endpoint<ENDPOINT_ID: i32 = 1, SEND_TYPE_ID: ui64 = {{[0-9]+}}, SEND_TYPE_SIZE_BITS: i32 = 128, RECV_TYPE_ID: ui64 = {{[0-9]+}}, RECV_TYPE_SIZE_BITS: i32 = 128>(clk: %clk: i1, rstn: %rstn: i1, DataOutReady: %{{.+}}: i1, DataInValid: %{{.+}}: i1, DataIn: [[BITS]]: !hw.array<128xi1>)
+// COSIM:         [[RMSG:%.+]] = hw.bitcast %TestEP.DataOut : (!hw.array<128xi1>) -> i128
+// COSIM:         [[RPAYLOAD:%.+]] = comb.extract [[RMSG]] from 64 : (i128) -> i32
+// COSIM:         [[HDR:%.+]] = comb.extract [[RMSG]] from 0 : (i128) -> i64
+// COSIM:         [[OK:%.+]] = comb.icmp eq [[HDR]], %{{.+}} : i64
+// COSIM:         sv.always posedge %clk {
+// COSIM-NEXT:      sv.if %TestEP.DataOutValid {
+// COSIM-NEXT:        sv.assert [[OK]], immediate
+
+// COSIM:         [[SBITS:%.+]] = hw.bitcast %{{.+}} : (!hw.struct<encrypted: i1, compressionLevel: ui4, blob: !hw.array<4xi8>, hdr: !hw.struct<len: ui16, kind: si3>>) -> i56
+// COSIM:         comb.concat %{{.+}}, [[SBITS]], %{{.+}} : i8, i56, i64
+// COSIM:         hw.instance "Compressor" @Cosim_Endpoint<ENDPOINT_ID: i32 = 2, SEND_TYPE_ID: ui64 = {{[0-9]+}}, SEND_TYPE_SIZE_BITS: i32 = 128, RECV_TYPE_ID: ui64 = {{[0-9]+}}, RECV_TYPE_SIZE_BITS: i32 = 128>
+
+// CPP:       #pragma once
+// CPP:       namespace esi_packed {
+// CPP:       inline void insertBits(uint8_t *msg, size_t offset, size_t width,
+// CPP:       inline uint64_t extractBits(const uint8_t *msg, size_t offset, size_t width) {
+// CPP:       inline int64_t signExtend(uint64_t value, size_t width) {
+
+// CPP-LABEL: // Actual type is !hw.struct<len: ui16, kind: si3>.
+// CPP-NEXT:  struct [[HDR:Struct[0-9]+]] {
+// CPP-NEXT:    static constexpr uint64_t typeID = 0x{{[0-9a-f]+}}ULL;
+// CPP-NEXT:    static constexpr uint64_t header = 0x{{[0-9a-f]+}}00000013ULL;
+// CPP-NEXT:    static constexpr size_t payloadBits = 19;
+// CPP-NEXT:    static constexpr size_t messageBytes = 16;
+// CPP-EMPTY:
+// CPP-NEXT:    uint16_t len;
+// CPP-NEXT:    int8_t kind;
+// CPP-EMPTY:
+// CPP-NEXT:    void encodeAt(uint8_t *msg, size_t offset) const {
+// CPP-NEXT:      esi_packed::insertBits(msg, offset + 3, 16, static_cast<uint64_t>(len));
+// CPP-NEXT:      esi_packed::insertBits(msg, offset + 0, 3, static_cast<uint64_t>(kind));
+// CPP-NEXT:    }
+// CPP:         static [[HDR]] decodeAt(const uint8_t *msg, size_t offset) {
+// CPP-NEXT:      [[HDR]] v;
+// CPP-NEXT:      v.len = static_cast<uint16_t>(esi_packed::extractBits(msg, offset + 3, 16));
+// CPP-NEXT:      v.kind = static_cast<int8_t>(esi_packed::signExtend(esi_packed::extractBits(msg, offset + 0, 3), 3));
+// CPP-NEXT:      return v;
+// CPP-NEXT:    }
+// CPP:         void encode(uint8_t *msg) const {
+// CPP-NEXT:      std::memset(msg, 0, messageBytes);
+// CPP-NEXT:      esi_packed::insertBits(msg, 0, 64, header);
+// CPP-NEXT:      encodeAt(msg, 64);
+// CPP-NEXT:    }
+// CPP:         static bool decode(const uint8_t *msg, [[HDR]] &v) {
+// CPP-NEXT:      if (esi_packed::extractBits(msg, 0, 64) != header)
+// CPP-NEXT:        return false;
+
+// CPP-LABEL: // Actual type is !hw.struct<encrypted: i1, compressionLevel: ui4, blob: !hw.array<4xi8>, hdr: !hw.struct<len: ui16, kind: si3>>.
+// CPP:         static constexpr size_t payloadBits = 56;
+// CPP:         bool encrypted;
+// CPP-NEXT:    uint8_t compressionLevel;
+// CPP-NEXT:    std::array<uint8_t, 4> blob;
+// CPP-NEXT:    [[HDR]] hdr;
+// CPP-EMPTY:
+// CPP-NEXT:    void encodeAt(uint8_t *msg, size_t offset) const {
+// CPP-NEXT:      esi_packed::insertBits(msg, offset + 55, 1, static_cast<uint64_t>(encrypted));
+// CPP-NEXT:      esi_packed::insertBits(msg, offset + 51, 4, static_cast<uint64_t>(compressionLevel));
+// CPP-NEXT:      for (size_t i0 = 0; i0 < 4; ++i0)
+// CPP-NEXT:        esi_packed::insertBits(msg, offset + 19 + i0 * 8, 8, static_cast<uint64_t>(blob[i0]));
+// CPP-NEXT:      hdr.encodeAt(msg, offset + 0);
+// CPP-NEXT:    }
+// CPP:           v.hdr = [[HDR]]::decodeAt(msg, offset + 0);
@@ -0,0 +1,27 @@
+// RUN: circt-translate %s -export-esi-packed-cpp -verify-diagnostics | FileCheck %s
+// RUN: circt-translate %s -export-esi-packed-cpp -verify-diagnostics | FileCheck %s --check-prefix=NAMES
+
+!A = !hw.struct<msg: i8, header: i4>
+!B = !hw.struct<offset: i8, i0: i2, i: i1>
+
+hw.module.extern @Sender() -> (x: !esi.channel<!hw.array<2 x !A>>)
+hw.module.extern @Reciever(%a: !esi.channel<!hw.array<2 x !B>>)
+
+hw.module @top(%clk:i1, %rstn:i1) -> () {
+  hw.instance "recv" @Reciever (a: %cosimRecv: !esi.channel<!hw.array<2 x !B>>) -> ()
+  %send.x = hw.instance "send" @Sender () -> (x: !esi.channel<!hw.array<2 x !A>>)
+  %cosimRecv = esi.cosim %clk, %rstn, %send.x, 1 {name="TestEP"} : !esi.channel<!hw.array<2 x !A>> -> !esi.channel<!hw.array<2 x !B>>
+}
+
+// Fields which would clash with the generated code are renamed.
+// CHECK-DAG: uint8_t msg_;
+// CHECK-DAG: uint8_t header_;
+// CHECK-DAG: esi_packed::insertBits(msg, offset + 4, 8, static_cast<uint64_t>(msg_));
+// CHECK-DAG: v.header_ = static_cast<uint8_t>(esi_packed::extractBits(msg, offset + 0, 4));
+// CHECK-DAG: uint8_t offset_;
+// CHECK-DAG: uint8_t i0_;
+// CHECK-DAG: bool i;
+
+// Arrays of different structs of the same length get different names.
+// NAMES: struct [[ARRAY:ArrayOf2xStruct[0-9]+]] {
+// NAMES-NOT: struct [[ARRAY]] {
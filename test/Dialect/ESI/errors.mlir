@@ -43,3 +43,17 @@ hw.module @test(%m : !sv.modport<@IData::@Noexist>) {
   // expected-error @+1 {{Could not find modport @IData::@Noexist in symbol table.}}
   %idataChanOut = esi.wrap.iface %m: !sv.modport<@IData::@Noexist> -> !esi.channel<i32>
 }
+
+// -----
+
+hw.module @test(%clk: i1, %rstn: i1, %chan: !esi.channel<i8>) {
+  // expected-error @+1 {{'esi.buffer' op unknown buffer implementation 'lifo', expected 'pipeline', 'skid', or 'fifo'}}
+  %0 = esi.buffer %clk, %rstn, %chan {impl = "lifo"} : i8
+}
+
+// -----
+
+hw.module @test(%clk: i1, %rstn: i1, %chan: !esi.channel<i8>) {
+  // expected-error @+1 {{'esi.buffer' op 'depth' only applies to 'fifo' buffers}}
+  %0 = esi.buffer %clk, %rstn, %chan {impl = "skid", depth = 4} : i8
+}
@@ -0,0 +1,37 @@
+// RUN: rm -rf %t
+// RUN: split-file %s %t
+// RUN: sed 's?@DIR@?%t?' %t/Foo.mlir.orig > %t/Foo.mlir
+// RUN: circt-opt --pass-pipeline='firrtl.circuit(firrtl-blackbox-reader)' -mlir-pass-statistics %t/Foo.mlir -o /dev/null 2>&1 | FileCheck %s
+
+// A.sv and B.sv are read once each. The second annotation pointing at A.sv
+// shares the file already read. The other A.sv and C.sv are never read, since
+// their output names are already taken by an earlier annotation.
+// CHECK: (S) {{ *}}16 num-bytes-read
+// CHECK: (S) {{ *}}1 num-cache-hits
+// CHECK: (S) {{ *}}2 num-files-read
+
+//--- A.sv
+/* A */
+//--- B.sv
+/* B */
+//--- C.sv
+/* C */
+//--- other/A.sv
+/* other A */
+//--- Foo.mlir.orig
+firrtl.circuit "Foo" {
+  firrtl.extmodule @ExtA() attributes {annotations = [{class = "firrtl.transforms.BlackBoxPathAnno", path = "@DIR@/A.sv"}]}
+  firrtl.extmodule @ExtB() attributes {annotations = [{class = "firrtl.transforms.BlackBoxPathAnno", path = "@DIR@/A.sv"}]}
+  firrtl.extmodule @ExtC() attributes {annotations = [{class = "firrtl.transforms.BlackBoxPathAnno", path = "@DIR@/other/A.sv"}]}
+  firrtl.extmodule @ExtD() attributes {annotations = [{class = "firrtl.transforms.BlackBoxPathAnno", path = "@DIR@/B.sv"}]}
+  firrtl.extmodule @ExtE() attributes {annotations = [{class = "firrtl.transforms.BlackBoxInlineAnno", name = "C.sv", text = "// inline C"}]}
+  firrtl.extmodule @ExtF() attributes {annotations = [{class = "firrtl.transforms.BlackBoxPathAnno", path = "@DIR@/C.sv"}]}
+  firrtl.module @Foo() {
+    firrtl.instance a @ExtA()
+    firrtl.instance b @ExtB()
+    firrtl.instance c @ExtC()
+    firrtl.instance d @ExtD()
+    firrtl.instance e @ExtE()
+    firrtl.instance f @ExtF()
+  }
+}
@@ -175,4 +175,20 @@ firrtl.circuit "strictConnectAndConnect" {
     firrtl.connect %a, %b : !firrtl.uint<11>, !firrtl.uint<11>
     firrtl.strictconnect %b, %a : !firrtl.uint<11>
   }
-}
\ No newline at end of file
+}
+// -----
+
+firrtl.circuit "instanceCycle" {
+  firrtl.module @instanceCycle() {
+    firrtl.instance a @A()
+  }
+  // expected-error @+1 {{module 'A' recursively instantiates itself}}
+  firrtl.module @A() {
+    // expected-note @+1 {{through instance 'b' of module 'B'}}
+    firrtl.instance b @B()
+  }
+  firrtl.module @B() {
+    // expected-note @+1 {{through instance 'a' of module 'A'}}
+    firrtl.instance a @A()
+  }
+}
@@ -302,4 +302,35 @@ firrtl.module @LargeMem(in %clock: !firrtl.clock, in %addr: !firrtl.uint<35>, ou
   firrtl.connect %out, %r_data : !firrtl.uint<1>, !firrtl.uint<1>
 }
 
+// Port kinds are inferred through nested subfield and subindex chains, and
+// each port of a multi-port memory is inferred on its own.
+firrtl.module @InferNestedMultiPort(in %clock: !firrtl.clock, in %addr: !firrtl.uint<1>, in %in: !firrtl.uint<1>, out %out: !firrtl.uint<1>) {
+  // CHECK-LABEL: @InferNestedMultiPort
+  // CHECK: %ram_r, %ram_rw, %ram_w = firrtl.mem Undefined {depth = 2 : i64, name = "ram", portNames = ["r", "rw", "w"]
+  // CHECK-SAME: !firrtl.bundle<addr: uint<1>, en: uint<1>, clk: clock, data flip: bundle<a: vector<uint<1>, 2>>>
+  // CHECK-SAME: !firrtl.bundle<addr: uint<1>, en: uint<1>, clk: clock, rdata flip: bundle<a: vector<uint<1>, 2>>, wmode: uint<1>, wdata: bundle<a: vector<uint<1>, 2>>, wmask: bundle<a: vector<uint<1>, 2>>>
+  // CHECK-SAME: !firrtl.bundle<addr: uint<1>, en: uint<1>, clk: clock, data: bundle<a: vector<uint<1>, 2>>, mask: bundle<a: vector<uint<1>, 2>>>
+  %ram = chirrtl.combmem : !chirrtl.cmemory<bundle<a: vector<uint<1>, 2>>, 2>
+
+  %r_data, %r_port = chirrtl.memoryport Infer %ram {name = "r"} : (!chirrtl.cmemory<bundle<a: vector<uint<1>, 2>>, 2>) -> (!firrtl.bundle<a: vector<uint<1>, 2>>, !chirrtl.cmemoryport)
+  chirrtl.memoryport.access %r_port[%addr], %clock : !chirrtl.cmemoryport, !firrtl.uint<1>, !firrtl.clock
+  %0 = firrtl.subfield %r_data(0) : (!firrtl.bundle<a: vector<uint<1>, 2>>) -> !firrtl.vector<uint<1>, 2>
+  %1 = firrtl.subindex %0[1] : !firrtl.vector<uint<1>, 2>
+  firrtl.connect %out, %1 : !firrtl.uint<1>, !firrtl.uint<1>
+
+  %rw_data, %rw_port = chirrtl.memoryport Infer %ram {name = "rw"} : (!chirrtl.cmemory<bundle<a: vector<uint<1>, 2>>, 2>) -> (!firrtl.bundle<a: vector<uint<1>, 2>>, !chirrtl.cmemoryport)
+  chirrtl.memoryport.access %rw_port[%addr], %clock : !chirrtl.cmemoryport, !firrtl.uint<1>, !firrtl.clock
+  %2 = firrtl.subfield %rw_data(0) : (!firrtl.bundle<a: vector<uint<1>, 2>>) -> !firrtl.vector<uint<1>, 2>
+  %3 = firrtl.subindex %2[0] : !firrtl.vector<uint<1>, 2>
+  %4 = firrtl.subaccess %2[%addr] : !firrtl.vector<uint<1>, 2>, !firrtl.uint<1>
+  firrtl.connect %3, %in : !firrtl.uint<1>, !firrtl.uint<1>
+  %node = firrtl.node %4 : !firrtl.uint<1>
+
+  %w_data, %w_port = chirrtl.memoryport Infer %ram {name = "w"} : (!chirrtl.cmemory<bundle<a: vector<uint<1>, 2>>, 2>) -> (!firrtl.bundle<a: vector<uint<1>, 2>>, !chirrtl.cmemoryport)
+  chirrtl.memoryport.access %w_port[%addr], %clock : !chirrtl.cmemoryport, !firrtl.uint<1>, !firrtl.clock
+  %5 = firrtl.subfield %w_data(0) : (!firrtl.bundle<a: vector<uint<1>, 2>>) -> !firrtl.vector<uint<1>, 2>
+  %6 = firrtl.subaccess %5[%addr] : !firrtl.vector<uint<1>, 2>, !firrtl.uint<1>
+  firrtl.connect %6, %in : !firrtl.uint<1>, !firrtl.uint<1>
+}
+
 }
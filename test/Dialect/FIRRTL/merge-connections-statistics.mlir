@@ -0,0 +1,18 @@
+// RUN: circt-opt --pass-pipeline='firrtl.circuit(firrtl.module(merge-connections))' -mlir-pass-statistics %s -o /dev/null 2>&1 | FileCheck %s
+
+// The two field connections to %a are merged into one connection, which is
+// visited as well. The connection to the ground type port %d is never merged.
+// CHECK: (S) 4 num-connections
+// CHECK: (S) 2 num-merged-connections
+firrtl.circuit "Test" {
+  firrtl.module @Test(out %a: !firrtl.bundle<b: uint<1>, c: uint<1>>,
+                      out %d: !firrtl.uint<1>, in %e: !firrtl.uint<1>) {
+    %c0_ui1 = firrtl.constant 0 : !firrtl.uint<1>
+    %c1_ui1 = firrtl.constant 1 : !firrtl.uint<1>
+    %0 = firrtl.subfield %a(0) : (!firrtl.bundle<b: uint<1>, c: uint<1>>) -> !firrtl.uint<1>
+    %1 = firrtl.subfield %a(1) : (!firrtl.bundle<b: uint<1>, c: uint<1>>) -> !firrtl.uint<1>
+    firrtl.strictconnect %0, %c0_ui1 : !firrtl.uint<1>
+    firrtl.strictconnect %1, %c1_ui1 : !firrtl.uint<1>
+    firrtl.strictconnect %d, %e : !firrtl.uint<1>
+  }
+}
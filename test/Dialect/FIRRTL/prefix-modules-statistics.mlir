@@ -0,0 +1,31 @@
+// RUN: circt-opt --pass-pipeline="firrtl.circuit(firrtl-prefix-modules)" -mlir-pass-statistics %s -o /dev/null 2>&1 | FileCheck %s
+
+// Yak and Zebra are reachable under the prefixes "T_" and "T_A_", so each of
+// them is cloned once. Aardvark only gets the "T_" prefix.
+// CHECK: (S) 2 num-modules-cloned
+firrtl.circuit "Top" {
+  firrtl.module @Top()
+    attributes {annotations = [{
+      class = "sifive.enterprise.firrtl.NestedPrefixModulesAnnotation",
+      prefix = "T_",
+      inclusive = true
+    }]} {
+    firrtl.instance aardvark @Aardvark()
+    firrtl.instance zebra @Zebra()
+    firrtl.instance yak @Yak()
+  }
+
+  firrtl.module @Aardvark()
+    attributes {annotations = [{
+      class = "sifive.enterprise.firrtl.NestedPrefixModulesAnnotation",
+      prefix = "A_",
+      inclusive = false
+    }]} {
+    firrtl.instance zebra @Zebra()
+    firrtl.instance yak @Yak()
+  }
+
+  firrtl.module @Yak() { }
+
+  firrtl.module @Zebra() { }
+}
@@ -0,0 +1,18 @@
+// RUN: circt-opt -pass-pipeline='firrtl.circuit(firrtl-remove-unused-ports)' -mlir-pass-statistics %s -o /dev/null 2>&1 | FileCheck %s
+
+// Only the ports of the private module are visited. The unused input %d and
+// the undriven output %b are removed.
+// CHECK: (S) 4 num-ports
+// CHECK: (S) 2 num-removed-ports
+firrtl.circuit "Top" {
+  firrtl.module private @Child(in %a: !firrtl.uint<1>, in %d: !firrtl.uint<1>,
+                               out %b: !firrtl.uint<1>,
+                               out %c: !firrtl.uint<1>) {
+    firrtl.strictconnect %c, %a : !firrtl.uint<1>
+  }
+  firrtl.module @Top(in %x: !firrtl.uint<1>, out %y: !firrtl.uint<1>) {
+    %child_a, %child_d, %child_b, %child_c = firrtl.instance child @Child(in a: !firrtl.uint<1>, in d: !firrtl.uint<1>, out b: !firrtl.uint<1>, out c: !firrtl.uint<1>)
+    firrtl.strictconnect %child_a, %x : !firrtl.uint<1>
+    firrtl.strictconnect %y, %child_c : !firrtl.uint<1>
+  }
+}
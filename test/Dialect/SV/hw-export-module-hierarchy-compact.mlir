@@ -0,0 +1,113 @@
+// RUN: rm -rf %t
+// RUN: circt-opt -pass-pipeline='hw-export-module-hierarchy{dir-name=%t}' %s
+// RUN: FileCheck %s --check-prefix=EXPANDED < %t/top_hier.json
+// RUN: rm -rf %t
+// RUN: circt-opt -pass-pipeline='hw-export-module-hierarchy{dir-name=%t compact=true}' %s
+// RUN: FileCheck %s --check-prefix=COMPACT < %t/top_hier.json
+
+// Shared submodules are expanded below every instance.
+// EXPANDED:      {
+// EXPANDED-NEXT:   "instance_name": "Top",
+// EXPANDED-NEXT:   "module_name": "Top",
+// EXPANDED-NEXT:   "instances": [
+// EXPANDED-NEXT:     {
+// EXPANDED-NEXT:       "instance_name": "a",
+// EXPANDED-NEXT:       "module_name": "Middle",
+// EXPANDED-NEXT:       "instances": [
+// EXPANDED-NEXT:         {
+// EXPANDED-NEXT:           "instance_name": "leaf",
+// EXPANDED-NEXT:           "module_name": "Leaf",
+// EXPANDED-NEXT:           "instances": []
+// EXPANDED-NEXT:         },
+// EXPANDED-NEXT:         {
+// EXPANDED-NEXT:           "instance_name": "ext",
+// EXPANDED-NEXT:           "module_name": "ExtVerilogName",
+// EXPANDED-NEXT:           "instances": []
+// EXPANDED-NEXT:         }
+// EXPANDED-NEXT:       ]
+// EXPANDED-NEXT:     },
+// EXPANDED-NEXT:     {
+// EXPANDED-NEXT:       "instance_name": "b",
+// EXPANDED-NEXT:       "module_name": "Middle",
+// EXPANDED-NEXT:       "instances": [
+// EXPANDED-NEXT:         {
+// EXPANDED-NEXT:           "instance_name": "leaf",
+// EXPANDED-NEXT:           "module_name": "Leaf",
+// EXPANDED-NEXT:           "instances": []
+// EXPANDED-NEXT:         },
+// EXPANDED-NEXT:         {
+// EXPANDED-NEXT:           "instance_name": "ext",
+// EXPANDED-NEXT:           "module_name": "ExtVerilogName",
+// EXPANDED-NEXT:           "instances": []
+// EXPANDED-NEXT:         }
+// EXPANDED-NEXT:       ]
+// EXPANDED-NEXT:     },
+// EXPANDED-NEXT:     {
+// EXPANDED-NEXT:       "instance_name": "leaf",
+// EXPANDED-NEXT:       "module_name": "Leaf",
+// EXPANDED-NEXT:       "instances": []
+// EXPANDED-NEXT:     }
+// EXPANDED-NEXT:   ]
+// EXPANDED-NEXT: }
+
+// Every module below the top is listed once.
+// COMPACT:      {
+// COMPACT-NEXT:   "instance_name": "Top",
+// COMPACT-NEXT:   "module_name": "Top",
+// COMPACT-NEXT:   "instances": [
+// COMPACT-NEXT:     {
+// COMPACT-NEXT:       "instance_name": "a",
+// COMPACT-NEXT:       "module_name": "Middle"
+// COMPACT-NEXT:     },
+// COMPACT-NEXT:     {
+// COMPACT-NEXT:       "instance_name": "b",
+// COMPACT-NEXT:       "module_name": "Middle"
+// COMPACT-NEXT:     },
+// COMPACT-NEXT:     {
+// COMPACT-NEXT:       "instance_name": "leaf",
+// COMPACT-NEXT:       "module_name": "Leaf"
+// COMPACT-NEXT:     }
+// COMPACT-NEXT:   ],
+// COMPACT-NEXT:   "modules": [
+// COMPACT-NEXT:     {
+// COMPACT-NEXT:       "module_name": "Middle",
+// COMPACT-NEXT:       "instances": [
+// COMPACT-NEXT:         {
+// COMPACT-NEXT:           "instance_name": "leaf",
+// COMPACT-NEXT:           "module_name": "Leaf"
+// COMPACT-NEXT:         },
+// COMPACT-NEXT:         {
+// COMPACT-NEXT:           "instance_name": "ext",
+// COMPACT-NEXT:           "module_name": "ExtVerilogName"
+// COMPACT-NEXT:         }
+// COMPACT-NEXT:       ]
+// COMPACT-NEXT:     },
+// COMPACT-NEXT:     {
+// COMPACT-NEXT:       "module_name": "Leaf",
+// COMPACT-NEXT:       "instances": []
+// COMPACT-NEXT:     },
+// COMPACT-NEXT:     {
+// COMPACT-NEXT:       "module_name": "ExtVerilogName",
+// COMPACT-NEXT:       "instances": []
+// COMPACT-NEXT:     }
+// COMPACT-NEXT:   ]
+// COMPACT-NEXT: }
+
+hw.module.extern @Ext(%in: i1) -> (out: i1) attributes {verilogName = "ExtVerilogName"}
+
+hw.module @Leaf(%in: i1) -> (out: i1) {
+  hw.output %in : i1
+}
+
+hw.module @Middle(%in: i1) -> (out: i1) {
+  %0 = hw.instance "leaf" @Leaf(in: %in: i1) -> (out: i1)
+  %1 = hw.instance "ext" @Ext(in: %0: i1) -> (out: i1)
+  hw.output %1 : i1
+}
+
+hw.module @Top() attributes {firrtl.moduleHierarchyFile = [#hw.output_file<"top_hier.json", excludeFromFileList>]} {
+  %0 = hw.constant 1 : i1
+  %1 = hw.instance "a" @Middle(in: %0: i1) -> (out: i1)
+  %2 = hw.instance "b" @Middle(in: %1: i1) -> (out: i1)
+  hw.instance "leaf" @Leaf(in: %2: i1) -> (out: i1)
+}
@@ -0,0 +1,25 @@
+// `printf` prints its first argument and ignores the generator arguments which
+// follow it, so every callout names the same existing file.
+// RUN: rm -rf %t && mkdir -p %t && touch %t/generated.v
+// RUN: circt-opt -hw-generator-callout='schema-name=Schema_Name generator-executable=printf generator-executable-arguments=%t/generated.v cache-dir=%t/cache jobs=2' -mlir-pass-statistics %s -o /dev/null 2>&1 | FileCheck %s --check-prefix=FIRST
+// RUN: circt-opt -hw-generator-callout='schema-name=Schema_Name generator-executable=printf generator-executable-arguments=%t/generated.v cache-dir=%t/cache jobs=1' -mlir-pass-statistics %s -o /dev/null 2>&1 | FileCheck %s --check-prefix=SECOND
+// RUN: circt-opt -hw-generator-callout='schema-name=Schema_Name generator-executable=printf generator-executable-arguments=%t/generated.v;--extra cache-dir=%t/cache jobs=2' -mlir-pass-statistics %s -o /dev/null 2>&1 | FileCheck %s --check-prefix=FIRST
+// RUN: circt-opt -hw-generator-callout='schema-name=Schema_Name generator-executable=printf generator-executable-arguments=%t/generated.v cache-dir=%t/cache' %s | FileCheck %s -DFILE=%t/generated.v
+// RUN: rm %t/generated.v
+// RUN: circt-opt -hw-generator-callout='schema-name=Schema_Name generator-executable=printf generator-executable-arguments=%t/generated.v cache-dir=%t/cache jobs=2' -mlir-pass-statistics %s -o /dev/null 2>&1 | FileCheck %s --check-prefix=FIRST
+
+// FIRST: (S) {{ *}}0 num-cache-hits
+// FIRST: (S) {{ *}}2 num-callouts
+
+// SECOND: (S) {{ *}}2 num-cache-hits
+// SECOND: (S) {{ *}}0 num-callouts
+
+module attributes {firrtl.mainModule = "top_mod"}  {
+  hw.generator.schema @SchemaVar, "Schema_Name", ["port1", "port2"]
+
+  // CHECK: hw.module.extern @sampleModuleName(%clock: i1) attributes {filenames = "[[FILE]]"}
+  hw.module.generated @sampleModuleName, @SchemaVar(%clock: i1) attributes {port1 = 10 : i64, port2 = 2 : i32}
+
+  // CHECK: hw.module.extern @sampleModuleName1(%clock: i1) attributes {filenames = "[[FILE]]"}
+  hw.module.generated @sampleModuleName1, @SchemaVar(%clock: i1) attributes {port1 = 4 : i64, port2 = 1 : i32}
+}
@@ -5,11 +5,11 @@
 // CHECK:                      %[[VAL_1:.*]]: index) -> i32 {
 // CHECK:           %[[VAL_2:.*]] = arith.constant 2 : index
 // CHECK:           %[[VAL_3:.*]] = arith.shli %[[VAL_1]], %[[VAL_2]] : index
-// CHECK:           %[[VAL_4:.*]] = arith.addi %[[VAL_1]], %[[VAL_3]] : index
+// CHECK:           %[[VAL_4:.*]] = arith.ori %[[VAL_1]], %[[VAL_3]] : index
 // CHECK:           %[[VAL_5:.*]] = memref.load %[[VAL_0]]{{\[}}%[[VAL_4]]] : memref<16xi32>
 // CHECK:           %[[VAL_6:.*]] = arith.constant 2 : index
 // CHECK:           %[[VAL_7:.*]] = arith.shli %[[VAL_1]], %[[VAL_6]] : index
-// CHECK:           %[[VAL_8:.*]] = arith.addi %[[VAL_1]], %[[VAL_7]] : index
+// CHECK:           %[[VAL_8:.*]] = arith.ori %[[VAL_1]], %[[VAL_7]] : index
 // CHECK:           memref.store %[[VAL_5]], %[[VAL_0]]{{\[}}%[[VAL_8]]] : memref<16xi32>
 // CHECK:           return %[[VAL_5]] : i32
 // CHECK:         }
@@ -69,16 +69,16 @@ func.func @multidim5(%a : memref<5x6x7x9x10xi32>, %i : index) -> i32 {
 // CHECK:                       %[[VAL_1:.*]]: index) -> i32 {
 // CHECK:           %[[VAL_2:.*]] = arith.constant 1 : index
 // CHECK:           %[[VAL_3:.*]] = arith.shli %[[VAL_1]], %[[VAL_2]] : index
-// CHECK:           %[[VAL_4:.*]] = arith.addi %[[VAL_1]], %[[VAL_3]] : index
+// CHECK:           %[[VAL_4:.*]] = arith.ori %[[VAL_1]], %[[VAL_3]] : index
 // CHECK:           %[[VAL_5:.*]] = arith.constant 3 : index
 // CHECK:           %[[VAL_6:.*]] = arith.shli %[[VAL_1]], %[[VAL_5]] : index
-// CHECK:           %[[VAL_7:.*]] = arith.addi %[[VAL_4]], %[[VAL_6]] : index
+// CHECK:           %[[VAL_7:.*]] = arith.ori %[[VAL_4]], %[[VAL_6]] : index
 // CHECK:           %[[VAL_8:.*]] = arith.constant 6 : index
 // CHECK:           %[[VAL_9:.*]] = arith.shli %[[VAL_1]], %[[VAL_8]] : index
-// CHECK:           %[[VAL_10:.*]] = arith.addi %[[VAL_7]], %[[VAL_9]] : index
+// CHECK:           %[[VAL_10:.*]] = arith.ori %[[VAL_7]], %[[VAL_9]] : index
 // CHECK:           %[[VAL_11:.*]] = arith.constant 7 : index
 // CHECK:           %[[VAL_12:.*]] = arith.shli %[[VAL_1]], %[[VAL_11]] : index
-// CHECK:           %[[VAL_13:.*]] = arith.addi %[[VAL_10]], %[[VAL_12]] : index
+// CHECK:           %[[VAL_13:.*]] = arith.ori %[[VAL_10]], %[[VAL_12]] : index
 // CHECK:           %[[VAL_14:.*]] = memref.load %[[VAL_0]]{{\[}}%[[VAL_13]]] : memref<512xi32>
 // CHECK:           return %[[VAL_14]] : i32
 // CHECK:         }
@@ -89,6 +89,26 @@ func.func @multidim5_p2(%a : memref<2x4x8x2x4xi32>, %i : index) -> i32 {
 
 // -----
 
+// Only terms whose lower dimensions multiply up to a power of two are or'ed.
+// CHECK-LABEL:   func @multidim3_mixed(
+// CHECK:                          %[[VAL_0:.*]]: memref<24xi32>,
+// CHECK:                          %[[VAL_1:.*]]: index) -> i32 {
+// CHECK:           %[[VAL_2:.*]] = arith.constant 2 : index
+// CHECK:           %[[VAL_3:.*]] = arith.shli %[[VAL_1]], %[[VAL_2]] : index
+// CHECK:           %[[VAL_4:.*]] = arith.ori %[[VAL_1]], %[[VAL_3]] : index
+// CHECK:           %[[VAL_5:.*]] = arith.constant 12 : index
+// CHECK:           %[[VAL_6:.*]] = arith.muli %[[VAL_1]], %[[VAL_5]] : index
+// CHECK:           %[[VAL_7:.*]] = arith.addi %[[VAL_4]], %[[VAL_6]] : index
+// CHECK:           %[[VAL_8:.*]] = memref.load %[[VAL_0]]{{\[}}%[[VAL_7]]] : memref<24xi32>
+// CHECK:           return %[[VAL_8]] : i32
+// CHECK:         }
+func.func @multidim3_mixed(%a : memref<4x3x2xi32>, %i : index) -> i32 {
+  %0 = memref.load %a[%i, %i, %i] : memref<4x3x2xi32>
+  return %0 : i32
+}
+
+// -----
+
 // CHECK-LABEL:   func @as_func_ret(
 // CHECK:                      %[[VAL_0:.*]]: memref<16xi32>) -> memref<16xi32> {
 // CHECK:           return %[[VAL_0]] : memref<16xi32>
@@ -118,11 +138,11 @@ func.func @allocs() -> memref<4x4xi32> {
 // CHECK:         ^bb1(%[[VAL_5:.*]]: memref<16xi32>, %[[VAL_6:.*]]: memref<16xi32>):
 // CHECK:           %[[VAL_7:.*]] = arith.constant 2 : index
 // CHECK:           %[[VAL_8:.*]] = arith.shli %[[VAL_1]], %[[VAL_7]] : index
-// CHECK:           %[[VAL_9:.*]] = arith.addi %[[VAL_0]], %[[VAL_8]] : index
+// CHECK:           %[[VAL_9:.*]] = arith.ori %[[VAL_0]], %[[VAL_8]] : index
 // CHECK:           %[[VAL_10:.*]] = memref.load %[[VAL_5]]{{\[}}%[[VAL_9]]] : memref<16xi32>
 // CHECK:           %[[VAL_11:.*]] = arith.constant 2 : index
 // CHECK:           %[[VAL_12:.*]] = arith.shli %[[VAL_1]], %[[VAL_11]] : index
-// CHECK:           %[[VAL_13:.*]] = arith.addi %[[VAL_0]], %[[VAL_12]] : index
+// CHECK:           %[[VAL_13:.*]] = arith.ori %[[VAL_0]], %[[VAL_12]] : index
 // CHECK:           memref.store %[[VAL_10]], %[[VAL_6]]{{\[}}%[[VAL_13]]] : memref<16xi32>
 // CHECK:           return
 // CHECK:         }
@@ -22,4 +22,75 @@ TEST(TypesTest, AnalogContainsAnalog) {
   ASSERT_TRUE(AnalogType::get(&context).containsAnalog());
 }
 
+/// Resolve a field ID one aggregate level at a time, without going through the
+/// bundle field ID tables.
+static FIRRTLType walkFieldID(FIRRTLType type, unsigned fieldID) {
+  while (fieldID) {
+    if (auto bundle = type.dyn_cast<BundleType>()) {
+      unsigned index = 0;
+      while (index + 1 < bundle.getNumElements() &&
+             bundle.getFieldID(index + 1) <= fieldID)
+        ++index;
+      fieldID -= bundle.getFieldID(index);
+      type = bundle.getElementType(index);
+      continue;
+    }
+    auto vector = type.cast<FVectorType>();
+    auto index = vector.getIndexForFieldID(fieldID);
+    fieldID -= vector.getFieldID(index);
+    type = vector.getElementType();
+  }
+  return type;
+}
+
+TEST(TypesTest, NestedBundleFieldIDs) {
+  MLIRContext context;
+  context.loadDialect<FIRRTLDialect>();
+  auto uint1 = UIntType::get(&context, 1);
+  auto sint8 = SIntType::get(&context, 8);
+  auto name = [&](StringRef str) { return StringAttr::get(&context, str); };
+
+  // Build `{a: uint<1>, b: {a: uint<1>, b: sint<8>[3]}}` nested a few times.
+  FIRRTLType type = uint1;
+  for (unsigned i = 0; i < 4; ++i)
+    type = BundleType::get(
+        {{name("a"), false, uint1},
+         {name("b"), true,
+          BundleType::get({{name("a"), false, type},
+                           {name("b"), false, FVectorType::get(sint8, 3)}},
+                          &context)}},
+        &context);
+
+  auto bundle = type.cast<BundleType>();
+  for (unsigned fieldID = 0, e = bundle.getMaxFieldID(); fieldID <= e;
+       ++fieldID) {
+    EXPECT_EQ(bundle.getFinalTypeByFieldID(fieldID),
+              walkFieldID(bundle, fieldID));
+    if (fieldID == 0)
+      continue;
+    auto index = bundle.getIndexForFieldID(fieldID);
+    EXPECT_LE(bundle.getFieldID(index), fieldID);
+    EXPECT_TRUE(bundle.rootChildFieldID(fieldID, index).second);
+  }
+}
+
+TEST(TypesTest, LargeBundleFieldIDs) {
+  MLIRContext context;
+  context.loadDialect<FIRRTLDialect>();
+  auto uint1 = UIntType::get(&context, 1);
+
+  // Too many fields for a field ID table; lookups fall back to walking the
+  // type.
+  auto bundle =
+      BundleType::get({{StringAttr::get(&context, "a"), false, uint1},
+                       {StringAttr::get(&context, "b"), false,
+                        FVectorType::get(uint1, 10000)}},
+                      &context)
+          .cast<BundleType>();
+  EXPECT_EQ(bundle.getIndexForFieldID(1), 0u);
+  EXPECT_EQ(bundle.getIndexForFieldID(5000), 1u);
+  EXPECT_EQ(bundle.getFinalTypeByFieldID(5000), uint1);
+  EXPECT_EQ(bundle.getFinalTypeByFieldID(2), FVectorType::get(uint1, 10000));
+}
+
 } // namespace
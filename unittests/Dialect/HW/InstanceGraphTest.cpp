@@ -9,6 +9,7 @@
 #include "circt/Dialect/HW/HWDialect.h"
 #include "circt/Dialect/HW/HWInstanceGraph.h"
 #include "circt/Dialect/HW/HWOps.h"
+#include "circt/Dialect/HW/InstanceGraphLevels.h"
 #include "mlir/IR/ImplicitLocOpBuilder.h"
 #include "llvm/ADT/PostOrderIterator.h"
 #include "gtest/gtest.h"
@@ -77,4 +78,157 @@ TEST(InstanceGraphTest, PostOrderTraversal) {
   ASSERT_EQ(range.end(), it);
 }
 
+TEST(InstanceGraphTest, Levels) {
+  MLIRContext context;
+  context.loadDialect<HWDialect>();
+
+  // Build the following graph:
+  // hw.module @Top() {
+  //   hw.instance "alligator" @Alligator() -> ()
+  //   hw.instance "cat" @Cat() -> ()
+  // }
+  // hw.module private @Alligator() {
+  //   hw.instance "bear" @Bear() -> ()
+  // }
+  // hw.module private @Bear() {
+  //   hw.instance "cat" @Cat() -> ()
+  // }
+  // hw.module private @Cat() { }
+  // hw.module private @Dog() { }
+
+  LocationAttr loc = UnknownLoc::get(&context);
+  OwningOpRef<ModuleOp> module = ModuleOp::create(loc);
+  auto builder = ImplicitLocOpBuilder::atBlockEnd(loc, module->getBody());
+
+  auto top = builder.create<HWModuleOp>(StringAttr::get(&context, "Top"),
+                                        ArrayRef<PortInfo>{});
+  auto alligator = builder.create<HWModuleOp>(
+      StringAttr::get(&context, "Alligator"), ArrayRef<PortInfo>{});
+  auto bear = builder.create<HWModuleOp>(StringAttr::get(&context, "Bear"),
+                                         ArrayRef<PortInfo>{});
+  auto cat = builder.create<HWModuleOp>(StringAttr::get(&context, "Cat"),
+                                        ArrayRef<PortInfo>{});
+  builder.create<HWModuleOp>(StringAttr::get(&context, "Dog"),
+                             ArrayRef<PortInfo>{});
+
+  builder.setInsertionPointToStart(top.getBodyBlock());
+  builder.create<InstanceOp>(alligator, "alligator", ArrayRef<Value>{});
+  builder.create<InstanceOp>(cat, "cat", ArrayRef<Value>{});
+
+  builder.setInsertionPointToStart(alligator.getBodyBlock());
+  builder.create<InstanceOp>(bear, "bear", ArrayRef<Value>{});
+
+  builder.setInsertionPointToStart(bear.getBodyBlock());
+  builder.create<InstanceOp>(cat, "cat", ArrayRef<Value>{});
+
+  InstanceGraph graph(*module);
+  auto maybeLevels = InstanceGraphLevels::get(graph);
+  ASSERT_TRUE(succeeded(maybeLevels));
+  auto &levels = *maybeLevels;
+
+  auto getName = [](InstanceGraphNode *node) {
+    return node->getModule().moduleName();
+  };
+
+  // Modules are numbered level by level, in module order within a level.
+  ASSERT_EQ(5u, levels.size());
+  ASSERT_EQ(4u, levels.getNumLevels());
+  auto nodes = levels.getNodes();
+  ASSERT_EQ("Cat", getName(nodes[0]));
+  ASSERT_EQ("Dog", getName(nodes[1]));
+  ASSERT_EQ("Bear", getName(nodes[2]));
+  ASSERT_EQ("Alligator", getName(nodes[3]));
+  ASSERT_EQ("Top", getName(nodes[4]));
+  ASSERT_EQ(2u, levels.getLevel(0).size());
+  ASSERT_EQ(1u, levels.getLevel(3).size());
+  for (unsigned i = 0, e = levels.size(); i != e; ++i) {
+    ASSERT_EQ(i, levels.getIndex(nodes[i]));
+    ASSERT_EQ(nodes[i], levels.getNode(i));
+  }
+  ASSERT_EQ(0u, levels.getLevelOf(nodes[1]));
+  ASSERT_EQ(2u, levels.getLevelOf(nodes[3]));
+
+  // Count the module instances below each module.
+  auto below = summarizeBottomUp<unsigned>(
+      &context, levels,
+      [](InstanceGraphNode *node, const ModuleSummaries<unsigned> &summaries) {
+        unsigned count = 0;
+        for (auto *record : *node)
+          count += 1 + summaries[record->getTarget()];
+        return count;
+      });
+  ASSERT_EQ(0u, below[nodes[0]]);
+  ASSERT_EQ(0u, below[nodes[1]]);
+  ASSERT_EQ(1u, below[nodes[2]]);
+  ASSERT_EQ(2u, below[nodes[3]]);
+  ASSERT_EQ(4u, below[nodes[4]]);
+
+  // Count the instance paths to each module from an uninstantiated module.
+  // Public modules are also used by the entry node, which is not numbered.
+  auto paths = summarizeTopDown<unsigned>(
+      &context, levels,
+      [](InstanceGraphNode *node, const ModuleSummaries<unsigned> &summaries) {
+        unsigned count = 0;
+        for (auto *record : node->uses())
+          if (auto *parentPaths = summaries.getParentSummary(record))
+            count += *parentPaths;
+        return std::max(count, 1u);
+      });
+  ASSERT_EQ(2u, paths[nodes[0]]);
+  ASSERT_EQ(1u, paths[nodes[1]]);
+  ASSERT_EQ(1u, paths[nodes[2]]);
+  ASSERT_EQ(1u, paths[nodes[3]]);
+  ASSERT_EQ(1u, paths[nodes[4]]);
+}
+
+TEST(InstanceGraphTest, LevelsRejectCycle) {
+  MLIRContext context;
+  context.loadDialect<HWDialect>();
+
+  // Build the following graph, where Alligator instantiates itself through
+  // Bear:
+  // hw.module @Top() {
+  //   hw.instance "alligator" @Alligator() -> ()
+  // }
+  // hw.module private @Alligator() {
+  //   hw.instance "bear" @Bear() -> ()
+  // }
+  // hw.module private @Bear() {
+  //   hw.instance "alligator" @Alligator() -> ()
+  // }
+
+  LocationAttr loc = UnknownLoc::get(&context);
+  OwningOpRef<ModuleOp> module = ModuleOp::create(loc);
+  auto builder = ImplicitLocOpBuilder::atBlockEnd(loc, module->getBody());
+
+  auto top = builder.create<HWModuleOp>(StringAttr::get(&context, "Top"),
+                                        ArrayRef<PortInfo>{});
+  auto alligator = builder.create<HWModuleOp>(
+      StringAttr::get(&context, "Alligator"), ArrayRef<PortInfo>{});
+  auto bear = builder.create<HWModuleOp>(StringAttr::get(&context, "Bear"),
+                                         ArrayRef<PortInfo>{});
+
+  builder.setInsertionPointToStart(top.getBodyBlock());
+  builder.create<InstanceOp>(alligator, "alligator", ArrayRef<Value>{});
+
+  builder.setInsertionPointToStart(alligator.getBodyBlock());
+  builder.create<InstanceOp>(bear, "bear", ArrayRef<Value>{});
+
+  builder.setInsertionPointToStart(bear.getBodyBlock());
+  builder.create<InstanceOp>(alligator, "alligator", ArrayRef<Value>{});
+
+  SmallVector<std::string> errors;
+  unsigned numNotes = 0;
+  ScopedDiagnosticHandler handler(&context, [&](Diagnostic &diag) {
+    errors.push_back(diag.str());
+    numNotes += std::distance(diag.getNotes().begin(), diag.getNotes().end());
+  });
+
+  InstanceGraph graph(*module);
+  ASSERT_TRUE(failed(InstanceGraphLevels::get(graph)));
+  ASSERT_EQ(1u, errors.size());
+  ASSERT_EQ("module 'Alligator' recursively instantiates itself", errors[0]);
+  ASSERT_EQ(2u, numNotes);
+}
+
 } // namespace
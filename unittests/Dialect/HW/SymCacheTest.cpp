@@ -0,0 +1,77 @@
+//===- SymCacheTest.cpp - HW symbol cache tests ---------------------------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+
+#include "circt/Dialect/HW/HWDialect.h"
+#include "circt/Dialect/HW/HWOps.h"
+#include "circt/Dialect/HW/HWSymCache.h"
+#include "mlir/IR/ImplicitLocOpBuilder.h"
+#include "mlir/IR/Threading.h"
+#include "gtest/gtest.h"
+
+#include <atomic>
+
+using namespace mlir;
+using namespace circt;
+using namespace hw;
+
+namespace {
+
+TEST(HWSymbolCacheTest, FrozenLookup) {
+  MLIRContext context;
+  context.loadDialect<HWDialect>();
+  LocationAttr loc = UnknownLoc::get(&context);
+  OwningOpRef<ModuleOp> module = ModuleOp::create(loc);
+  auto builder = ImplicitLocOpBuilder::atBlockEnd(loc, module->getBody());
+
+  // Define enough modules and inner symbols that the table has to resolve
+  // plenty of collisions.
+  const unsigned numModules = 100, numSymbols = 20;
+  SmallVector<HWModuleOp> modules;
+  HWSymbolCache cache;
+  for (unsigned i = 0; i < numModules; ++i) {
+    auto name = StringAttr::get(&context, "Module" + Twine(i));
+    auto mod = builder.create<HWModuleOp>(name, ArrayRef<PortInfo>{});
+    modules.push_back(mod);
+    cache.addDefinition(name, mod);
+    for (unsigned j = 0; j < numSymbols; ++j)
+      cache.addDefinition(name, StringAttr::get(&context, "sym" + Twine(j)),
+                          mod, j);
+  }
+  cache.freeze();
+
+  // Every definition can be found from any thread.
+  std::atomic<unsigned> numWrong(0);
+  mlir::parallelForEachN(&context, 0, numModules, [&](size_t i) {
+    auto mod = modules[i];
+    if (cache.getDefinition(mod.getNameAttr()) != mod)
+      ++numWrong;
+    for (unsigned j = 0; j < numSymbols; ++j) {
+      auto item = cache.getInnerDefinition(
+          mod.getNameAttr(), StringAttr::get(&context, "sym" + Twine(j)));
+      if (item.getOp() != mod || !item.hasPort() || item.getPort() != j)
+        ++numWrong;
+    }
+  });
+  ASSERT_EQ(0u, numWrong);
+
+  // Missing symbols are not found.
+  auto missing = StringAttr::get(&context, "Missing");
+  ASSERT_EQ(nullptr, cache.getDefinition(missing));
+  auto item = cache.getInnerDefinition(modules[0].getNameAttr(), missing);
+  ASSERT_EQ(nullptr, item.getOp());
+  ASSERT_FALSE(item.hasPort());
+}
+
+TEST(HWSymbolCacheTest, FrozenEmpty) {
+  MLIRContext context;
+  HWSymbolCache cache;
+  cache.freeze();
+  ASSERT_EQ(nullptr, cache.getDefinition(StringAttr::get(&context, "A")));
+}
+
+} // namespace